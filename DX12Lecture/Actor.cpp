@@ -1,15 +1,60 @@
 #include "Actor.h"
 #include "World.h"
+#include "SceneQuery.h"
+#include "Levels/LevelFormat.h"
 #include "Animation/FPSAnimationStateMachine.h"
 #include "Animation/EnemyAnimationStateMachine.h"
 #define M_PI       3.14159265358979323846
 
 std::map<std::string, Actor::ActorCreator> Actor::m_actorCreators;
+std::map<std::string, Actor::ClassAssets> Actor::m_classAssets;
+std::map<std::string, Actor::RecordBulkLoader> Actor::m_recordLoaders;
+
+namespace
+{
+	// files the actor constructors load, also registered as each class's assets
+	const char* const SKY_TEXTURE = "Models/Textures/sky_ps.png";
+	const char* const WATER_TEXTURE = "Models/Textures/Textures1_ALB.png";
+	const char* const WATER_NORMAL_TEXTURE = "Models/Textures/Textures1_NH.png";
+	const char* const GROUND_TEXTURE = "Models/Textures/concrete_floor_damaged_01_diff_1k.png";
+	const char* const GROUND_NORMAL_TEXTURE = "Models/Textures/concrete_floor_damaged_01_nor_dx_1k.png";
+	const char* const TREE_MESH = "Models/willow.gem";
+	const char* const BOX_MESH = "Models/box_024.gem";
+	const char* const CONTAINER_MESH = "Models/container_005.gem";
+	const char* const OBSTACLE_MESH = "Models/obstacle_003.gem";
+	const char* const FPS_MODEL = "Models/Uzi.gem";
+	const char* const ENEMY_MODEL = "Models/Duck-white.gem";
+}
 
 void Actor::RegisterActor(const std::string& className, ActorCreator creator) {
 	m_actorCreators[className] = creator;
 }
 
+void Actor::RegisterActorAssets(const std::string& className, AssetList assets, RecordAssetLister recordAssets) {
+	m_classAssets[className] = { std::move(assets), std::move(recordAssets) };
+}
+
+AssetList Actor::GetClassAssets(const std::string& className) {
+	auto it = m_classAssets.find(className);
+	return it != m_classAssets.end() ? it->second.assets : AssetList();
+}
+
+void Actor::CollectRecordAssets(const std::string& className, const unsigned char* data, uint32_t size,
+	const LevelStringReader& strings, AssetList& assets) {
+	auto it = m_classAssets.find(className);
+	if (it != m_classAssets.end() && it->second.recordAssets)
+		it->second.recordAssets(data, size, strings, assets);
+}
+
+void Actor::RegisterRecordLoader(const std::string& className, RecordBulkLoader loader) {
+	m_recordLoaders[className] = std::move(loader);
+}
+
+const Actor::RecordBulkLoader* Actor::GetRecordLoader(const std::string& className) {
+	auto it = m_recordLoaders.find(className);
+	return it != m_recordLoaders.end() ? &it->second : nullptr;
+}
+
 Actor* Actor::CreateActorByClassName(const std::string& className) {
 	auto it = m_actorCreators.find(className);
 	if (it != m_actorCreators.end()) {
@@ -30,9 +75,9 @@ void Actor::SaveBase(std::ofstream& file) const {
 	Vec3 scale = getWorldScale();
 	file.write(reinterpret_cast<const char*>(&scale), sizeof(Vec3));
 
-	bool isCollidable = m_isCollidable;
-	file.write(reinterpret_cast<const char*>(&isCollidable), sizeof(bool));
-	int collisionShapeType = static_cast<int>(m_collisionShapeType);
+	bool collidable = isCollidable();
+	file.write(reinterpret_cast<const char*>(&collidable), sizeof(bool));
+	int collisionShapeType = static_cast<int>(getCollisionShapeType());
 	file.write(reinterpret_cast<const char*>(&collisionShapeType), sizeof(int));
 
 	bool isDestroyed = m_isDestroyed;
@@ -43,6 +88,7 @@ void Actor::LoadBase(std::ifstream& file) {
 	int actorType;
 	file.read(reinterpret_cast<char*>(&actorType), sizeof(int));
 	m_actorType = static_cast<ActorType>(actorType);
+	setCollisionLayer(defaultCollisionLayer(m_actorType));
 
 	Vec3 pos, rot, scale;
 	file.read(reinterpret_cast<char*>(&pos), sizeof(Vec3));
@@ -54,19 +100,200 @@ void Actor::LoadBase(std::ifstream& file) {
 
 	bool isCollidable;
 	file.read(reinterpret_cast<char*>(&isCollidable), sizeof(bool));
-	m_isCollidable = isCollidable;
+	collider().collidable = isCollidable;
 	int collisionShapeType;
 	file.read(reinterpret_cast<char*>(&collisionShapeType), sizeof(int));
-	m_collisionShapeType = static_cast<CollisionShapeType>(collisionShapeType);
+	collider().shapeType = static_cast<CollisionShapeType>(collisionShapeType);
+	markCollisionShapeDirty();
 
 	bool isDestroyed;
 	file.read(reinterpret_cast<char*>(&isDestroyed), sizeof(bool));
 	m_isDestroyed = isDestroyed;
 }
+
+void Actor::SaveBaseRecord(ActorRecord& record) const
+{
+	record.actorType = static_cast<int32_t>(m_actorType);
+	record.collisionShapeType = static_cast<int32_t>(getCollisionShapeType());
+	Vec3 pos = getWorldPos();
+	Vec3 rot = getWorldRotation();
+	Vec3 scale = getWorldScale();
+	memcpy(record.position, &pos, sizeof(record.position));
+	memcpy(record.rotation, &rot, sizeof(record.rotation));
+	memcpy(record.scale, &scale, sizeof(record.scale));
+	record.collidable = isCollidable() ? 1 : 0;
+	record.destroyed = m_isDestroyed ? 1 : 0;
+}
+
+// same order as LoadBase, the collision layer follows the type
+void Actor::LoadBaseRecord(const ActorRecord& record)
+{
+	m_actorType = static_cast<ActorType>(record.actorType);
+	setCollisionLayer(defaultCollisionLayer(m_actorType));
+
+	setWorldPos(Vec3(record.position[0], record.position[1], record.position[2]));
+	setWorldRotation(Vec3(record.rotation[0], record.rotation[1], record.rotation[2]));
+	setWorldScale(Vec3(record.scale[0], record.scale[1], record.scale[2]));
+
+	collider().collidable = record.collidable != 0;
+	collider().shapeType = static_cast<CollisionShapeType>(record.collisionShapeType);
+	markCollisionShapeDirty();
+
+	m_isDestroyed = record.destroyed != 0;
+}
+
+Actor::Actor() : m_actorType(ActorType::Static), m_isDestroyed(false)
+{
+	ColliderComponent collider;
+	collider.owner = this;
+	m_collider = ComponentArray<ColliderComponent>::Get().insert(collider);
+}
+
+Actor::~Actor()
+{
+	detachBroadphase();
+	ComponentArray<ColliderComponent>::Get().remove(m_collider);
+	ComponentArray<RenderableComponent>::Get().remove(m_renderable);
+	ComponentArray<AnimatorComponent>::Get().remove(m_animator);
+}
+
+void Actor::setTransform(WorldPosParam* transform)
+{
+	m_transform = transform;
+	collider().transformId = transform->GetTransformId();
+	markCollisionShapeDirty();
+}
+
+void Actor::addRenderable(const RenderableComponent& renderable)
+{
+	SlotMap<RenderableComponent>& renderables = ComponentArray<RenderableComponent>::Get();
+	// a replaced renderable hands its level over
+	const Level* level = nullptr;
+	if (RenderableComponent* old = renderables.get(m_renderable))
+		level = old->level;
+	renderables.remove(m_renderable);
+	m_renderable = renderables.insert(renderable);
+	RenderableComponent* added = renderables.get(m_renderable);
+	added->owner = this;
+	added->level = level;
+	added->active = m_isActive;
+}
+
+void Actor::addAnimator(AnimationStateMachine* stateMachine)
+{
+	AnimatorComponent animator;
+	animator.owner = this;
+	animator.stateMachine = stateMachine;
+	animator.active = m_isActive;
+	SlotMap<AnimatorComponent>& animators = ComponentArray<AnimatorComponent>::Get();
+	animators.remove(m_animator);
+	m_animator = animators.insert(animator);
+}
+
+void Actor::setLevel(const Level* level)
+{
+	if (RenderableComponent* renderable = getRenderable())
+		renderable->level = level;
+	if (AnimatorComponent* animator = ComponentArray<AnimatorComponent>::Get().get(m_animator))
+		animator->level = level;
+}
+
+void Actor::calculateLocalCollisionShape()
+{
+	RenderableComponent* renderable = getRenderable();
+	if (renderable == nullptr)
+		return;
+
+	ColliderComponent& c = collider();
+	c.localAABB.reset();
+	c.localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
+	if (renderable->staticMesh != nullptr)
+	{
+		for (const Mesh& mesh : renderable->staticMesh->getMeshes())
+			c.fitLocalShape(mesh.getVertices());
+	}
+	else if (renderable->animatedModel != nullptr)
+	{
+		for (const Mesh* mesh : renderable->animatedModel->getMeshes())
+			c.fitLocalShape(mesh->getVertices());
+	}
+}
+
+void Actor::setCollidable(bool enable)
+{
+	ColliderComponent& c = collider();
+	c.collidable = enable;
+	// keep the proxy in step with the flag once attached to a level
+	if (enable)
+		c.createProxy();
+	else
+		c.destroyProxy();
+}
+
+void Actor::setCollisionLayer(CollisionLayer layer)
+{
+	ColliderComponent& c = collider();
+	if (layer == c.layer)
+		return;
+	bool hadProxy = c.proxyId >= 0;
+	c.destroyProxy();
+	c.layer = layer;
+	if (hadProxy)
+		c.createProxy();
+}
+
+void Actor::setActive(bool active)
+{
+	if (active == m_isActive)
+		return;
+	m_isActive = active;
+	ColliderComponent& c = collider();
+	c.active = active;
+	if (active)
+		c.createProxy();
+	else
+		c.destroyProxy();
+	if (RenderableComponent* renderable = getRenderable())
+		renderable->active = active;
+	if (AnimatorComponent* animator = ComponentArray<AnimatorComponent>::Get().get(m_animator))
+		animator->active = active;
+}
+
+CollisionLayer Actor::defaultCollisionLayer(ActorType type)
+{
+	switch (type)
+	{
+	case ActorType::Player:
+		return CollisionLayer::Player;
+	case ActorType::Enemy:
+		return CollisionLayer::Enemy;
+	case ActorType::Bullet:
+		return CollisionLayer::Projectile;
+	default:
+		return CollisionLayer::Static;
+	}
+}
+
+void Actor::attachBroadphase(LayeredBroadphase* broadphase)
+{
+	detachBroadphase();
+	ColliderComponent& c = collider();
+	c.broadphase = broadphase;
+	c.createProxy();
+}
+
+void Actor::detachBroadphase()
+{
+	ColliderComponent& c = collider();
+	c.destroyProxy();
+	c.broadphase = nullptr;
+}
+
 namespace {
 	struct SkyBoxActorRegistrar {
 		SkyBoxActorRegistrar() {
 			Actor::RegisterActor("SkyBoxActor", []() { return new SkyBoxActor(); });
+			Actor::RegisterActorAssets("SkyBoxActor", { {}, {}, { SKY_TEXTURE } });
 		}
 	} skyBoxActorRegistrar;
 }
@@ -75,21 +302,19 @@ SkyBoxActor::SkyBoxActor()
 {
 	World* myWorld = World::Get();
 	skybox = new StaticMesh();
-	skybox->CreateFromSphere(myWorld->GetCore(), 64, 64, 5, "Models/Textures/sky_ps.png");
+	skybox->CreateFromSphere(myWorld->GetCore(), 64, 64, 5, SKY_TEXTURE);
+	setTransform(skybox);
+	addRenderable(RenderableComponent::mesh(skybox, STATIC_PIPE, RenderKind::MeshSingle));
 	skybox->SetWorldScaling(Vec3(1000.f, 1000.f, 1000.f));
 	skybox->SetWorldRotationRadian(Vec3(M_PI, 0.f, 0.f));
 }
 
-void SkyBoxActor::draw()
-{
-	World* myWorld = World::Get();
-	skybox->drawSingle(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_PIPE, myWorld->GetPipelines());
-}
-
 namespace {
 	struct TreeActorRegistrar {
 		TreeActorRegistrar() {
 			Actor::RegisterActor("TreeActor", []() { return new TreeActor(); });
+			Actor::RegisterRecordSchema<TreeActor>("TreeActor");
+			Actor::RegisterActorAssets("TreeActor", { { TREE_MESH }, {}, {} });
 		}
 	} treeActorRegistrar;
 }
@@ -100,7 +325,9 @@ TreeActor::TreeActor(int count, Vec3 transIncrement)
 	m_transIncrement = transIncrement;
 
 	World* myWorld = World::Get();
-	willow = new StaticMesh(myWorld->GetCore(), "Models/willow.gem");
+	willow = new StaticMesh(myWorld->GetCore(), TREE_MESH);
+	setTransform(willow);
+	addRenderable(RenderableComponent::instanced(willow, STATIC_INSTANCE_LIGHT_PIPE, &instanceMatrices));
 	generateInstanceMatrices(m_instanceCount, m_transIncrement);
 }
 
@@ -125,17 +352,31 @@ void TreeActor::generateInstanceMatrices(int count, Vec3 transIncrement)
 	}
 }
 
-void TreeActor::draw()
+uint32_t TreeActor::GetRecordDataSize() const
 {
-	World* myWorld = World::Get();
-	
-	willow->drawInstances(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_INSTANCE_LIGHT_PIPE, myWorld->GetPipelines(), &instanceMatrices, m_instanceCount);
+	return RecordSchema().getRecordSize();
+}
+
+void TreeActor::SaveRecordData(unsigned char* data, LevelStringWriter& strings) const
+{
+	RecordSchema().save(*this, data, strings);
+}
+
+void TreeActor::LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings)
+{
+	RecordSchema().load(*this, data, size, strings);
+}
+
+void TreeActor::onRecordLoaded()
+{
+	generateInstanceMatrices(m_instanceCount, m_transIncrement);
 }
 
 namespace {
 	struct WaterActorRegistrar {
 		WaterActorRegistrar() {
 			Actor::RegisterActor("WaterActor", []() { return new WaterActor(); });
+			Actor::RegisterActorAssets("WaterActor", { {}, {}, { WATER_TEXTURE, WATER_NORMAL_TEXTURE } });
 		}
 	} waterActorRegistrar;
 }
@@ -145,18 +386,15 @@ WaterActor::WaterActor()
 	World* myWorld = World::Get();
 	water = new StaticMesh();
 	water->CreateFromPlane(myWorld->GetCore(),100000, 100000,2000,2000);
-}
-
-void WaterActor::draw()
-{
-	World* myWorld = World::Get();
-	water->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_LIGHT_WATER_PIPE, myWorld->GetPipelines());
+	setTransform(water);
+	addRenderable(RenderableComponent::mesh(water, STATIC_LIGHT_WATER_PIPE));
 }
 
 namespace {
 	struct FPSActorRegistrar {
 		FPSActorRegistrar() {
 			Actor::RegisterActor("FPSActor", []() { return new FPSActor(); });
+			Actor::RegisterActorAssets("FPSActor", { {}, { FPS_MODEL }, {} });
 		}
 	} fpsActorRegistrar;
 }
@@ -164,16 +402,20 @@ namespace {
 FPSActor::FPSActor()
 {
 	World* myWorld = World::Get();
-	fps_Mesh = new AnimatedModel(myWorld->GetCore(), "Models/Uzi.gem");
+	fps_Mesh = new AnimatedModel(myWorld->GetCore(), FPS_MODEL);
+	setTransform(fps_Mesh);
 	fps_Mesh->SetWorldScaling(Vec3(0.1f, 0.1f, 0.1f));
 	setCollidable(true);
 	setCollisionShapeType(CollisionShapeType::Sphere);
 	animatedInstance = new AnimationInstance();
-	animatedInstance->init(&fps_Mesh->animation, 0);
+	animatedInstance->init(&fps_Mesh->getAnimation(), 0);
 	m_actorType = ActorType::Player;
-	calculateLocalCollisionShape();
+	setCollisionLayer(CollisionLayer::Player);
 
 	animStateMachine = new FPSAnimationStateMachine(fps_Mesh, animatedInstance);
+	addRenderable(RenderableComponent::animated(fps_Mesh, ANIM_LIGHT_PIPE, animatedInstance, animStateMachine));
+	addAnimator(animStateMachine);
+	calculateLocalCollisionShape();
 }
 
 FPSActor::~FPSActor()
@@ -183,12 +425,6 @@ FPSActor::~FPSActor()
 	delete fps_Mesh;
 }
 
-void FPSActor::draw()
-{
-	World* myWorld = World::Get();
-	fps_Mesh->drawSingle(myWorld->GetCore(), myWorld->GetPSOManager(), ANIM_LIGHT_PIPE, myWorld->GetPipelines(), animatedInstance, myWorld->GetDeltatime(), animStateMachine);
-}
-
 void FPSActor::updatePos(Vec3 pos)
 {
 	fps_Mesh->SetWorldPos(pos);
@@ -209,45 +445,15 @@ void FPSActor::updateWorldMatrix(Vec3 pos, float yaw, float pitch)
 
 }
 
-void FPSActor::calculateLocalCollisionShape()
-{
-
-	if (!fps_Mesh)
-		return;
-
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto* mesh : fps_Mesh->meshes)
-	{
-
-		auto vertices = mesh->getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
 void FPSActor::OnBeginPlay()
 {
 }
 
-void FPSActor::OnTick(float dt)
-{
-	if (animStateMachine) {
-		animStateMachine->Update(dt); 
-	}
-}
-
 namespace {
 	struct BoxActorRegistrar {
 		BoxActorRegistrar() {
 			Actor::RegisterActor("BoxActor", []() { return new BoxActor(); });
+			Actor::RegisterActorAssets("BoxActor", { { BOX_MESH }, {}, {} });
 		}
 	} boxActorRegistrar;
 }
@@ -255,7 +461,9 @@ namespace {
 BoxActor::BoxActor()
 {
 	World* myWorld = World::Get();
-	box = new StaticMesh(myWorld->GetCore(), "Models/box_024.gem");
+	box = new StaticMesh(myWorld->GetCore(), BOX_MESH);
+	setTransform(box);
+	addRenderable(RenderableComponent::mesh(box, STATIC_PIPE));
 	setCollidable(true);
 	setCollisionShapeType(CollisionShapeType::AABB);
 	box->SetWorldScaling(Vec3(0.1f, 0.1f, 0.1f));
@@ -263,37 +471,11 @@ BoxActor::BoxActor()
 	calculateLocalCollisionShape();
 }
 
-void BoxActor::draw()
-{
-	World* myWorld = World::Get();
-	box->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_PIPE, myWorld->GetPipelines());
-}
-
-void BoxActor::calculateLocalCollisionShape()
-{
-	if (!box)
-		return;
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto mesh : box->meshes)
-	{
-		auto vertices = mesh.getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
 namespace {
 	struct GroundActorRegistrar {
 		GroundActorRegistrar() {
 			Actor::RegisterActor("GroundActor", []() { return new GroundActor(); });
+			Actor::RegisterActorAssets("GroundActor", { {}, {}, { GROUND_TEXTURE, GROUND_NORMAL_TEXTURE } });
 		}
 	} groundActorRegistrar;
 }
@@ -302,44 +484,19 @@ GroundActor::GroundActor()
 {
 	World* myWorld = World::Get();
 	ground = new StaticMesh();
-	ground->CreateFromPlane(myWorld->GetCore(), 10000, 20000, 10, 10,"Models/Textures/concrete_floor_damaged_01_diff_1k.png","Models/Textures/concrete_floor_damaged_01_nor_dx_1k.png");
+	ground->CreateFromPlane(myWorld->GetCore(), 10000, 20000, 10, 10, GROUND_TEXTURE, GROUND_NORMAL_TEXTURE);
+	setTransform(ground);
+	addRenderable(RenderableComponent::mesh(ground, STATIC_LIGHT_PIPE));
 	setCollidable(true);
 	setCollisionShapeType(CollisionShapeType::AABB);
 	calculateLocalCollisionShape();
 }
 
-void GroundActor::draw()
-{
-	World* myWorld = World::Get();
-	
-	ground->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_LIGHT_PIPE, myWorld->GetPipelines());
-}
-
-void GroundActor::calculateLocalCollisionShape()
-{
-	if (!ground)
-		return;
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto mesh : ground->meshes)
-	{
-		auto vertices = mesh.getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
 namespace {
 	struct ContainerBlueActorRegistrar {
 		ContainerBlueActorRegistrar() {
 			Actor::RegisterActor("ContainerBlueActor", []() { return new ContainerBlueActor(); });
+			Actor::RegisterActorAssets("ContainerBlueActor", { { CONTAINER_MESH }, {}, {} });
 		}
 	} containerBlueActorRegistrar;
 }
@@ -347,46 +504,23 @@ namespace {
 ContainerBlueActor::ContainerBlueActor()
 {
 	World* myWorld = World::Get();
-	container = new StaticMesh(myWorld->GetCore(), "Models/container_005.gem");
+	container = new StaticMesh(myWorld->GetCore(), CONTAINER_MESH);
+	setTransform(container);
+	addRenderable(RenderableComponent::mesh(container, STATIC_PIPE));
 
 	container->SetWorldRotationRadian(Vec3(0.f, PI / 2, 0.f));
 	setCollidable(true);
-	setCollisionShapeType(CollisionShapeType::OBB);
+	// hulls follow the container when it is rotated, the box alone is too coarse
+	collider().convexHulls = ConvexHull::getShared(CONTAINER_MESH, *container);
+	setCollisionShapeType(CollisionShapeType::Hull);
 	calculateLocalCollisionShape();
 }
 
-void ContainerBlueActor::draw()
-{
-	World* myWorld = World::Get();
-
-	container->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_PIPE, myWorld->GetPipelines());
-}
-
-void ContainerBlueActor::calculateLocalCollisionShape()
-{
-	if (!container)
-		return;
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto mesh : container->meshes)
-	{
-		auto vertices = mesh.getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
 namespace {
 	struct BlockActorRegistrar {
 		BlockActorRegistrar() {
 			Actor::RegisterActor("BlockActor", []() { return new BlockActor(); });
+			Actor::RegisterActorAssets("BlockActor", { { BOX_MESH }, {}, {} });
 		}
 	} blockActorRegistrar;
 }
@@ -394,7 +528,12 @@ namespace {
 BlockActor::BlockActor()
 {
 	World* myWorld = World::Get();
-	box = new StaticMesh(myWorld->GetCore(), "Models/box_024.gem");
+	box = new StaticMesh(myWorld->GetCore(), BOX_MESH);
+	setTransform(box);
+	// an invisible wall, only the collider is used
+	RenderableComponent renderable = RenderableComponent::mesh(box, STATIC_PIPE);
+	renderable.visible = false;
+	addRenderable(renderable);
 	setCollidable(true);
 	setCollisionShapeType(CollisionShapeType::AABB);
 	box->SetWorldScaling(Vec3(0.1f, 0.1f, 0.1f));
@@ -402,38 +541,12 @@ BlockActor::BlockActor()
 	calculateLocalCollisionShape();
 }
 
-void BlockActor::draw()
-{
-	World* myWorld = World::Get();
-
-	//box->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_PIPE, myWorld->GetPipelines());
-}
-
-void BlockActor::calculateLocalCollisionShape()
-{
-	if (!box)
-		return;
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto mesh : box->meshes)
-	{
-		auto vertices = mesh.getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
 namespace {
 	struct ObstacleActorRegistrar {
 		ObstacleActorRegistrar() {
 			Actor::RegisterActor("ObstacleActor", []() { return new ObstacleActor(); });
+			Actor::RegisterRecordSchema<ObstacleActor>("ObstacleActor");
+			Actor::RegisterActorAssets("ObstacleActor", { { OBSTACLE_MESH }, {}, {} });
 		}
 	} obstacleActorRegistrar;
 }
@@ -444,7 +557,9 @@ ObstacleActor::ObstacleActor(int count, Vec3 offset)
 	m_offset = offset;
 
 	World* myWorld = World::Get();
-	obstacle = new StaticMesh(myWorld->GetCore(), "Models/obstacle_003.gem");
+	obstacle = new StaticMesh(myWorld->GetCore(), OBSTACLE_MESH);
+	setTransform(obstacle);
+	addRenderable(RenderableComponent::instanced(obstacle, STATIC_INSTANCE_LIGHT_PIPE, &instanceMatrices));
 	//setCollidable(true);
 	//setCollisionShapeType(CollisionShapeType::AABB);
 	obstacle->SetWorldScaling(Vec3(0.1f, 0.1f, 0.1f));
@@ -477,15 +592,24 @@ void ObstacleActor::generateInstanceMatrices(int count, Vec3 offset)
 	}
 }
 
-void ObstacleActor::draw()
-{	
-	World* myWorld = World::Get();
+uint32_t ObstacleActor::GetRecordDataSize() const
+{
+	return RecordSchema().getRecordSize();
+}
+
+void ObstacleActor::SaveRecordData(unsigned char* data, LevelStringWriter& strings) const
+{
+	RecordSchema().save(*this, data, strings);
+}
 
-	obstacle->drawInstances(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_INSTANCE_LIGHT_PIPE, myWorld->GetPipelines(), &instanceMatrices, m_instanceCount);
+void ObstacleActor::LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings)
+{
+	RecordSchema().load(*this, data, size, strings);
 }
 
-void ObstacleActor::calculateLocalCollisionShape()
+void ObstacleActor::onRecordLoaded()
 {
+	generateInstanceMatrices(m_instanceCount, m_offset);
 }
 
 namespace {
@@ -496,6 +620,17 @@ namespace {
 				
 				return new GeneralMeshActor();
 				});
+			Actor::RegisterRecordSchema<GeneralMeshActor>("GeneralMeshActor");
+			// the default mesh, and the one the record names
+			Actor::RegisterActorAssets("GeneralMeshActor", { { CONTAINER_MESH }, {}, {} },
+				[](const unsigned char* data, uint32_t size, const LevelStringReader& strings, AssetList& assets)
+				{
+					if (size < sizeof(LevelStringRef))
+						return;
+					LevelStringRef path;
+					memcpy(&path, data, sizeof(path));
+					assets.add({ { strings.get(path) }, {}, {} });
+				});
 		}
 	} generalMeshActorRegistrar; 
 }
@@ -505,33 +640,6 @@ GeneralMeshActor::GeneralMeshActor(std::string path)
 	initMesh(path);
 }
 
-void GeneralMeshActor::draw()
-{
-	World* myWorld = World::Get();
-	mesh->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_PIPE, myWorld->GetPipelines());
-}
-
-void GeneralMeshActor::calculateLocalCollisionShape()
-{
-	if (!mesh)
-		return;
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto submesh : mesh->meshes)
-	{
-		auto vertices = submesh.getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
 void GeneralMeshActor::initMesh(const std::string& path)
 {
 	m_path = path;
@@ -542,13 +650,62 @@ void GeneralMeshActor::initMesh(const std::string& path)
 		mesh = nullptr;
 	}
 
+	// a loaded actor keeps its mesh collider, the shape type comes from LoadBase
+	bool useMeshCollider = getUseMeshCollider();
+
 	// Recreate the mesh
 	World* myWorld = World::Get();
 	mesh = new StaticMesh(myWorld->GetCore(), path);
+	setTransform(mesh);
+	addRenderable(RenderableComponent::mesh(mesh, STATIC_PIPE));
 	setCollidable(true);
 	setCollisionShapeType(CollisionShapeType::AABB);
 	mesh->SetWorldScaling(Vec3(0.1f, 0.1f, 0.1f));
 	calculateLocalCollisionShape();
+	setUseMeshCollider(useMeshCollider);
+}
+
+void GeneralMeshActor::setUseMeshCollider(bool useMeshCollider)
+{
+	if (useMeshCollider)
+	{
+		collider().meshCollider = MeshCollider::getShared(m_path, *mesh);
+		setCollisionShapeType(CollisionShapeType::Mesh);
+	}
+	else
+	{
+		collider().meshCollider.reset();
+		if (getUseMeshCollider())
+			setCollisionShapeType(CollisionShapeType::AABB);
+	}
+	updateBroadphase();
+}
+
+uint32_t GeneralMeshActor::GetRecordDataSize() const
+{
+	return RecordSchema().getRecordSize();
+}
+
+void GeneralMeshActor::SaveRecordData(unsigned char* data, LevelStringWriter& strings) const
+{
+	RecordSchema().save(*this, data, strings);
+}
+
+void GeneralMeshActor::LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings)
+{
+	RecordSchema().load(*this, data, size, strings);
+}
+
+void GeneralMeshActor::onRecordLoaded()
+{
+	// the new mesh brings its own transform, keep the one the base record set
+	Vec3 scale = getWorldScale();
+	Vec3 pos = getWorldPos();
+	Vec3 rot = getWorldRotation();
+	initMesh(m_path);
+	mesh->SetWorldPos(pos);
+	mesh->SetWorldRotationRadian(rot);
+	mesh->SetWorldScaling(scale);
 }
 
 
@@ -559,37 +716,58 @@ void BulletActor::OnTick(float dt)
 	// Update the lifecycle, automatically destroy upon timeout
 	m_lifeTime += dt;
 	if (m_lifeTime >= MAX_LIFE_TIME) {
-		Destroy();
+		despawn();
 		return;
 	}
 
-	// move
-	setWorldPos(getWorldPos() + m_direction * m_speed * dt);
-	// check collision
-	calculateLocalCollisionShape();
-	auto collidableActors = myWorld->getCollidableActors();
-	std::vector<Actor*> collisions = CollisionResolver::CheckCollision(this, collidableActors);
-
-	for (auto* actor : collisions)
+	// sweep along this tick's path so thin walls cannot be skipped at low tick rates
+	Vec3 motion = m_direction * m_speed * dt;
+	SceneQuery sceneQuery(myWorld->GetLevel()->GetBroadphase());
+	QueryFilter filter;
+	filter.ignoreActor = this;
+	filter.layerMask = CollisionMatrix::getMask(getCollisionLayer());
+	SweepHit hits[MAX_SWEEP_HITS];
+	int hitCount = sceneQuery.sweepSphere(getWorldSphere(), motion, hits, MAX_SWEEP_HITS, filter);
+
+	float travel = 1.0f;
+	for (int i = 0; i < hitCount; i++)
 	{
-		if (actor->getActorType() == ActorType::Static)
+		const SweepHit& hit = hits[i];
+		if (hit.actor->getActorType() == ActorType::Static)
 		{
-			Destroy();
+			// stop at the first wall, enemies behind it are safe
+			travel = hit.toi;
+			despawn();
+			break;
 		}
-		else if (actor->getActorType() == ActorType::Enemy)
+		else if (hit.actor->getActorType() == ActorType::Enemy)
 		{
-			// execute damage api
-			dynamic_cast<EnemyActor*>(actor)->animStateMachine->TriggerDeath();
-
+			// execute damage api, applied at the end of the gameplay phase
+			myWorld->GetLevel()->QueueProjectileHit(hit.actor, m_damage);
 		}
 	}
+
+	// move
+	setWorldPos(getWorldPos() + motion * travel);
+}
+
+namespace {
+	struct BulletActorRegistrar {
+		BulletActorRegistrar() {
+			// direction, speed and damage come from the record
+			Actor::RegisterActor("BulletActor", []() { return new BulletActor(Vec3(), Vec3(0.f, 0.f, 1.f)); });
+			Actor::RegisterRecordSchema<BulletActor>("BulletActor");
+		}
+	} bulletActorRegistrar;
 }
 
 BulletActor::BulletActor(const Vec3 pos, const Vec3 dir, float speed, int damage)
 {
 	World* myWorld = World::Get();
-	m_bulletMesh = new StaticMesh();
-	m_bulletMesh->CreateFromSphere(myWorld->GetCore(), 64, 64, 10, "Models/Textures/arms_1_Albedo_nh.png");
+	// low poly, every bullet shares this one asset
+	m_bulletMesh.CreateFromSphere(myWorld->GetCore(), 12, 12, 10, "Models/Textures/arms_1_Albedo_nh.png");
+	setTransform(&m_bulletMesh);
+	addRenderable(RenderableComponent::mesh(&m_bulletMesh, STATIC_PIPE));
 	// init mesh 
 	setWorldPos(pos);
 	//setWorldScale(Vec3(1.f, 1.f, 1.f));
@@ -598,6 +776,7 @@ BulletActor::BulletActor(const Vec3 pos, const Vec3 dir, float speed, int damage
 	m_damage = damage;
 	m_lifeTime = 0.0f;
 	m_actorType = ActorType::Bullet;
+	setCollisionLayer(CollisionLayer::Projectile);
 
 	
 	
@@ -609,37 +788,46 @@ BulletActor::BulletActor(const Vec3 pos, const Vec3 dir, float speed, int damage
 	calculateLocalCollisionShape();
 }
 
-void BulletActor::draw()
+void BulletActor::respawn(const Vec3& pos, const Vec3& dir, float speed, int damage, ActorPool<BulletActor>* pool)
 {
-	World* myWorld = World::Get();
-	m_bulletMesh->draw(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_PIPE, myWorld->GetPipelines());
+	// no interpolation from wherever the bullet expired
+	m_bulletMesh.TeleportWorldPos(pos);
+	m_direction = dir.normalize();
+	m_speed = speed;
+	m_damage = damage;
+	m_lifeTime = 0.0f;
+	m_pool = pool;
+	setActive(true);
 }
 
-void BulletActor::calculateLocalCollisionShape()
+void BulletActor::despawn()
 {
-	if (!m_bulletMesh)
-		return;
+	if (m_pool != nullptr)
+		m_pool->release(this);
+	else
+		Destroy();
+}
 
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
+uint32_t BulletActor::GetRecordDataSize() const
+{
+	return RecordSchema().getRecordSize();
+}
 
-	for (auto mesh : m_bulletMesh->meshes)
-	{
-		auto vertices = mesh.getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
+void BulletActor::SaveRecordData(unsigned char* data, LevelStringWriter& strings) const
+{
+	RecordSchema().save(*this, data, strings);
+}
 
-	m_localSphere.centre = m_localAABB.getCenter();
+void BulletActor::LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings)
+{
+	RecordSchema().load(*this, data, size, strings);
 }
 
 namespace {
 	struct EnemyActorRegistrar {
 		EnemyActorRegistrar() {
 			Actor::RegisterActor("EnemyActor", []() { return new EnemyActor(); });
+			Actor::RegisterActorAssets("EnemyActor", { {}, { ENEMY_MODEL }, {} });
 		}
 	} enemyActorRegistrar;
 }
@@ -647,16 +835,20 @@ namespace {
 EnemyActor::EnemyActor()
 {
 	World* myWorld = World::Get();
-	enemy_Mesh = new AnimatedModel(myWorld->GetCore(), "Models/Duck-white.gem");
+	enemy_Mesh = new AnimatedModel(myWorld->GetCore(), ENEMY_MODEL);
+	setTransform(enemy_Mesh);
 	enemy_Mesh->SetWorldScaling(Vec3(0.1f, 0.1f, 0.1f));
 	setCollidable(true);
 	setCollisionShapeType(CollisionShapeType::Sphere);
 	animatedInstance = new AnimationInstance();
-	animatedInstance->init(&enemy_Mesh->animation, 0);
+	animatedInstance->init(&enemy_Mesh->getAnimation(), 0);
 	m_actorType = ActorType::Enemy;
-	calculateLocalCollisionShape();
+	setCollisionLayer(CollisionLayer::Enemy);
 
 	animStateMachine = new EnemyAnimationStateMachine(enemy_Mesh, animatedInstance);
+	addRenderable(RenderableComponent::animated(enemy_Mesh, ANIM_LIGHT_PIPE, animatedInstance, animStateMachine));
+	addAnimator(animStateMachine);
+	calculateLocalCollisionShape();
 }
 
 EnemyActor::~EnemyActor()
@@ -666,44 +858,21 @@ EnemyActor::~EnemyActor()
 	delete enemy_Mesh;
 }
 
-void EnemyActor::draw()
+void EnemyActor::OnBeginPlay()
 {
-	World* myWorld = World::Get();
-	enemy_Mesh->drawSingle(myWorld->GetCore(), myWorld->GetPSOManager(), ANIM_LIGHT_PIPE, myWorld->GetPipelines(), animatedInstance, myWorld->GetDeltatime(), animStateMachine);
 }
 
-void EnemyActor::calculateLocalCollisionShape()
-{
-	if (!enemy_Mesh)
-		return;
-
-	m_localAABB.reset();
-	m_localSphere = Sphere(Vec3(0, 0, 0), 0.0f);
-
-	for (auto* mesh : enemy_Mesh->meshes)
-	{
-		auto vertices = mesh->getVertices(); 
-		for (const auto& v : vertices)
-		{
-			m_localAABB.extend(v);
-			m_localSphere.extend(v);
-		}
-	}
-
-	m_localSphere.centre = m_localAABB.getCenter();
-}
-
-void EnemyActor::OnBeginPlay()
+void EnemyActor::OnProjectileHit(int damage)
 {
+	if (animStateMachine)
+		animStateMachine->TriggerDeath();
 }
 
 void EnemyActor::OnTick(float dt)
 {
-	if (animStateMachine) {
-		animStateMachine->Update(dt); 
-	}
-	if (animStateMachine->IsDeathFinished())
+	if (animStateMachine && animStateMachine->IsDeathFinished())
 	{
 		Destroy();
 	}
 }
+
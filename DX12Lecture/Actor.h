@@ -3,6 +3,14 @@
 #include "GeneralEvent.h"
 #include "ICameraControllable.h"
 #include "Collision.h"
+#include "DynamicAABBTree.h"
+#include "MeshCollider.h"
+#include "ConvexHull.h"
+#include "SlotMap.h"
+#include "Components.h"
+#include "ActorPool.h"
+#include "AssetCache.h"
+#include "ActorSchema.h"
 #include "Animation/FPSAnimationStateMachine.h"
 #include "Animation/EnemyAnimationStateMachine.h"
 #include <fstream>
@@ -10,6 +18,13 @@
 #include <map>
 #include <functional>
 
+// handle into the level's actor storage
+using ActorHandle = SlotHandle;
+
+struct ActorRecord;
+class LevelStringWriter;
+class LevelStringReader;
+
 enum class ActorType {
 	None,
 	Player,        
@@ -20,93 +35,158 @@ enum class ActorType {
 class Actor	: public GeneralEvent
 {
 	
-	// collision system
+	// components, stored in per-type arrays so systems can loop over them without the actor
 protected:
-	CollisionShapeType m_collisionShapeType = CollisionShapeType::None;
-	AABB m_localAABB;       
-	Sphere m_localSphere;   
-	bool m_isCollidable = false; 
+	ComponentHandle m_collider;
+	// invalid for actors that draw nothing or have no animation
+	ComponentHandle m_renderable;
+	ComponentHandle m_animator;
+	// transform of the mesh that places the actor, set by each subclass
+	WorldPosParam* m_transform = nullptr;
 	// Actor type
 	ActorType m_actorType;
 	
 	bool m_isDestroyed;
+	// inactive actors are parked in a pool: skipped by tick, draw and save, no broadphase proxy
+	bool m_isActive = true;
+	// set by the level that stores the actor
+	ActorHandle m_handle;
+	std::string m_name;
+
+	ColliderComponent& collider() const { return *ComponentArray<ColliderComponent>::Get().get(m_collider); }
+	// call after the local shape or shape type changes
+	void markCollisionShapeDirty() { collider().worldShapeVersion = 0; }
+	// the actor is placed by this transform from now on
+	void setTransform(WorldPosParam* transform);
+	void addRenderable(const RenderableComponent& renderable);
+	void addAnimator(AnimationStateMachine* stateMachine);
 public:
-	Actor() : m_actorType(ActorType::Static), m_isDestroyed(false) {};
-	virtual ~Actor() = default;
+	Actor();
+	virtual ~Actor();
 	
 
 	// collision api
-	void setCollidable(bool enable) { m_isCollidable = enable; }
-	bool isCollidable() const { return m_isCollidable; }
-	void setCollisionShapeType(CollisionShapeType type) { m_collisionShapeType = type; }
-	CollisionShapeType getCollisionShapeType() const { return m_collisionShapeType; }
+	void setCollidable(bool enable);
+	bool isCollidable() const { return collider().collidable; }
+	void setCollisionShapeType(CollisionShapeType type) { collider().shapeType = type; markCollisionShapeDirty(); }
+	CollisionShapeType getCollisionShapeType() const { return collider().shapeType; }
 	ActorType getActorType() const { return m_actorType; }
+	// moves the broadphase proxy to the new layer's tree
+	void setCollisionLayer(CollisionLayer layer);
+	CollisionLayer getCollisionLayer() const { return collider().layer; }
+	static CollisionLayer defaultCollisionLayer(ActorType type);
 	bool getIsDestroyed() const { return m_isDestroyed; }
-
-	
-	const AABB& getLocalAABB() const { return m_localAABB; }
-	const Sphere& getLocalSphere() const { return m_localSphere; }
-
-
-	
-	virtual AABB getWorldAABB() const
+	void setActive(bool active);
+	bool isActive() const { return m_isActive; }
+	// a projectile passed through this actor
+	virtual void OnProjectileHit(int damage) {}
+	ActorHandle getHandle() const { return m_handle; }
+	void setHandle(ActorHandle handle) { m_handle = handle; }
+	const std::string& getName() const { return m_name; }
+	void setName(const std::string& name) { m_name = name; }
+	// tags the components, so systems only run on the current level's actors
+	void setLevel(const Level* level);
+	RenderableComponent* getRenderable() const { return ComponentArray<RenderableComponent>::Get().get(m_renderable); }
+
+	
+	const AABB& getLocalAABB() const { return collider().localAABB; }
+	const Sphere& getLocalSphere() const { return collider().localSphere; }
+
+	// broadphase api
+	void attachBroadphase(LayeredBroadphase* broadphase);
+	void detachBroadphase();
+	// refit the proxy to where the actor was put or its new shape, the tick refit predicts motion
+	void updateBroadphase() { collider().refitProxy(false); }
+	int getProxyId() const { return collider().proxyId; }
+	// world bounds of whichever collision shape is in use
+	AABB getBroadphaseAABB() const { return collider().getBroadphaseAABB(); }
+
+	// world shapes are cached and only rebuilt when the transform version changes
+	const AABB& getWorldAABB() const
 	{
-		if (m_collisionShapeType != CollisionShapeType::AABB)
-			return AABB();
-
-		Matrix worldMat = getWorldMatrix();
-		auto vertices = m_localAABB.getVertices();
-		AABB worldAABB;
-		worldAABB.reset();
-		for (const auto& v : vertices)
-		{
-			Vec3 worldV = worldMat.mulPoint(v); 
-			worldAABB.extend(worldV);
-		}
-		return worldAABB;
+		ColliderComponent& c = collider();
+		c.refreshWorldShapes();
+		return c.worldAABB;
 	}
 
 	// OBB (Oriented bounding box)
-	virtual OBB getWorldOBB() const
+	const OBB& getWorldOBB() const
 	{
-		if (m_collisionShapeType != CollisionShapeType::OBB)
-			return OBB();
+		ColliderComponent& c = collider();
+		c.refreshWorldShapes();
+		return c.worldOBB;
+	}
 
-		Matrix worldMat = getWorldMatrix();
-		return OBB::fromAABB(m_localAABB, worldMat);
+	const Sphere& getWorldSphere() const
+	{
+		ColliderComponent& c = collider();
+		c.refreshWorldShapes();
+		return c.worldSphere;
 	}
 
-	virtual Sphere getWorldSphere() const
+	const MeshCollider* getMeshCollider() const { return collider().meshCollider.get(); }
+	const std::vector<ConvexHull>* getConvexHulls() const { return collider().convexHulls.get(); }
+	// inverse world matrix, only kept up to date for mesh and hull colliders
+	const Matrix& getWorldToLocal() const
 	{
-		if (m_collisionShapeType != CollisionShapeType::Sphere)
-			return Sphere();
+		ColliderComponent& c = collider();
+		c.refreshWorldShapes();
+		return c.worldToLocal;
+	}
 
-		Matrix worldMat = getWorldMatrix();
-		Vec3 worldCentre = worldMat.mulPoint(m_localSphere.centre);
-		
-		Vec3 scale = getWorldScale();
-		float worldRadius = m_localSphere.radius * std::max({ scale.x, scale.y, scale.z });
-		return Sphere(worldCentre, worldRadius);
+	// world space convex pieces of the collision shape, for the generic narrowphase.
+	// Hull pieces point at the cached world matrix, use them before the actor moves again
+	template<typename Callback>
+	void forEachConvexShape(Callback&& callback) const
+	{
+		ColliderComponent& c = collider();
+		c.refreshWorldShapes();
+		switch (c.shapeType)
+		{
+		case CollisionShapeType::AABB:
+			callback(ConvexShape::fromAABB(c.worldAABB));
+			break;
+		case CollisionShapeType::Sphere:
+			callback(ConvexShape::fromSphere(c.worldSphere));
+			break;
+		case CollisionShapeType::Hull:
+			if (c.convexHulls)
+			{
+				for (const ConvexHull& hull : *c.convexHulls)
+					callback(ConvexShape::fromHull(hull, c.worldMatrix));
+			}
+			else
+			{
+				callback(ConvexShape::fromOBB(c.worldOBB));
+			}
+			break;
+		case CollisionShapeType::OBB:
+		case CollisionShapeType::Mesh:
+			callback(ConvexShape::fromOBB(c.worldOBB));
+			break;
+		default:
+			break;
+		}
 	}
 
-	// Calculate local collision bodies from Mesh
-	virtual void calculateLocalCollisionShape() = 0;
+	// local collision bodies around the vertices of the renderable's mesh
+	void calculateLocalCollisionShape();
 	// **** world info interface ****//
 	
-	virtual Matrix getWorldMatrix() const = 0;
+	const Matrix& getWorldMatrix() const { return m_transform->GetWorldMatrix(); }
+	unsigned int getTransformVersion() const { return m_transform->GetTransformVersion(); }
+	// world matrix interpolated between the last two simulation ticks, for drawing
+	Matrix getRenderMatrix() const { return m_transform->GetRenderMatrix(); }
 
-	virtual Vec3 getWorldPos() const = 0;
-	virtual void setWorldPos(Vec3 worldPos) = 0;
+	Vec3 getWorldPos() const { return m_transform->GetWorldPos(); }
+	void setWorldPos(Vec3 worldPos) { m_transform->SetWorldPos(worldPos); }
 
-	virtual Vec3 getWorldScale() const = 0;
-	virtual void setWorldScale(Vec3 worldScale) = 0;
+	Vec3 getWorldScale() const { return m_transform->GetWorldScale(); }
+	void setWorldScale(Vec3 worldScale) { m_transform->SetWorldScaling(worldScale); }
 
-	virtual Vec3 getWorldRotation() const = 0;
-	virtual void setWorldRotation(Vec3 worldRotation) = 0;
+	Vec3 getWorldRotation() const { return m_transform->GetWorldRotationRadian(); }
+	void setWorldRotation(Vec3 worldRotation) { m_transform->SetWorldRotationRadian(worldRotation); }
 	// **** world info interface ****//
-public:
-	// draw
-	virtual void draw() = 0;
 
 	// factory mode
 public:
@@ -115,6 +195,40 @@ public:
 	static void RegisterActor(const std::string& className, ActorCreator creator);
 	static Actor* CreateActorByClassName(const std::string& className);
 
+	// Assets each class loads in its constructor, plus a lister for the ones a record's own
+	// data names, so a level load can fetch all of them before creating any actor
+	using RecordAssetLister = std::function<void(const unsigned char* data, uint32_t size, const LevelStringReader& strings, AssetList& assets)>;
+	struct ClassAssets
+	{
+		AssetList assets;
+		RecordAssetLister recordAssets;
+	};
+	static std::map<std::string, ClassAssets> m_classAssets;
+	static void RegisterActorAssets(const std::string& className, AssetList assets, RecordAssetLister recordAssets = nullptr);
+	static AssetList GetClassAssets(const std::string& className);
+	// only the ones named by the record, the class's own come from GetClassAssets
+	static void CollectRecordAssets(const std::string& className, const unsigned char* data, uint32_t size,
+		const LevelStringReader& strings, AssetList& assets);
+
+	// Loads the class data of all the records of a class in one call, for classes with a
+	// property schema (ActorSchema.h). The others load record by record through LoadRecordData
+	using RecordBulkLoader = std::function<void(Actor* const* actors, int count, const unsigned char* data,
+		uint32_t stride, uint32_t size, const LevelStringReader& strings)>;
+	static std::map<std::string, RecordBulkLoader> m_recordLoaders;
+	static void RegisterRecordLoader(const std::string& className, RecordBulkLoader loader);
+	// nullptr for classes without a schema
+	static const RecordBulkLoader* GetRecordLoader(const std::string& className);
+	template<typename T>
+	static void RegisterRecordSchema(const std::string& className)
+	{
+		static_assert(T::RecordSchema().isAppendOnly(), "record fields are only ever appended");
+		RegisterRecordLoader(className, [](Actor* const* actors, int count, const unsigned char* data,
+			uint32_t stride, uint32_t size, const LevelStringReader& strings)
+		{
+			T::RecordSchema().loadBulk(actors, count, data, stride, size, strings);
+		});
+	}
+
 	// Serialization-related
 public:
 	
@@ -123,6 +237,14 @@ public:
 	virtual void Save(std::ofstream& file) const = 0;
 	virtual void Load(std::ifstream& file) = 0;
 
+	// v2 level records (Levels/LevelFormat.h): the base fields, then a fixed size block of class data
+	void SaveBaseRecord(ActorRecord& record) const;
+	void LoadBaseRecord(const ActorRecord& record);
+	virtual uint32_t GetRecordDataSize() const { return 0; }
+	virtual void SaveRecordData(unsigned char* data, LevelStringWriter& strings) const {}
+	// size is what the file holds, older files may hold less than the class writes now
+	virtual void LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings) {}
+
 protected:
 	
 	void SaveBase(std::ofstream& file) const;
@@ -134,23 +256,7 @@ class SkyBoxActor: public Actor
 	StaticMesh* skybox;
 public:
 	SkyBoxActor();
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override {}
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return skybox->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return skybox->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { skybox->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return skybox->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { skybox->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return skybox->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { skybox->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
+	~SkyBoxActor() override { delete skybox; }
 
 public:
 	
@@ -178,44 +284,35 @@ public:
 
 	
 	TreeActor(int count = 50, Vec3 transIncrement = Vec3(0.f, 0.f, 20.f));
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override {}
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return willow->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return willow->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { willow->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return willow->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { willow->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return willow->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { willow->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
+	~TreeActor() override { delete willow; }
 
 public:
 	// class name with tree actor
 	std::string GetClassName() const override { return "TreeActor"; }
+	// saved fields, defaults match the constructor's
+	static constexpr auto RecordSchema()
+	{
+		return makeActorSchema(&TreeActor::onRecordLoaded,
+			actorProperty("instanceCount", &TreeActor::m_instanceCount, 1, 50),
+			actorProperty("transIncrement", &TreeActor::m_transIncrement, 1, { 0.f, 0.f, 20.f }));
+	}
 	// save / load with Serialization
 	void Save(std::ofstream& file) const override
 	{
 		SaveBase(file);
-		
-		file.write(reinterpret_cast<const char*>(&m_instanceCount), sizeof(int));
-		file.write(reinterpret_cast<const char*>(&m_transIncrement), sizeof(Vec3));
+		RecordSchema().write(*this, file);
 	}
 	void Load(std::ifstream& file) override
 	{
 		LoadBase(file);
-		
-		file.read(reinterpret_cast<char*>(&m_instanceCount), sizeof(int));
-		file.read(reinterpret_cast<char*>(&m_transIncrement), sizeof(Vec3));
-
-		generateInstanceMatrices(m_instanceCount, m_transIncrement);
+		RecordSchema().read(*this, file);
 	}
+	uint32_t GetRecordDataSize() const override;
+	void SaveRecordData(unsigned char* data, LevelStringWriter& strings) const override;
+	void LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings) override;
+private:
+	// the instances follow from the loaded fields
+	void onRecordLoaded();
 };
 
 class WaterActor : public Actor
@@ -224,23 +321,8 @@ class WaterActor : public Actor
 
 public:
 	WaterActor();
-	virtual void draw() override;
+	~WaterActor() override { delete water; }
 
-	
-	virtual void calculateLocalCollisionShape() override {}
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return water->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return water->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { water->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return water->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { water->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return water->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { water->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 public:
 	
 	std::string GetClassName() const override { return "WaterActor"; }
@@ -265,7 +347,6 @@ public:
 public:
 	FPSActor();
 	virtual ~FPSActor() override; 
-	virtual void draw() override;
 
 	virtual void updatePos(Vec3 pos) override;
 
@@ -275,24 +356,7 @@ public:
 
 	virtual void updateWorldMatrix(Vec3 pos, float yaw, float pitch) override;
 
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return fps_Mesh->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return fps_Mesh->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { fps_Mesh->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return fps_Mesh->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { fps_Mesh->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return fps_Mesh->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { fps_Mesh->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
-
 	virtual void OnBeginPlay() override;
-	virtual void OnTick(float dt) override;
 public:
 	
 	std::string GetClassName() const override { return "FPSActor"; }
@@ -316,26 +380,10 @@ public:
 
 	EnemyActor();
 	virtual ~EnemyActor() override; 
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return enemy_Mesh->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return enemy_Mesh->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { enemy_Mesh->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return enemy_Mesh->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { enemy_Mesh->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return enemy_Mesh->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { enemy_Mesh->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 
 	virtual void OnBeginPlay() override;
 	virtual void OnTick(float dt) override;
+	virtual void OnProjectileHit(int damage) override;
 
 	void Destroy() { m_isDestroyed = true; }
 
@@ -357,23 +405,7 @@ class BoxActor : public Actor
 	StaticMesh* box;
 public:
 	BoxActor();
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return box->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return box->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { box->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return box->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { box->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return box->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { box->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
+	~BoxActor() override { delete box; }
 
 public:
 	
@@ -394,23 +426,8 @@ class GroundActor : public Actor
 	StaticMesh* ground;
 public:
 	GroundActor();
-	virtual void draw() override;
+	~GroundActor() override { delete ground; }
 
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return ground->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return ground->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { ground->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return ground->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { ground->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return ground->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { ground->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 public:
 	
 	std::string GetClassName() const override { return "GroundActor"; }
@@ -430,23 +447,8 @@ class ContainerBlueActor : public Actor
 	StaticMesh* container;
 public:
 	ContainerBlueActor();
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return container->GetWorldMatrix(); }
+	~ContainerBlueActor() override { delete container; }
 
-	virtual Vec3 getWorldPos() const override { return container->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { container->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return container->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { container->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return container->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { container->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 public:
 	
 	std::string GetClassName() const override { return "ContainerBlueActor"; }
@@ -466,23 +468,8 @@ class BlockActor :public Actor
 	StaticMesh* box;
 public:
 	BlockActor();
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return box->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return box->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { box->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return box->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { box->SetWorldScaling(worldScale); }
+	~BlockActor() override { delete box; }
 
-	virtual Vec3 getWorldRotation() const override { return box->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { box->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 public:
 	
 	std::string GetClassName() const override { return "BlockActor"; }
@@ -505,54 +492,48 @@ class ObstacleActor	:public Actor
 	Vec3 m_offset;
 public:
 	ObstacleActor(int count = 5, Vec3 offset = Vec3(0.f, 0.f, 5.f));
+	~ObstacleActor() override { delete obstacle; }
 
 	void generateInstanceMatrices(int count, Vec3 offset);
 
-	virtual void draw() override;
-
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return obstacle->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return obstacle->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { obstacle->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return obstacle->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { obstacle->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return obstacle->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { obstacle->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 public:
 	
 	std::string GetClassName() const override { return "ObstacleActor"; }
 	
+	// saved fields, defaults match the constructor's
+	static constexpr auto RecordSchema()
+	{
+		return makeActorSchema(&ObstacleActor::onRecordLoaded,
+			actorProperty("instanceCount", &ObstacleActor::m_instanceCount, 1, 5),
+			actorProperty("offset", &ObstacleActor::m_offset, 1, { 0.f, 0.f, 5.f }));
+	}
 	void Save(std::ofstream& file) const override
 	{
 		SaveBase(file);
-
-		file.write(reinterpret_cast<const char*>(&m_instanceCount), sizeof(int));
-		file.write(reinterpret_cast<const char*>(&m_offset), sizeof(Vec3));
-
+		RecordSchema().write(*this, file);
 	}
 	void Load(std::ifstream& file) override
 	{
 		LoadBase(file);
-		file.read(reinterpret_cast<char*>(&m_instanceCount), sizeof(int));
-		file.read(reinterpret_cast<char*>(&m_offset), sizeof(Vec3));
-
-		generateInstanceMatrices(m_instanceCount, m_offset);
+		RecordSchema().read(*this, file);
 	}
+	uint32_t GetRecordDataSize() const override;
+	void SaveRecordData(unsigned char* data, LevelStringWriter& strings) const override;
+	void LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings) override;
+private:
+	// the instances follow from the loaded fields
+	void onRecordLoaded();
 };
 
 class GeneralMeshActor :public Actor
 {
-	StaticMesh* mesh;
+	StaticMesh* mesh = nullptr;
 	std::string m_path;
 public:
 	GeneralMeshActor(std::string path = "Models/container_005.gem");
+	// collide against the triangles instead of the bounding box, the BVH is shared per asset
+	void setUseMeshCollider(bool useMeshCollider);
+	bool getUseMeshCollider() const { return getCollisionShapeType() == CollisionShapeType::Mesh; }
 	virtual ~GeneralMeshActor()	override
 	{
 		if (mesh) {
@@ -560,69 +541,33 @@ public:
 			mesh = nullptr;
 		}
 	}
-	virtual void draw() override;
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return mesh->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return mesh->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { mesh->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return mesh->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { mesh->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return mesh->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { mesh->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
 public:
 	
 	std::string GetClassName() const override { return "GeneralMeshActor"; }
 	
+	// saved fields, the default path matches the constructor's
+	static constexpr auto RecordSchema()
+	{
+		return makeActorSchema(&GeneralMeshActor::onRecordLoaded,
+			actorProperty("path", &GeneralMeshActor::m_path, 1, "Models/container_005.gem"));
+	}
 	void Save(std::ofstream& file) const override
 	{
-		
 		SaveBase(file);
-
-		// Save the length of m_path
-		int pathLen = static_cast<int>(m_path.size());
-		file.write(reinterpret_cast<const char*>(&pathLen), sizeof(int));
-
-		// Save the character content of m_path
-		if (pathLen > 0) {
-			file.write(m_path.c_str(), pathLen);
-		}
+		RecordSchema().write(*this, file);
 	}
 	void Load(std::ifstream& file) override
 	{
-		
 		LoadBase(file);
-
-		// Read the length of m_path
-		int pathLen;
-		file.read(reinterpret_cast<char*>(&pathLen), sizeof(int));
-
-		// Read the character content of m_path
-		std::string path;
-		if (pathLen > 0) {
-			path.resize(pathLen);
-			file.read(&path[0], pathLen);
-		}
-		Vec3 scale = getWorldScale(); 
-		Vec3 pos = getWorldPos();
-		Vec3 rot = getWorldRotation();
-		
-		initMesh(path);
-
-		// Restore the world position, rotation and scale of the base class loading
-		
-		mesh->SetWorldPos(pos);
-		mesh->SetWorldRotationRadian(rot);
-		mesh->SetWorldScaling(scale);
+		RecordSchema().read(*this, file);
 	}
+	uint32_t GetRecordDataSize() const override;
+	void SaveRecordData(unsigned char* data, LevelStringWriter& strings) const override;
+	void LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings) override;
 private:
 	void initMesh(const std::string& path);
+	// rebuild the mesh from the loaded path, keeping the transform the base record set
+	void onRecordLoaded();
 };
 
 class BulletActor : public Actor
@@ -633,30 +578,22 @@ private:
 	int m_damage;     
 	float m_lifeTime; 
 	const float MAX_LIFE_TIME = 3.0f; 
+	static const int MAX_SWEEP_HITS = 16;
 
-	StaticMesh* m_bulletMesh;
+	// held in place, a bullet costs one allocation and a pooled one none
+	StaticMesh m_bulletMesh;
+	// pool the bullet goes back to when it expires, nullptr to be destroyed instead
+	ActorPool<BulletActor>* m_pool = nullptr;
+
+	// expire: back to the pool, or destroyed when not pooled
+	void despawn();
 protected:
 	virtual void OnTick(float dt) override;
 public:
 	BulletActor(const Vec3 pos, const Vec3 dir, float speed = 100.0f, int damage = 10);
-	~BulletActor() override = default;
 
-	virtual void draw() override;
-	
-	virtual void calculateLocalCollisionShape() override;
-	// **** world info interface ****//
-	
-	virtual Matrix getWorldMatrix() const override { return m_bulletMesh->GetWorldMatrix(); }
-
-	virtual Vec3 getWorldPos() const override { return m_bulletMesh->GetWorldPos(); }
-	virtual void setWorldPos(Vec3 worldPos) override { m_bulletMesh->SetWorldPos(worldPos); }
-
-	virtual Vec3 getWorldScale() const override { return m_bulletMesh->GetWorldScale(); }
-	virtual void setWorldScale(Vec3 worldScale) override { m_bulletMesh->SetWorldScaling(worldScale); }
-
-	virtual Vec3 getWorldRotation() const override { return m_bulletMesh->GetWorldRotationRadian(); }
-	virtual void setWorldRotation(Vec3 worldRotation) override { m_bulletMesh->SetWorldRotationRadian(worldRotation); }
-	// **** world info interface ****//
+	// restart a pooled bullet, no allocation and no GPU work
+	void respawn(const Vec3& pos, const Vec3& dir, float speed, int damage, ActorPool<BulletActor>* pool);
 
 	void Destroy() { m_isDestroyed = true; }
 
@@ -664,22 +601,26 @@ public:
 	
 	std::string GetClassName() const override { return "BulletActor"; }
 	
+	// saved fields, defaults match the constructor's
+	static constexpr auto RecordSchema()
+	{
+		return makeActorSchema<BulletActor>(nullptr,
+			actorProperty("direction", &BulletActor::m_direction, 1, { 0.f, 0.f, 0.f }),
+			actorProperty("speed", &BulletActor::m_speed, 1, 100.0f),
+			actorProperty("damage", &BulletActor::m_damage, 1, 10),
+			actorProperty("lifeTime", &BulletActor::m_lifeTime, 1, 0.0f));
+	}
 	void Save(std::ofstream& file) const override
 	{
 		SaveBase(file);
-
-		file.write(reinterpret_cast<const char*>(&m_direction), sizeof(Vec3));
-		file.write(reinterpret_cast<const char*>(&m_speed), sizeof(float));
-		file.write(reinterpret_cast<const char*>(&m_damage), sizeof(int));
-		file.write(reinterpret_cast<const char*>(&m_lifeTime), sizeof(float));
+		RecordSchema().write(*this, file);
 	}
 	void Load(std::ifstream& file) override
 	{
 		LoadBase(file);
-
-		file.read(reinterpret_cast<char*>(&m_direction), sizeof(Vec3));
-		file.read(reinterpret_cast<char*>(&m_speed), sizeof(float));
-		file.read(reinterpret_cast<char*>(&m_damage), sizeof(int));
-		file.read(reinterpret_cast<char*>(&m_lifeTime), sizeof(float));
+		RecordSchema().read(*this, file);
 	}
+	uint32_t GetRecordDataSize() const override;
+	void SaveRecordData(unsigned char* data, LevelStringWriter& strings) const override;
+	void LoadRecordData(const unsigned char* data, uint32_t size, const LevelStringReader& strings) override;
 };
@@ -0,0 +1,66 @@
+#pragma once
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "SlotMap.h"
+
+class Actor;
+
+// Spawns and destroys recorded during a frame, applied by the level at its sync point.
+// Recording takes a lock, so any thread may fill it while the level is being ticked
+class ActorCommandBuffer
+{
+public:
+	struct Spawn
+	{
+		std::string name;
+		Actor* actor = nullptr;
+	};
+	struct Hit
+	{
+		SlotHandle target;
+		int damage = 0;
+	};
+
+	void spawn(const std::string& name, Actor* actor)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_spawns.push_back({ name, actor });
+	}
+	void destroy(SlotHandle handle)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_destroys.push_back(handle);
+	}
+	// projectile damage to another actor, recorded by actors ticking in parallel
+	void hit(SlotHandle target, int damage)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_hits.push_back({ target, damage });
+	}
+
+	// hand the recorded commands over, the buffer keeps the caller's old capacity
+	void take(std::vector<Spawn>& spawns, std::vector<SlotHandle>& destroys, std::vector<Hit>& hits)
+	{
+		spawns.clear();
+		destroys.clear();
+		hits.clear();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_spawns.swap(spawns);
+		m_destroys.swap(destroys);
+		m_hits.swap(hits);
+	}
+
+	bool empty()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_spawns.empty() && m_destroys.empty() && m_hits.empty();
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<Spawn> m_spawns;
+	std::vector<SlotHandle> m_destroys;
+	std::vector<Hit> m_hits;
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Recycles actors of one class instead of deleting and re-creating them. Released actors
+// stay in their level but inactive (not ticked, drawn or in the broadphase) until they
+// are handed out again. Only a pool miss builds a new actor, which the caller then adds
+// to the level. Safe to use from any thread
+template<typename T>
+class ActorPool
+{
+public:
+	using Factory = std::function<T* ()>;
+
+	explicit ActorPool(Factory factory) : m_factory(std::move(factory)) {}
+
+	// a released actor, or a new one from the factory when the pool is empty
+	T* acquire(bool& created)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_free.empty())
+			{
+				T* actor = m_free.back();
+				m_free.pop_back();
+				created = false;
+				return actor;
+			}
+		}
+
+		created = true;
+		T* actor = m_factory();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_actorCount++;
+		// room for every actor, so release never has to grow the list
+		m_free.reserve(m_actorCount);
+		return actor;
+	}
+
+	// deactivate the actor and keep it for the next acquire
+	void release(T* actor)
+	{
+		actor->setActive(false);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(actor);
+	}
+
+	// forget every actor, for when the level that owns them deletes them
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.clear();
+		m_actorCount = 0;
+	}
+
+	int getActorCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_actorCount;
+	}
+	int getFreeCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return static_cast<int>(m_free.size());
+	}
+
+private:
+	Factory m_factory;
+	std::mutex m_mutex;
+	std::vector<T*> m_free;
+	int m_actorCount = 0;
+};
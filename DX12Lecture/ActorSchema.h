@@ -0,0 +1,288 @@
+#pragma once
+#include "Vec3.h"
+#include "Levels/LevelFormat.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <tuple>
+
+class Actor;
+
+// **** actor property schema ****//
+// An actor class lists the fields it saves once, as a constexpr schema: name, member, the
+// schema version that added the field and the value older records load it with. The record
+// layout, the v2 record code, the v1 stream code and the bulk loader all follow from it.
+// Fields are packed in list order and only ever appended, so a record written before a field
+// existed is shorter and the field takes its default. Fields a newer file has are skipped
+
+enum class PropertyType : uint8_t
+{
+	Int32,
+	Float,
+	Vec3,
+	String		// a LevelStringRef in records, length and characters in v1 streams
+};
+
+// Vec3 is not a literal type, its defaults are kept as this
+struct PropertyVec3
+{
+	float x;
+	float y;
+	float z;
+};
+
+// how each member type is stored
+template<typename M>
+struct PropertyTraits;
+
+template<>
+struct PropertyTraits<int>
+{
+	using Default = int;
+	static constexpr PropertyType type = PropertyType::Int32;
+	static constexpr uint32_t size = sizeof(int32_t);
+
+	static void setDefault(int& value, const Default& def) { value = def; }
+	static void save(const int& value, unsigned char* data, LevelStringWriter&)
+	{
+		int32_t stored = value;
+		memcpy(data, &stored, size);
+	}
+	static void load(int& value, const unsigned char* data, const LevelStringReader&)
+	{
+		int32_t stored;
+		memcpy(&stored, data, size);
+		value = stored;
+	}
+	static void write(const int& value, std::ofstream& file) { file.write(reinterpret_cast<const char*>(&value), sizeof(int)); }
+	static void read(int& value, std::ifstream& file) { file.read(reinterpret_cast<char*>(&value), sizeof(int)); }
+};
+
+template<>
+struct PropertyTraits<float>
+{
+	using Default = float;
+	static constexpr PropertyType type = PropertyType::Float;
+	static constexpr uint32_t size = sizeof(float);
+
+	static void setDefault(float& value, const Default& def) { value = def; }
+	static void save(const float& value, unsigned char* data, LevelStringWriter&) { memcpy(data, &value, size); }
+	static void load(float& value, const unsigned char* data, const LevelStringReader&) { memcpy(&value, data, size); }
+	static void write(const float& value, std::ofstream& file) { file.write(reinterpret_cast<const char*>(&value), sizeof(float)); }
+	static void read(float& value, std::ifstream& file) { file.read(reinterpret_cast<char*>(&value), sizeof(float)); }
+};
+
+template<>
+struct PropertyTraits<Vec3>
+{
+	using Default = PropertyVec3;
+	static constexpr PropertyType type = PropertyType::Vec3;
+	static constexpr uint32_t size = sizeof(float) * 3;
+
+	static void setDefault(Vec3& value, const Default& def) { value = Vec3(def.x, def.y, def.z); }
+	static void save(const Vec3& value, unsigned char* data, LevelStringWriter&) { memcpy(data, value.coords, size); }
+	static void load(Vec3& value, const unsigned char* data, const LevelStringReader&) { memcpy(value.coords, data, size); }
+	static void write(const Vec3& value, std::ofstream& file) { file.write(reinterpret_cast<const char*>(&value), sizeof(Vec3)); }
+	static void read(Vec3& value, std::ifstream& file) { file.read(reinterpret_cast<char*>(&value), sizeof(Vec3)); }
+};
+
+template<>
+struct PropertyTraits<std::string>
+{
+	using Default = const char*;
+	static constexpr PropertyType type = PropertyType::String;
+	static constexpr uint32_t size = sizeof(LevelStringRef);
+
+	static void setDefault(std::string& value, const Default& def) { value = def; }
+	static void save(const std::string& value, unsigned char* data, LevelStringWriter& strings)
+	{
+		LevelStringRef ref = strings.add(value);
+		memcpy(data, &ref, size);
+	}
+	static void load(std::string& value, const unsigned char* data, const LevelStringReader& strings)
+	{
+		LevelStringRef ref;
+		memcpy(&ref, data, size);
+		value = strings.get(ref);
+	}
+	static void write(const std::string& value, std::ofstream& file)
+	{
+		int length = static_cast<int>(value.size());
+		file.write(reinterpret_cast<const char*>(&length), sizeof(int));
+		if (length > 0)
+			file.write(value.c_str(), length);
+	}
+	static void read(std::string& value, std::ifstream& file)
+	{
+		int length = 0;
+		file.read(reinterpret_cast<char*>(&length), sizeof(int));
+		value.assign(std::max(length, 0), '\0');
+		if (length > 0)
+			file.read(&value[0], length);
+	}
+};
+
+template<typename Owner, typename M>
+struct ActorProperty
+{
+	using Member = M;
+	using Traits = PropertyTraits<M>;
+
+	const char* name;
+	M Owner::* member;
+	uint16_t version;
+	typename Traits::Default defaultValue;
+};
+
+// the default's type comes from the member, so a Vec3 takes { x, y, z }
+template<typename Owner, typename M>
+constexpr ActorProperty<Owner, M> actorProperty(const char* name, M Owner::* member, uint16_t version,
+	typename PropertyTraits<M>::Default defaultValue)
+{
+	return { name, member, version, defaultValue };
+}
+
+template<typename Owner, typename... Props>
+class ActorSchema
+{
+public:
+	// runs after a load, for whatever the class builds from its fields
+	using LoadedHook = void (Owner::*)();
+
+	constexpr ActorSchema(LoadedHook loaded, Props... properties)
+		: m_loaded(loaded), m_properties(properties...)
+	{
+	}
+
+	static constexpr size_t getPropertyCount() { return sizeof...(Props); }
+	// bytes of class data in a record
+	static constexpr uint32_t getRecordSize() { return (0u + ... + Props::Traits::size); }
+
+	constexpr uint16_t getVersion() const
+	{
+		uint16_t version = 0;
+		std::apply([&version](const Props&... properties) { ((version = std::max(version, properties.version)), ...); }, m_properties);
+		return version;
+	}
+	// versions never go down along the list, the fields were only appended
+	constexpr bool isAppendOnly() const
+	{
+		bool ordered = true;
+		uint16_t last = 0;
+		std::apply([&](const Props&... properties)
+		{
+			((ordered = ordered && properties.version >= last, last = properties.version), ...);
+		}, m_properties);
+		return ordered;
+	}
+
+	// fn(name, type, offset, size, version) for each field, in record order
+	template<typename Fn>
+	void visit(Fn&& fn) const
+	{
+		forEach([&fn](const auto& property, uint32_t offset)
+		{
+			using Traits = typename std::decay_t<decltype(property)>::Traits;
+			fn(property.name, Traits::type, offset, Traits::size, property.version);
+		});
+	}
+
+	// **** v2 records ****//
+	void save(const Owner& owner, unsigned char* data, LevelStringWriter& strings) const
+	{
+		forEach([&](const auto& property, uint32_t offset)
+		{
+			using Traits = typename std::decay_t<decltype(property)>::Traits;
+			Traits::save(owner.*property.member, data + offset, strings);
+		});
+	}
+	// size is what the file holds, the fields past it take their defaults
+	void load(Owner& owner, const unsigned char* data, uint32_t size, const LevelStringReader& strings) const
+	{
+		loadFields(owner, data, size, strings);
+		if (m_loaded != nullptr)
+			(owner.*m_loaded)();
+	}
+	// The class data of count records, stride bytes apart, into actors of this class. One pass
+	// per field over all the records, instead of a virtual load per record
+	void loadBulk(Actor* const* actors, int count, const unsigned char* data, uint32_t stride, uint32_t size,
+		const LevelStringReader& strings) const
+	{
+		forEach([&](const auto& property, uint32_t offset)
+		{
+			using Traits = typename std::decay_t<decltype(property)>::Traits;
+			bool stored = offset + Traits::size <= size;
+			const unsigned char* field = data + offset;
+			for (int i = 0; i < count; i++, field += stride)
+			{
+				Owner* owner = static_cast<Owner*>(actors[i]);
+				if (stored)
+					Traits::load(owner->*property.member, field, strings);
+				else
+					Traits::setDefault(owner->*property.member, property.defaultValue);
+			}
+		});
+		if (m_loaded == nullptr)
+			return;
+		for (int i = 0; i < count; i++)
+			(static_cast<Owner*>(actors[i])->*m_loaded)();
+	}
+
+	// **** v1 streams ****//
+	// every field in list order, v1 files have no sizes so nothing can be left out
+	void write(const Owner& owner, std::ofstream& file) const
+	{
+		forEach([&](const auto& property, uint32_t)
+		{
+			using Traits = typename std::decay_t<decltype(property)>::Traits;
+			Traits::write(owner.*property.member, file);
+		});
+	}
+	void read(Owner& owner, std::ifstream& file) const
+	{
+		forEach([&](const auto& property, uint32_t)
+		{
+			using Traits = typename std::decay_t<decltype(property)>::Traits;
+			Traits::read(owner.*property.member, file);
+		});
+		if (m_loaded != nullptr)
+			(owner.*m_loaded)();
+	}
+
+private:
+	// fn(property, offset) in list order
+	template<typename Fn>
+	void forEach(Fn&& fn) const
+	{
+		std::apply([&fn](const Props&... properties)
+		{
+			uint32_t offset = 0;
+			((fn(properties, offset), offset += Props::Traits::size), ...);
+		}, m_properties);
+	}
+
+	void loadFields(Owner& owner, const unsigned char* data, uint32_t size, const LevelStringReader& strings) const
+	{
+		forEach([&](const auto& property, uint32_t offset)
+		{
+			using Traits = typename std::decay_t<decltype(property)>::Traits;
+			if (offset + Traits::size <= size)
+				Traits::load(owner.*property.member, data + offset, strings);
+			else
+				Traits::setDefault(owner.*property.member, property.defaultValue);
+		});
+	}
+
+	LoadedHook m_loaded;
+	std::tuple<Props...> m_properties;
+};
+
+// Owner is given when there is no hook to deduce it from
+template<typename Owner, typename... Props>
+constexpr ActorSchema<Owner, Props...> makeActorSchema(void (Owner::*loaded)(), Props... properties)
+{
+	return ActorSchema<Owner, Props...>(loaded, properties...);
+}
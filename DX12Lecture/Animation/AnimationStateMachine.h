@@ -112,8 +112,10 @@ protected:
 			return;
 		}
 		float animTime = m_animInstance->t + dt * state->GetAnimSpeed();
-		if (state->IsLoop()) {
-			float animDuration = m_animatedModel->animation.animations[state->GetAnimName()].duration();
+		// a name the model lacks just runs on, nothing reads a pose from it
+		AnimationSequence* sequence = m_animatedModel->getAnimation().find(state->GetAnimName());
+		if (state->IsLoop() && sequence != nullptr) {
+			float animDuration = sequence->duration();
 			animTime = fmod(animTime, animDuration);
 		}
 		m_animInstance->t = animTime;
@@ -145,7 +147,7 @@ protected:
 		if (m_animInstance == nullptr || m_animatedModel == nullptr) {
 			return;
 		}
-		Animation* anim = &m_animatedModel->animation;
+		Animation* anim = &m_animatedModel->getAnimation();
 		// single animation
 		if (m_targetState == nullptr) {
 			int frame = 0;
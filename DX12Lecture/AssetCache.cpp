@@ -0,0 +1,303 @@
+#include "AssetCache.h"
+#include "Mesh.h"
+#include "JobSystem.h"
+#include "TextureManager.h"
+
+
+std::map<std::string, std::shared_ptr<StaticMeshAsset>> AssetCache::s_staticMeshes;
+std::map<std::string, std::shared_ptr<AnimatedModelAsset>> AssetCache::s_animatedModels;
+std::vector<AssetCache::RetiredAsset<StaticMeshAsset>> AssetCache::s_retiredStaticMeshes;
+std::vector<AssetCache::RetiredAsset<AnimatedModelAsset>> AssetCache::s_retiredAnimatedModels;
+std::map<std::string, std::weak_ptr<GEMFileData>> AssetCache::s_prefetched;
+std::map<std::string, std::weak_ptr<TextureImage>> AssetCache::s_prefetchedTextures;
+std::mutex AssetCache::s_prefetchMutex;
+
+namespace
+{
+	// find the cached asset or build it once with create(asset)
+	template<typename T, typename Create>
+	std::shared_ptr<T> getOrCreate(std::map<std::string, std::shared_ptr<T>>& assets, const std::string& key, Create create)
+	{
+		auto it = assets.find(key);
+		if (it != assets.end())
+			return it->second;
+
+		auto asset = std::make_shared<T>();
+		create(*asset);
+		assets[key] = asset;
+		return asset;
+	}
+
+	template<typename T>
+	int purge(std::map<std::string, std::shared_ptr<T>>& assets)
+	{
+		int released = 0;
+		for (auto it = assets.begin(); it != assets.end(); )
+		{
+			if (it->second.use_count() == 1)
+			{
+				it->second->release();
+				it = assets.erase(it);
+				released++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return released;
+	}
+
+	// move the assets only the cache holds to retired, nothing can pick them up from there
+	template<typename T, typename Retired>
+	int retire(std::map<std::string, std::shared_ptr<T>>& assets, std::vector<Retired>& retired, uint64_t fenceValue)
+	{
+		int count = 0;
+		for (auto it = assets.begin(); it != assets.end(); )
+		{
+			if (it->second.use_count() == 1)
+			{
+				retired.push_back({ std::move(it->second), fenceValue });
+				it = assets.erase(it);
+				count++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return count;
+	}
+
+	// release the retired assets whose fence has passed, every one when all is set
+	template<typename Retired>
+	int releaseDone(std::vector<Retired>& retired, Core* core, bool all)
+	{
+		int released = 0;
+		for (auto it = retired.begin(); it != retired.end(); )
+		{
+			if (all || core->isFrameFenceDone(it->fenceValue))
+			{
+				it->asset->release();
+				it = retired.erase(it);
+				released++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return released;
+	}
+
+	void addUnique(std::vector<std::string>& paths, const std::string& path)
+	{
+		if (!path.empty() && std::find(paths.begin(), paths.end(), path) == paths.end())
+			paths.push_back(path);
+	}
+
+	// on a worker when there are some, right away otherwise: a queued job only runs once someone waits
+	void runPrefetchJob(JobCounter& counter, std::function<void()> job)
+	{
+		JobSystem* jobs = JobSystem::Get();
+		if (jobs != nullptr && jobs->getWorkerCount() > 0)
+			jobs->run(std::move(job), &counter);
+		else
+			job();
+	}
+
+	// decode one texture into the prefetch, unless a job already took it on
+	void prefetchTextureJob(const std::string& path, AssetPrefetch& out, JobCounter& counter)
+	{
+		{
+			std::lock_guard<std::mutex> lock(out.mutex);
+			if (!out.requestedTextures.insert(path).second)
+				return;
+		}
+		runPrefetchJob(counter, [path, &out]()
+		{
+			std::shared_ptr<TextureImage> image = AssetCache::prefetchTexture(path);
+			std::lock_guard<std::mutex> lock(out.mutex);
+			out.textures.push_back(image);
+		});
+	}
+
+}
+
+std::shared_ptr<StaticMeshAsset> AssetCache::getStaticMesh(Core* core, const std::string& path)
+{
+	return getOrCreate(s_staticMeshes, path, [&](StaticMeshAsset& asset) { asset.CreateFromGEM(core, path); });
+}
+
+std::shared_ptr<StaticMeshAsset> AssetCache::getSphere(Core* core, int rings, int segments, float radius, const std::string& texName)
+{
+	// '|' cannot appear in a path, so procedural keys never collide with files
+	std::string key = "sphere|" + std::to_string(rings) + "|" + std::to_string(segments) + "|" +
+		std::to_string(radius) + "|" + texName;
+	return getOrCreate(s_staticMeshes, key, [&](StaticMeshAsset& asset) { asset.CreateFromSphere(core, rings, segments, radius, texName); });
+}
+
+std::shared_ptr<StaticMeshAsset> AssetCache::getPlane(Core* core, float sizeX, float sizeZ, int xSegments, int zSegments,
+	const std::string& texName, const std::string& nhName)
+{
+	std::string key = "plane|" + std::to_string(sizeX) + "|" + std::to_string(sizeZ) + "|" +
+		std::to_string(xSegments) + "|" + std::to_string(zSegments) + "|" + texName + "|" + nhName;
+	return getOrCreate(s_staticMeshes, key, [&](StaticMeshAsset& asset) { asset.CreateFromPlane(core, sizeX, sizeZ, xSegments, zSegments, texName, nhName); });
+}
+
+std::shared_ptr<AnimatedModelAsset> AssetCache::getAnimatedModel(Core* core, const std::string& path)
+{
+	return getOrCreate(s_animatedModels, path, [&](AnimatedModelAsset& asset) { asset.CreateFromGEM(core, path); });
+}
+
+std::shared_ptr<GEMFileData> AssetCache::prefetchGEM(const std::string& path, bool animated)
+{
+	if (std::shared_ptr<GEMFileData> data = findPrefetched(path))
+		return data;
+
+	// parse outside the lock, two threads racing on one path both parse and the last one is kept
+	auto data = std::make_shared<GEMFileData>();
+	GEMLoader::GEMModelLoader loader;
+	if (animated)
+		loader.load(path, data->meshes, data->animation);
+	else
+		loader.load(path, data->meshes);
+
+	std::lock_guard<std::mutex> lock(s_prefetchMutex);
+	s_prefetched[path] = data;
+	return data;
+}
+
+std::shared_ptr<GEMFileData> AssetCache::findPrefetched(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(s_prefetchMutex);
+	auto it = s_prefetched.find(path);
+	if (it == s_prefetched.end())
+		return nullptr;
+	std::shared_ptr<GEMFileData> data = it->second.lock();
+	if (!data)
+		s_prefetched.erase(it);
+	return data;
+}
+
+std::shared_ptr<TextureImage> AssetCache::prefetchTexture(const std::string& path)
+{
+	if (std::shared_ptr<TextureImage> image = findPrefetchedTexture(path))
+		return image;
+
+	std::shared_ptr<TextureImage> image = TextureImage::decode(path);
+	std::lock_guard<std::mutex> lock(s_prefetchMutex);
+	s_prefetchedTextures[path] = image;
+	return image;
+}
+
+std::shared_ptr<TextureImage> AssetCache::findPrefetchedTexture(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(s_prefetchMutex);
+	auto it = s_prefetchedTextures.find(path);
+	if (it == s_prefetchedTextures.end())
+		return nullptr;
+	std::shared_ptr<TextureImage> image = it->second.lock();
+	if (!image)
+		s_prefetchedTextures.erase(it);
+	return image;
+}
+
+void AssetList::add(const AssetList& other)
+{
+	for (const std::string& path : other.staticMeshes)
+		addUnique(staticMeshes, path);
+	for (const std::string& path : other.animatedModels)
+		addUnique(animatedModels, path);
+	for (const std::string& path : other.textures)
+		addUnique(textures, path);
+}
+
+void AssetCache::prefetchAsync(Core* core, const AssetList& assets, AssetPrefetch& out, JobCounter& counter)
+{
+	// without a device textures are never decoded
+	bool withTextures = !core->isHeadless();
+	// the texture map only changes on the main thread, the jobs read this copy of its keys
+	auto residentTextures = std::make_shared<std::set<std::string>>();
+	for (const auto& texture : TextureManager::Get()->textures)
+		residentTextures->insert(texture.first);
+
+	auto prefetchFile = [&out, &counter, residentTextures, withTextures](const std::string& path, bool animated)
+	{
+		runPrefetchJob(counter, [path, animated, &out, &counter, residentTextures, withTextures]()
+		{
+			std::shared_ptr<GEMFileData> data = prefetchGEM(path, animated);
+			{
+				std::lock_guard<std::mutex> lock(out.mutex);
+				out.files.push_back(data);
+			}
+			if (!withTextures)
+				return;
+			// the materials name the textures, each decodes on its own job
+			for (GEMLoader::GEMMesh& mesh : data->meshes)
+			{
+				for (const char* property : { "albedo", "nh" })
+				{
+					std::string texture = mesh.material.find(property).getValue();
+					if (!texture.empty() && residentTextures->count(texture) == 0)
+						prefetchTextureJob(texture, out, counter);
+				}
+			}
+		});
+	};
+
+	for (const std::string& path : assets.staticMeshes)
+	{
+		if (!isLoaded(path))
+			prefetchFile(path, false);
+	}
+	for (const std::string& path : assets.animatedModels)
+	{
+		if (!isLoaded(path))
+			prefetchFile(path, true);
+	}
+	if (!withTextures)
+		return;
+	for (const std::string& path : assets.textures)
+	{
+		if (residentTextures->count(path) == 0)
+			prefetchTextureJob(path, out, counter);
+	}
+}
+
+void AssetCache::prefetch(Core* core, const AssetList& assets, AssetPrefetch& out)
+{
+	JobCounter counter;
+	prefetchAsync(core, assets, out, counter);
+	if (JobSystem* jobs = JobSystem::Get())
+		jobs->wait(counter);
+}
+
+void AssetCache::loadAll(Core* core, const AssetList& assets)
+{
+	for (const std::string& path : assets.staticMeshes)
+		getStaticMesh(core, path);
+	for (const std::string& path : assets.animatedModels)
+		getAnimatedModel(core, path);
+	for (const std::string& path : assets.textures)
+		TextureManager::Get()->loadTexture(core, path);
+}
+
+int AssetCache::purgeUnused(Core* core)
+{
+	core->flushGraphicsQueue();
+	int released = releaseDone(s_retiredStaticMeshes, core, true) + releaseDone(s_retiredAnimatedModels, core, true);
+	return released + purge(s_staticMeshes) + purge(s_animatedModels);
+}
+
+int AssetCache::retireUnused(Core* core)
+{
+	// frames already submitted and the one being recorded may still draw them
+	uint64_t fenceValue = core->currentFrameFenceValue();
+	return retire(s_staticMeshes, s_retiredStaticMeshes, fenceValue) + retire(s_animatedModels, s_retiredAnimatedModels, fenceValue);
+}
+
+int AssetCache::releaseRetired(Core* core)
+{
+	return releaseDone(s_retiredStaticMeshes, core, false) + releaseDone(s_retiredAnimatedModels, core, false);
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "GEMLoader.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+class Core;
+class JobCounter;
+struct StaticMeshAsset;
+struct AnimatedModelAsset;
+struct TextureImage;
+
+// a GEM file read and parsed ahead of time, so building the asset only has to upload it
+struct GEMFileData
+{
+	std::vector<GEMLoader::GEMMesh> meshes;
+	GEMLoader::GEMAnimation animation;
+};
+
+// files something is going to load, by kind
+struct AssetList
+{
+	std::vector<std::string> staticMeshes;
+	std::vector<std::string> animatedModels;
+	std::vector<std::string> textures;
+
+	// append the paths not already listed
+	void add(const AssetList& other);
+	bool empty() const { return staticMeshes.empty() && animatedModels.empty() && textures.empty(); }
+};
+
+// what a prefetch brought in, held until everything built from it exists. Its jobs add to it,
+// so it has to stay put until they are done
+struct AssetPrefetch
+{
+	std::vector<std::shared_ptr<GEMFileData>> files;
+	std::vector<std::shared_ptr<TextureImage>> textures;
+	// textures a job has already taken on
+	std::set<std::string> requestedTextures;
+	std::mutex mutex;
+
+	void clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files.clear();
+		textures.clear();
+		requestedTextures.clear();
+	}
+};
+
+// Meshes and animated models shared by every actor that draws them, keyed by file path
+// or by the parameters of a procedural mesh, so each is parsed and uploaded once.
+// Users hold shared_ptrs, the cache holds one more until purgeUnused or retireUnused drops it
+class AssetCache
+{
+	static std::map<std::string, std::shared_ptr<StaticMeshAsset>> s_staticMeshes;
+	static std::map<std::string, std::shared_ptr<AnimatedModelAsset>> s_animatedModels;
+	// out of the cache, released once the frame fence passes fenceValue
+	template<typename T>
+	struct RetiredAsset
+	{
+		std::shared_ptr<T> asset;
+		uint64_t fenceValue;
+	};
+	static std::vector<RetiredAsset<StaticMeshAsset>> s_retiredStaticMeshes;
+	static std::vector<RetiredAsset<AnimatedModelAsset>> s_retiredAnimatedModels;
+	// parsed files, alive while whoever prefetched them holds on
+	static std::map<std::string, std::weak_ptr<GEMFileData>> s_prefetched;
+	static std::map<std::string, std::weak_ptr<TextureImage>> s_prefetchedTextures;
+	static std::mutex s_prefetchMutex;
+
+public:
+	static std::shared_ptr<StaticMeshAsset> getStaticMesh(Core* core, const std::string& path);
+	static std::shared_ptr<StaticMeshAsset> getSphere(Core* core, int rings, int segments, float radius, const std::string& texName);
+	static std::shared_ptr<StaticMeshAsset> getPlane(Core* core, float sizeX, float sizeZ, int xSegments, int zSegments,
+		const std::string& texName, const std::string& nhName);
+	static std::shared_ptr<AnimatedModelAsset> getAnimatedModel(Core* core, const std::string& path);
+
+	// Parse a GEM file on the calling thread, safe from jobs. While the result is held,
+	// getStaticMesh / getAnimatedModel of the same path build from it instead of the file
+	static std::shared_ptr<GEMFileData> prefetchGEM(const std::string& path, bool animated);
+	// the parsed file if it is still held, nullptr otherwise
+	static std::shared_ptr<GEMFileData> findPrefetched(const std::string& path);
+	// main thread only, like the getters
+	static bool isLoaded(const std::string& path)
+	{
+		return s_staticMeshes.count(path) > 0 || s_animatedModels.count(path) > 0;
+	}
+	// decode an image on the calling thread, safe from jobs. While the result is held,
+	// TextureManager::loadTexture uploads from it instead of decoding again
+	static std::shared_ptr<TextureImage> prefetchTexture(const std::string& path);
+	static std::shared_ptr<TextureImage> findPrefetchedTexture(const std::string& path);
+
+	// Fetch and decode everything in the list on the job system: the GEM files, then the
+	// textures their materials name, then the listed textures. Files already resident are
+	// skipped. The jobs count on counter and fill out. Main thread
+	static void prefetchAsync(Core* core, const AssetList& assets, AssetPrefetch& out, JobCounter& counter);
+	// the same, returning once every file is in
+	static void prefetch(Core* core, const AssetList& assets, AssetPrefetch& out);
+	// build every asset in the list, from the prefetch where there is one. Main thread
+	static void loadAll(Core* core, const AssetList& assets);
+
+	// release assets nobody but the cache references, and every retired one, waits for the
+	// GPU first. For level switches. Returns how many were released
+	static int purgeUnused(Core* core);
+	// Take assets nobody but the cache references out of it without waiting for the GPU, they
+	// are released once the frame being recorded is done. For streaming, where a cell unloads
+	// mid-game. Returns how many were taken out
+	static int retireUnused(Core* core);
+	// release the retired assets the GPU is done with, once per frame. Returns how many
+	static int releaseRetired(Core* core);
+
+	static int getStaticMeshCount() { return static_cast<int>(s_staticMeshes.size()); }
+	static int getAnimatedModelCount() { return static_cast<int>(s_animatedModels.size()); }
+};
@@ -1,6 +1,888 @@
 #include "Collision.h"
 #include "Actor.h"
-Vec3 CollisionResolver::resolveSlidingCollision(Actor* const controlledActor, const Vec3& desiredMove, const std::vector<Actor*>& collidableActors, float epsilon)
+#include "DynamicAABBTree.h"
+#include "ConvexHull.h"
+#include "ContactCache.h"
+
+#include <initializer_list>
+#include <xmmintrin.h>
+
+// **** collision layers ****//
+
+// Static blocks everything that moves, projectiles hit enemies, triggers only see the player
+unsigned int CollisionMatrix::s_masks[MaxCollisionLayers] = {
+	layerBit(CollisionLayer::Player) | layerBit(CollisionLayer::Enemy) | layerBit(CollisionLayer::Projectile),	// Static
+	layerBit(CollisionLayer::Static) | layerBit(CollisionLayer::Trigger),										// Player
+	layerBit(CollisionLayer::Static) | layerBit(CollisionLayer::Projectile),									// Enemy
+	layerBit(CollisionLayer::Static) | layerBit(CollisionLayer::Enemy),											// Projectile
+	layerBit(CollisionLayer::Player)																			// Trigger
+};
+
+namespace
+{
+	// world shapes of the actor doing the query, computed once per query.
+	// Hull pieces point at pose, so the struct is filled in place and not copied
+	struct ControlledShapes
+	{
+		static const int MaxShapes = 8;
+
+		const Actor* actor;
+		CollisionShapeType type;
+		Matrix pose;
+		Sphere sphere;
+		OBB box;	// encloses every shape, for the candidate cull
+		ConvexShape shapes[MaxShapes];
+		int count = 0;
+	};
+
+	// a box around whatever the actor collides with, the shape itself for boxes and meshes
+	OBB boundingOBB(const Actor* actor)
+	{
+		switch (actor->getCollisionShapeType())
+		{
+		case CollisionShapeType::OBB:
+		case CollisionShapeType::Mesh:
+		case CollisionShapeType::Hull:
+			return actor->getWorldOBB();
+		case CollisionShapeType::Sphere:
+		{
+			const Sphere& sphere = actor->getWorldSphere();
+			return OBB::fromAABB(AABB::fromCentreExtents(sphere.centre, Vec3(sphere.radius, sphere.radius, sphere.radius)), Matrix());
+		}
+		default:
+			return OBB::fromAABB(actor->getWorldAABB(), Matrix());
+		}
+	}
+
+	// the actor's shapes moved by offset, without touching its transform
+	void getControlledShapes(const Actor* controlledActor, const Vec3& offset, ControlledShapes& controlled)
+	{
+		controlled.actor = controlledActor;
+		controlled.type = controlledActor->getCollisionShapeType();
+		controlled.pose = controlledActor->getWorldMatrix();
+		controlled.pose.m[3] += offset.x;
+		controlled.pose.m[7] += offset.y;
+		controlled.pose.m[11] += offset.z;
+		controlled.sphere = controlledActor->getWorldSphere();
+		controlled.sphere.centre += offset;
+		controlled.box = boundingOBB(controlledActor);
+		controlled.box.center += offset;
+		controlled.count = 0;
+		controlledActor->forEachConvexShape([&](const ConvexShape& shape)
+		{
+			if (controlled.count == ControlledShapes::MaxShapes)
+				return;
+			ConvexShape& moved = controlled.shapes[controlled.count++];
+			moved = shape;
+			moved.centre += offset;
+			if (moved.type == ConvexShape::Type::Hull)
+				moved.localToWorld = &controlled.pose;
+		});
+	}
+
+	// narrowphase between the controlled shapes and another actor, the deepest contact wins.
+	// normal pushes the controlled actor out of the other one
+	CollisionResult testShapes(const ControlledShapes& controlled, const Actor* actor, Vec3* separatingAxis = nullptr)
+	{
+		// triangle meshes only test spheres exactly, everything else goes through the convex path
+		if (actor->getCollisionShapeType() == CollisionShapeType::Mesh &&
+			controlled.type == CollisionShapeType::Sphere && actor->getMeshCollider())
+		{
+			if (separatingAxis)
+				*separatingAxis = Vec3(0, 0, 0);
+			return actor->getMeshCollider()->overlapSphere(controlled.sphere, actor->getWorldMatrix(), actor->getWorldToLocal());
+		}
+
+		// an axis is only kept when a single pair of pieces was tested
+		int pieces = 0;
+		CollisionResult deepest;
+		actor->forEachConvexShape([&](const ConvexShape& shape)
+		{
+			for (int i = 0; i < controlled.count; i++)
+			{
+				CollisionResult collision = CollisionDetector::checkConvex(controlled.shapes[i], shape, pieces == 0 ? separatingAxis : nullptr);
+				pieces++;
+				if (collision.isColliding && (!deepest.isColliding || collision.penetration > deepest.penetration))
+					deepest = collision;
+			}
+		});
+		if (separatingAxis && (pieces != 1 || deepest.isColliding))
+			*separatingAxis = Vec3(0, 0, 0);
+		return deepest;
+	}
+
+	// Broadphase candidates whose bounding boxes overlap the controlled one's, found with the
+	// batched SAT test four boxes at a time, so the exact shape tests only run on those.
+	// The boxes enclose the shapes, so nothing the exact test would hit is dropped
+	struct CandidateBuffer
+	{
+		std::vector<Actor*> actors;
+		OBBBatch boxes;
+		std::vector<unsigned char> hits;
+	};
+
+	// per thread and kept for its capacity, valid until the thread's next call
+	const std::vector<Actor*>& gatherCandidates(const ControlledShapes& controlled, const AABB& bounds, unsigned int layerMask,
+		const LayeredBroadphase& broadphase)
+	{
+		thread_local CandidateBuffer buffer;
+		buffer.actors.clear();
+		buffer.boxes.clear();
+		broadphase.query(bounds, layerMask, [&](void* userData)
+		{
+			Actor* actor = static_cast<Actor*>(userData);
+			if (actor != controlled.actor)
+			{
+				buffer.actors.push_back(actor);
+				buffer.boxes.add(boundingOBB(actor));
+			}
+			return true;
+		});
+		if (buffer.actors.empty())
+			return buffer.actors;
+
+		buffer.hits.resize(buffer.boxes.paddedSize());
+		CollisionDetector::checkOBBOBBBatch(controlled.box, buffer.boxes, buffer.hits.data());
+		int kept = 0;
+		for (int i = 0; i < buffer.boxes.size(); i++)
+		{
+			if (buffer.hits[i])
+				buffer.actors[kept++] = buffer.actors[i];
+		}
+		buffer.actors.resize(kept);
+		return buffer.actors;
+	}
+
+	// testShapes through the contact cache
+	CollisionResult testShapesCached(const ControlledShapes& controlled, const Actor* actor, ContactCache* cache)
+	{
+		if (cache == nullptr)
+			return testShapes(controlled, actor);
+
+		bool created;
+		ContactCache::Pair& pair = cache->touch(controlled.actor, actor, created);
+		unsigned int version = actor->getTransformVersion();
+		CollisionShapeType type = actor->getCollisionShapeType();
+		if (!created && pair.matches(controlled.pose, version, controlled.type, type))
+			return pair.result;
+
+		// last frame's separating axis usually still separates
+		bool separated = false;
+		if (!created && pair.hasSeparatingAxis && pair.typeA == controlled.type && pair.typeB == type && controlled.count == 1)
+		{
+			separated = true;
+			actor->forEachConvexShape([&](const ConvexShape& shape)
+			{
+				if (separated && CollisionDetector::separationAlongAxis(controlled.shapes[0], shape, pair.separatingAxis) <= 0.0f)
+					separated = false;
+			});
+		}
+
+		pair.poseA = controlled.pose;
+		pair.versionB = version;
+		pair.typeA = controlled.type;
+		pair.typeB = type;
+		if (separated)
+		{
+			pair.result = CollisionResult();
+			return pair.result;
+		}
+
+		Vec3 axis;
+		pair.result = testShapes(controlled, actor, &axis);
+		pair.hasSeparatingAxis = axis.lengthSq() > 0.5f;
+		pair.separatingAxis = axis;
+		return pair.result;
+	}
+}
+
+namespace
+{
+	// 4 lanes of Vec3 for the batched SAT test
+	struct Vec3x4
+	{
+		__m128 x, y, z;
+	};
+
+	inline Vec3x4 splat(const Vec3& v)
+	{
+		return { _mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z) };
+	}
+
+	inline Vec3x4 load(const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z, int i)
+	{
+		return { _mm_loadu_ps(&x[i]), _mm_loadu_ps(&y[i]), _mm_loadu_ps(&z[i]) };
+	}
+
+	inline __m128 dot4(const Vec3x4& a, const Vec3x4& b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+	}
+
+	inline Vec3x4 cross4(const Vec3x4& a, const Vec3x4& b)
+	{
+		return {
+			_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+			_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+			_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x))
+		};
+	}
+
+	inline __m128 abs4(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	// lanes where axis separates the boxes. The test |d.L| > rA + rB is scale invariant,
+	// so the axis does not need normalising, only the degenerate check from checkOBBOBB
+	inline __m128 separatedOnAxis(const Vec3x4& axis, const Vec3x4& d,
+		const Vec3x4 (&axesA)[3], const Vec3& halfA, const Vec3x4 (&axesB)[3], const Vec3x4& halfB)
+	{
+		__m128 radiusA = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_set1_ps(halfA.x), abs4(dot4(axesA[0], axis))),
+			_mm_mul_ps(_mm_set1_ps(halfA.y), abs4(dot4(axesA[1], axis)))),
+			_mm_mul_ps(_mm_set1_ps(halfA.z), abs4(dot4(axesA[2], axis))));
+		__m128 radiusB = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(halfB.x, abs4(dot4(axesB[0], axis))),
+			_mm_mul_ps(halfB.y, abs4(dot4(axesB[1], axis)))),
+			_mm_mul_ps(halfB.z, abs4(dot4(axesB[2], axis))));
+
+		__m128 separated = _mm_cmpgt_ps(abs4(dot4(d, axis)), _mm_add_ps(radiusA, radiusB));
+		__m128 valid = _mm_cmpge_ps(dot4(axis, axis), _mm_set1_ps(1e-6f));
+		return _mm_and_ps(separated, valid);
+	}
+}
+
+int CollisionDetector::checkOBBOBBBatch(const OBB& obb, const OBBBatch& batch, unsigned char* hits)
+{
+	const Vec3x4 centreA = splat(obb.center);
+	const Vec3x4 axesA[3] = { splat(obb.xAxis), splat(obb.yAxis), splat(obb.zAxis) };
+
+	int hitCount = 0;
+	for (int i = 0; i < batch.size(); i += 4)
+	{
+		Vec3x4 centreB = load(batch.centreX, batch.centreY, batch.centreZ, i);
+		Vec3x4 axesB[3] = {
+			load(batch.axisX[0], batch.axisY[0], batch.axisZ[0], i),
+			load(batch.axisX[1], batch.axisY[1], batch.axisZ[1], i),
+			load(batch.axisX[2], batch.axisY[2], batch.axisZ[2], i)
+		};
+		Vec3x4 halfB = load(batch.halfX, batch.halfY, batch.halfZ, i);
+		Vec3x4 d = { _mm_sub_ps(centreB.x, centreA.x), _mm_sub_ps(centreB.y, centreA.y), _mm_sub_ps(centreB.z, centreA.z) };
+
+		// same axis order as checkOBBOBB, stop once every lane is separated
+		__m128 separated = _mm_setzero_ps();
+		for (int k = 0; k < 3 && _mm_movemask_ps(separated) != 0xF; k++)
+			separated = _mm_or_ps(separated, separatedOnAxis(axesA[k], d, axesA, obb.halfExtents, axesB, halfB));
+		for (int k = 0; k < 3 && _mm_movemask_ps(separated) != 0xF; k++)
+			separated = _mm_or_ps(separated, separatedOnAxis(axesB[k], d, axesA, obb.halfExtents, axesB, halfB));
+		for (int a = 0; a < 3 && _mm_movemask_ps(separated) != 0xF; a++)
+		{
+			for (int b = 0; b < 3 && _mm_movemask_ps(separated) != 0xF; b++)
+				separated = _mm_or_ps(separated, separatedOnAxis(cross4(axesA[a], axesB[b]), d, axesA, obb.halfExtents, axesB, halfB));
+		}
+
+		int mask = _mm_movemask_ps(separated);
+		int lanes = std::min(4, batch.size() - i);
+		for (int lane = 0; lane < lanes; lane++)
+		{
+			hits[i + lane] = (mask & (1 << lane)) ? 0 : 1;
+			hitCount += hits[i + lane];
+		}
+	}
+	return hitCount;
+}
+
+// **** GJK / EPA ****//
+
+namespace
+{
+	const int GJKMaxIterations = 32;
+	const int EPAMaxIterations = 64;
+	const int EPAMaxVertices = 64;
+	const int EPAMaxFaces = 128;
+	const float EPATolerance = 1e-4f;
+	const int SweepMaxIterations = 32;
+	const float SweepTolerance = 1e-4f;
+
+	// point of the Minkowski difference a - b and the points it came from
+	struct SupportPoint
+	{
+		Vec3 w;
+		Vec3 a;
+		Vec3 b;
+	};
+
+	SupportPoint supportMinkowski(const ConvexShape& a, const ConvexShape& b, const Vec3& dir)
+	{
+		SupportPoint p;
+		p.a = a.supportCore(dir);
+		p.b = b.supportCore(-dir);
+		p.w = p.a - p.b;
+		return p;
+	}
+
+	struct Simplex
+	{
+		SupportPoint points[4];
+		float weights[4];
+		int count = 0;
+		Vec3 projected;				// closest point when it is inside a triangle
+		bool hasProjected = false;
+
+		void keep(std::initializer_list<int> indices, std::initializer_list<float> newWeights)
+		{
+			hasProjected = false;
+			SupportPoint kept[4];
+			int n = 0;
+			for (int i : indices)
+				kept[n++] = points[i];
+			n = 0;
+			for (float w : newWeights)
+				weights[n++] = w;
+			for (int i = 0; i < n; i++)
+				points[i] = kept[i];
+			count = n;
+		}
+
+		Vec3 closest() const
+		{
+			if (hasProjected)
+				return projected;
+			Vec3 v(0, 0, 0);
+			for (int i = 0; i < count; i++)
+				v += points[i].w * weights[i];
+			return v;
+		}
+	};
+
+	// Closest point of a triangle to the origin (Ericson 5.1.5), drops the vertices it does not need
+	void reduceTriangle(Simplex& s)
+	{
+		const Vec3& a = s.points[0].w;
+		const Vec3& b = s.points[1].w;
+		const Vec3& c = s.points[2].w;
+		Vec3 ab = b - a;
+		Vec3 ac = c - a;
+		float d1 = -Dot(ab, a);
+		float d2 = -Dot(ac, a);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return s.keep({ 0 }, { 1.0f });
+
+		float d3 = -Dot(ab, b);
+		float d4 = -Dot(ac, b);
+		if (d3 >= 0.0f && d4 <= d3)
+			return s.keep({ 1 }, { 1.0f });
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			float v = d1 / (d1 - d3);
+			return s.keep({ 0, 1 }, { 1.0f - v, v });
+		}
+
+		float d5 = -Dot(ab, c);
+		float d6 = -Dot(ac, c);
+		if (d6 >= 0.0f && d5 <= d6)
+			return s.keep({ 2 }, { 1.0f });
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			float w = d2 / (d2 - d6);
+			return s.keep({ 0, 2 }, { 1.0f - w, w });
+		}
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+			return s.keep({ 1, 2 }, { 1.0f - w, w });
+		}
+
+		float sum = va + vb + vc;
+		if (sum <= 1e-20f)
+		{
+			// collinear, the closest point is on the edge from a to the further of b and c
+			int far = (b - a).lengthSq() > (c - a).lengthSq() ? 1 : 2;
+			Vec3 edge = s.points[far].w - a;
+			float lenSq = edge.lengthSq();
+			float t = lenSq > 1e-20f ? std::clamp(-Dot(a, edge) / lenSq, 0.0f, 1.0f) : 0.0f;
+			return s.keep({ 0, far }, { 1.0f - t, t });
+		}
+		float v = vb / sum;
+		float w = vc / sum;
+		s.weights[0] = 1.0f - v - w;
+		s.weights[1] = v;
+		s.weights[2] = w;
+		// project onto the plane directly, the weighted sum loses precision close to the origin
+		Vec3 n = Cross(ab, ac);
+		s.projected = n * (Dot(n, a) / Dot(n, n));
+		s.hasProjected = true;
+	}
+
+	// Closest point of the simplex to the origin. False if the origin is inside the tetrahedron
+	bool reduceSimplex(Simplex& s)
+	{
+		s.hasProjected = false;
+		switch (s.count)
+		{
+		case 1:
+			s.weights[0] = 1.0f;
+			return true;
+		case 2:
+		{
+			Vec3 ab = s.points[1].w - s.points[0].w;
+			float lenSq = ab.lengthSq();
+			float t = lenSq > 1e-20f ? -Dot(s.points[0].w, ab) / lenSq : 0.0f;
+			if (t <= 0.0f)
+				s.keep({ 0 }, { 1.0f });
+			else if (t >= 1.0f)
+				s.keep({ 1 }, { 1.0f });
+			else
+			{
+				s.weights[0] = 1.0f - t;
+				s.weights[1] = t;
+			}
+			return true;
+		}
+		case 3:
+			reduceTriangle(s);
+			return true;
+		default:
+		{
+			// best face the origin lies outside of, nothing outside means inside
+			static const int faces[4][4] = { { 0, 1, 2, 3 }, { 0, 2, 3, 1 }, { 0, 3, 1, 2 }, { 1, 3, 2, 0 } };
+			Simplex best;
+			float bestDistSq = FLT_MAX;
+			for (const auto& face : faces)
+			{
+				const Vec3& a = s.points[face[0]].w;
+				Vec3 n = Cross(s.points[face[1]].w - a, s.points[face[2]].w - a);
+				float origin = -Dot(n, a);
+				float opposite = Dot(n, s.points[face[3]].w - a);
+				// a nearly flat tetrahedron cannot prove the origin is inside, test the face anyway
+				float area = n.length();
+				float flat = 1e-4f * area * sqrtf(area);
+				if (origin * opposite > 0.0f && fabsf(opposite) > flat)
+					continue;
+
+				Simplex sub;
+				sub.count = 3;
+				for (int k = 0; k < 3; k++)
+					sub.points[k] = s.points[face[k]];
+				reduceTriangle(sub);
+				float distSq = sub.closest().lengthSq();
+				if (distSq < bestDistSq)
+				{
+					bestDistSq = distSq;
+					best = sub;
+				}
+			}
+			if (bestDistSq == FLT_MAX)
+				return false;
+			s = best;
+			return true;
+		}
+		}
+	}
+
+	// GJK on the cores. True if they are disjoint, with the closest points on each.
+	// On overlap the simplex is left around the origin for EPA
+	bool gjk(const ConvexShape& a, const ConvexShape& b, Simplex& simplex, Vec3& pointA, Vec3& pointB)
+	{
+		Vec3 dir = b.centre - a.centre;
+		if (dir.lengthSq() < 1e-12f)
+			dir = Vec3(1, 0, 0);
+		simplex.count = 1;
+		simplex.points[0] = supportMinkowski(a, b, dir);
+
+		Simplex lastGood;
+		float lastDistSq = FLT_MAX;
+		for (int iter = 0; iter < GJKMaxIterations; iter++)
+		{
+			if (!reduceSimplex(simplex))
+				return false;
+			Vec3 v = simplex.closest();
+			float vv = v.lengthSq();
+			// below float precision of the simplex points the direction of v is noise, call it touching
+			float scaleSq = 0.0f;
+			for (int i = 0; i < simplex.count; i++)
+				scaleSq = std::max(scaleSq, simplex.points[i].w.lengthSq());
+			if (vv <= std::max(1e-12f, 1e-9f * scaleSq))
+				return false;
+			// a flat simplex can make the distance go up, keep the last one that got closer
+			if (vv >= lastDistSq)
+			{
+				simplex = lastGood;
+				break;
+			}
+			lastGood = simplex;
+			lastDistSq = vv;
+
+			SupportPoint p = supportMinkowski(a, b, -v);
+			// no more progress towards the origin
+			if (vv - Dot(v, p.w) <= 1e-5f * vv)
+				break;
+			bool duplicate = false;
+			for (int i = 0; i < simplex.count; i++)
+				duplicate |= (simplex.points[i].w - p.w).lengthSq() < 1e-12f;
+			if (duplicate)
+			{
+				// stuck on a point it already has while still well short of the support plane,
+				// rounding is hiding the origin right next to the simplex
+				if (vv - Dot(v, p.w) > 1e-4f * sqrtf(vv * scaleSq))
+					return false;
+				break;
+			}
+			simplex.points[simplex.count++] = p;
+		}
+
+		pointA = Vec3(0, 0, 0);
+		pointB = Vec3(0, 0, 0);
+		for (int i = 0; i < simplex.count; i++)
+		{
+			pointA += simplex.points[i].a * simplex.weights[i];
+			pointB += simplex.points[i].b * simplex.weights[i];
+		}
+		return true;
+	}
+
+	struct EPAFace
+	{
+		int v[3];
+		Vec3 normal;
+		float distance;
+	};
+
+	bool makeEPAFace(const SupportPoint* vertices, int a, int b, int c, EPAFace& face)
+	{
+		Vec3 n = Cross(vertices[b].w - vertices[a].w, vertices[c].w - vertices[a].w);
+		if (n.lengthSq() < 1e-20f)
+			return false;
+		face.v[0] = a;
+		face.v[1] = b;
+		face.v[2] = c;
+		face.normal = n.normalize();
+		face.distance = Dot(face.normal, vertices[a].w);
+		return true;
+	}
+
+	// grow the GJK simplex into a tetrahedron around the origin
+	bool blowUpSimplex(const ConvexShape& a, const ConvexShape& b, Simplex& s)
+	{
+		static const Vec3 axes[6] = { Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0), Vec3(0, -1, 0), Vec3(0, 0, 1), Vec3(0, 0, -1) };
+		const float eps = 1e-5f;
+
+		if (s.count == 1)
+		{
+			for (const Vec3& axis : axes)
+			{
+				SupportPoint p = supportMinkowski(a, b, axis);
+				if ((p.w - s.points[0].w).lengthSq() > eps * eps)
+				{
+					s.points[s.count++] = p;
+					break;
+				}
+			}
+		}
+		if (s.count == 2)
+		{
+			Vec3 d = s.points[1].w - s.points[0].w;
+			Vec3 axis = fabsf(d.x) < fabsf(d.y) ? (fabsf(d.x) < fabsf(d.z) ? Vec3(1, 0, 0) : Vec3(0, 0, 1)) : (fabsf(d.y) < fabsf(d.z) ? Vec3(0, 1, 0) : Vec3(0, 0, 1));
+			Vec3 p1 = Cross(d, axis).normalize();
+			Vec3 p2 = Cross(d, p1).normalize();
+			const Vec3 dirs[4] = { p1, -p1, p2, -p2 };
+			Vec3 lineDir = d.normalize();
+			for (const Vec3& dir : dirs)
+			{
+				SupportPoint p = supportMinkowski(a, b, dir);
+				Vec3 rel = p.w - s.points[0].w;
+				if ((rel - lineDir * Dot(rel, lineDir)).lengthSq() > eps * eps)
+				{
+					s.points[s.count++] = p;
+					break;
+				}
+			}
+		}
+		if (s.count == 3)
+		{
+			Vec3 n = Cross(s.points[1].w - s.points[0].w, s.points[2].w - s.points[0].w);
+			if (n.lengthSq() < 1e-20f)
+				return false;
+			n = n.normalize();
+			for (const Vec3& dir : { n, -n })
+			{
+				SupportPoint p = supportMinkowski(a, b, dir);
+				if (fabsf(Dot(n, p.w - s.points[0].w)) > eps)
+				{
+					s.points[s.count++] = p;
+					break;
+				}
+			}
+		}
+		return s.count == 4;
+	}
+
+	// Expanding polytope from the overlapping GJK simplex. normal pushes a out of b
+	bool epa(const ConvexShape& a, const ConvexShape& b, Simplex& simplex, Vec3& normal, float& depth)
+	{
+		if (!blowUpSimplex(a, b, simplex))
+			return false;
+
+		SupportPoint vertices[EPAMaxVertices];
+		EPAFace faces[EPAMaxFaces];
+		int vertexCount = 4;
+		int faceCount = 0;
+		for (int i = 0; i < 4; i++)
+			vertices[i] = simplex.points[i];
+
+		Vec3 centroid = (vertices[0].w + vertices[1].w + vertices[2].w + vertices[3].w) * 0.25f;
+		static const int tetra[4][3] = { { 0, 1, 2 }, { 0, 3, 1 }, { 0, 2, 3 }, { 1, 3, 2 } };
+		for (const auto& t : tetra)
+		{
+			EPAFace face;
+			if (!makeEPAFace(vertices, t[0], t[1], t[2], face))
+				return false;
+			// wind outwards
+			if (Dot(face.normal, centroid - vertices[t[0]].w) > 0.0f)
+				makeEPAFace(vertices, t[0], t[2], t[1], face);
+			faces[faceCount++] = face;
+		}
+
+		int edges[EPAMaxFaces * 3][2];
+		for (int iter = 0; iter < EPAMaxIterations; iter++)
+		{
+			int closest = 0;
+			for (int f = 1; f < faceCount; f++)
+			{
+				if (faces[f].distance < faces[closest].distance)
+					closest = f;
+			}
+			const EPAFace& best = faces[closest];
+			SupportPoint p = supportMinkowski(a, b, best.normal);
+			if (Dot(p.w, best.normal) - best.distance < EPATolerance || vertexCount == EPAMaxVertices)
+			{
+				normal = -best.normal;
+				depth = std::max(best.distance, 0.0f);
+				return true;
+			}
+
+			// remove the faces the new point sees, keeping their silhouette edges
+			int edgeCount = 0;
+			for (int f = 0; f < faceCount;)
+			{
+				if (Dot(faces[f].normal, p.w - vertices[faces[f].v[0]].w) <= 0.0f)
+				{
+					f++;
+					continue;
+				}
+				for (int e = 0; e < 3; e++)
+				{
+					int from = faces[f].v[e];
+					int to = faces[f].v[(e + 1) % 3];
+					bool shared = false;
+					for (int k = 0; k < edgeCount; k++)
+					{
+						if (edges[k][0] == to && edges[k][1] == from)
+						{
+							edges[k][0] = edges[edgeCount - 1][0];
+							edges[k][1] = edges[edgeCount - 1][1];
+							edgeCount--;
+							shared = true;
+							break;
+						}
+					}
+					if (!shared)
+					{
+						edges[edgeCount][0] = from;
+						edges[edgeCount][1] = to;
+						edgeCount++;
+					}
+				}
+				faces[f] = faces[--faceCount];
+			}
+
+			int newVertex = vertexCount++;
+			vertices[newVertex] = p;
+			for (int k = 0; k < edgeCount && faceCount < EPAMaxFaces; k++)
+			{
+				EPAFace face;
+				if (makeEPAFace(vertices, edges[k][0], edges[k][1], newVertex, face))
+					faces[faceCount++] = face;
+			}
+			if (faceCount == 0)
+				return false;
+		}
+
+		int closest = 0;
+		for (int f = 1; f < faceCount; f++)
+		{
+			if (faces[f].distance < faces[closest].distance)
+				closest = f;
+		}
+		normal = -faces[closest].normal;
+		depth = std::max(faces[closest].distance, 0.0f);
+		return true;
+	}
+
+	// closest point of a box to p
+	Vec3 closestPointOnBox(const ConvexShape& box, const Vec3& p)
+	{
+		Vec3 rel = p - box.centre;
+		Vec3 closest = box.centre;
+		for (int k = 0; k < 3; k++)
+		{
+			float proj = std::clamp(Dot(rel, box.axes[k]), -box.halfExtents.coords[k], box.halfExtents.coords[k]);
+			closest += box.axes[k] * proj;
+		}
+		return closest;
+	}
+}
+
+CollisionResult CollisionDetector::checkConvex(const ConvexShape& a, const ConvexShape& b, Vec3* separatingAxis)
+{
+	using Type = ConvexShape::Type;
+	CollisionResult result;
+
+	if (a.type == Type::Sphere && b.type == Type::Sphere)
+	{
+		Vec3 d = a.centre - b.centre;
+		float radii = a.radius + b.radius;
+		float distSq = d.lengthSq();
+		if (distSq >= radii * radii)
+		{
+			if (separatingAxis)
+				*separatingAxis = d / sqrt(distSq);
+			return result;
+		}
+		float dist = sqrt(distSq);
+		result.isColliding = true;
+		result.normal = dist > 1e-6f ? d / dist : Vec3(0, 1, 0);
+		result.penetration = radii - dist;
+		return result;
+	}
+
+	// sphere against box while the centre is outside, deeper cases go to EPA
+	if ((a.type == Type::Sphere && b.type == Type::Box) || (a.type == Type::Box && b.type == Type::Sphere))
+	{
+		const ConvexShape& sphere = a.type == Type::Sphere ? a : b;
+		const ConvexShape& box = a.type == Type::Sphere ? b : a;
+		Vec3 d = sphere.centre - closestPointOnBox(box, sphere.centre);
+		float distSq = d.lengthSq();
+		if (distSq >= sphere.radius * sphere.radius)
+		{
+			if (separatingAxis)
+				*separatingAxis = a.type == Type::Sphere ? d / sqrt(distSq) : -d / sqrt(distSq);
+			return result;
+		}
+		if (distSq > 1e-12f)
+		{
+			float dist = sqrt(distSq);
+			result.isColliding = true;
+			result.normal = a.type == Type::Sphere ? d / dist : -d / dist;
+			result.penetration = sphere.radius - dist;
+			return result;
+		}
+	}
+
+	if (a.type == Type::Box && b.type == Type::Box)
+	{
+		// SAT normal points from a to b
+		result = checkOBBOBB(a.toOBB(), b.toOBB());
+		result.normal = -result.normal;
+		return result;
+	}
+
+	float radii = a.radius + b.radius;
+	Simplex simplex;
+	Vec3 pointA, pointB;
+	if (gjk(a, b, simplex, pointA, pointB))
+	{
+		Vec3 d = pointA - pointB;
+		float dist = d.length();
+		if (dist >= radii)
+		{
+			if (separatingAxis)
+				*separatingAxis = d / dist;
+			return result;
+		}
+		result.isColliding = true;
+		result.normal = d / dist;
+		result.penetration = radii - dist;
+		return result;
+	}
+
+	// cores overlap
+	result.isColliding = true;
+	Vec3 normal;
+	float depth;
+	if (epa(a, b, simplex, normal, depth))
+	{
+		result.normal = normal;
+		result.penetration = depth + radii;
+	}
+	else
+	{
+		Vec3 d = a.centre - b.centre;
+		result.normal = d.lengthSq() > 1e-12f ? d.normalize() : Vec3(0, 1, 0);
+		result.penetration = radii;
+	}
+	return result;
+}
+
+float CollisionDetector::separationAlongAxis(const ConvexShape& a, const ConvexShape& b, const Vec3& axis)
+{
+	float minA = Dot(a.supportCore(-axis), axis) - a.radius;
+	float maxB = Dot(b.supportCore(axis), axis) + b.radius;
+	return minA - maxB;
+}
+
+CollisionResult CollisionDetector::sweepSphereConvex(const Sphere& sphere, const Vec3& motion, const ConvexShape& shape, float& toi)
+{
+	CollisionResult result;
+	float radii = sphere.radius + shape.radius;
+	float t = 0.0f;
+	for (int iter = 0; iter < SweepMaxIterations; iter++)
+	{
+		ConvexShape moving = ConvexShape::fromSphere(Sphere(sphere.centre + motion * t, sphere.radius));
+		Simplex simplex;
+		Vec3 pointA, pointB;
+		if (!gjk(moving, shape, simplex, pointA, pointB))
+		{
+			// centre already inside, only possible at the start
+			toi = t;
+			result.isColliding = true;
+			result.normal = checkConvex(moving, shape).normal;
+			return result;
+		}
+
+		Vec3 d = pointA - pointB;
+		float dist = d.length();
+		Vec3 n = d / dist;
+		float gap = dist - radii;
+		if (gap <= SweepTolerance)
+		{
+			toi = t;
+			result.isColliding = true;
+			result.normal = n;
+			return result;
+		}
+
+		// the gap closes no faster than the motion along the normal
+		float approach = -Dot(motion, n);
+		if (approach <= 1e-9f)
+			return result;
+		t += gap / approach;
+		if (t > 1.0f)
+			return result;
+	}
+
+	// still grazing the surface after the iteration cap, treat it as a miss
+	return result;
+}
+
+Vec3 CollisionResolver::resolveSlidingCollision(Actor* const controlledActor, const Vec3& desiredMove, const LayeredBroadphase& broadphase, float epsilon, ContactCache* contactCache)
 {
 	
 	if (desiredMove.lengthSq() < epsilon * epsilon)
@@ -8,95 +890,54 @@ Vec3 CollisionResolver::resolveSlidingCollision(Actor* const controlledActor, co
 
     Vec3 remainingMove = desiredMove;
     const int maxIterations = 3; // max Iteration count
-    Vec3 currentPos = controlledActor->getWorldPos(); 
+    AABB currentBounds = controlledActor->getBroadphaseAABB();
+    ControlledShapes controlled;
+    // triggers report overlaps but never block
+    unsigned int blockingMask = CollisionMatrix::getMask(controlledActor->getCollisionLayer()) & ~layerBit(CollisionLayer::Trigger);
 
     for (int i = 0; i < maxIterations; i++)
     {
         if (remainingMove.lengthSq() < epsilon * epsilon)
             break;
 
-        // Collect all the results of the collisions
-        std::vector<CollisionResult> allCollisions;
-        CollisionShapeType controlledShape = controlledActor->getCollisionShapeType();
+        // test position as an offset on the cached shapes, the actor itself stays put
+        getControlledShapes(controlledActor, remainingMove, controlled);
+        AABB testBounds;
+        testBounds.min = currentBounds.min + remainingMove;
+        testBounds.max = currentBounds.max + remainingMove;
 
-        
-        Vec3 testPos = currentPos + remainingMove;
-        controlledActor->setWorldPos(testPos); 
-        auto controlledWorldAABB = controlledActor->getWorldAABB();
-        auto controlledWorldSphere = controlledActor->getWorldSphere();
-        auto controlledWorldOBB = controlledActor->getWorldOBB();
+        // Merge the normals of all the collisions, weighted by depth
+        int collisionCount = 0;
+        Vec3 combinedNormal = Vec3(0, 0, 0);
+        Vec3 firstNormal;
 
-        for (auto* actor : collidableActors)
+        // only test actors whose proxies overlap the moved bounds and whose boxes overlap its box
+        for (Actor* actor : gatherCandidates(controlled, testBounds, blockingMask, broadphase))
         {
-            if (!actor->isCollidable() || actor == controlledActor || actor->getActorType()!=ActorType::Static)
-                continue;
+            CollisionResult collision = testShapesCached(controlled, actor, contactCache);
 
-            CollisionResult collision;
-            switch (actor->getCollisionShapeType())
-            {
-            case CollisionShapeType::AABB:
-                if (controlledShape == CollisionShapeType::AABB)
-                    collision = CollisionDetector::checkAABBAABB(controlledWorldAABB, actor->getWorldAABB());
-                else if (controlledShape == CollisionShapeType::Sphere)
-                    collision = CollisionDetector::checkSphereAABB(controlledWorldSphere, actor->getWorldAABB());
-				else if (controlledShape == CollisionShapeType::OBB)
-					
-					collision = CollisionDetector::checkOBBOBB(controlledWorldOBB, OBB::fromAABB(actor->getLocalAABB(), actor->getWorldMatrix()));
-                break;
-            case CollisionShapeType::Sphere:
-                if (controlledShape == CollisionShapeType::AABB)
-                    collision = CollisionDetector::checkSphereAABB(actor->getWorldSphere(), controlledWorldAABB);
-                else if (controlledShape == CollisionShapeType::Sphere)
-                    collision = CollisionDetector::checkSphereSphere(controlledWorldSphere, actor->getWorldSphere());
-				else if (controlledShape == CollisionShapeType::OBB)
-					collision = CollisionDetector::checkOBBSphere(controlledWorldOBB, actor->getWorldSphere());
-                break;
-			case CollisionShapeType::OBB:
-				if (controlledShape == CollisionShapeType::AABB)
-					collision = CollisionDetector::checkOBBOBB(OBB::fromAABB(controlledActor->getLocalAABB(), controlledActor->getWorldMatrix()), actor->getWorldOBB());
-				else if (controlledShape == CollisionShapeType::Sphere)
-					collision = CollisionDetector::checkOBBSphere(actor->getWorldOBB(), controlledWorldSphere);
-				else if (controlledShape == CollisionShapeType::OBB)
-					collision = CollisionDetector::checkOBBOBB(controlledWorldOBB, actor->getWorldOBB());
-				break;
-            default:
-                continue;
-            }
-
-            // Collect effective collisions
+            // normals already point away from the collider
             if (collision.isColliding)
             {
-                Vec3 dirFromCollider = testPos - actor->getWorldPos();
-                if (Dot(collision.normal, dirFromCollider) < 0)
-                {
-                    collision.normal = -collision.normal;
-                }
-                allCollisions.push_back(collision);
+                if (collisionCount++ == 0)
+                    firstNormal = collision.normal;
+                combinedNormal += collision.normal * (collision.penetration + epsilon);
             }
         }
 
         
-        controlledActor->setWorldPos(currentPos);
-
-        
-        if (allCollisions.empty())
+        if (collisionCount == 0)
         {
             return remainingMove; 
         }
 
-        // Merge all the normal vectors of the collisions
-        Vec3 combinedNormal = Vec3(0, 0, 0);
-        for (const auto& col : allCollisions)
-        {
-            combinedNormal += col.normal * (col.penetration + epsilon);
-        }
 		if (combinedNormal.lengthSq() > epsilon * epsilon)
 		{
 			combinedNormal = combinedNormal.normalize();
 		}
 		else
 		{
-			combinedNormal = allCollisions[0].normal;
+			combinedNormal = firstNormal;
 		}
 
         // Decompose the moving vector
@@ -117,54 +958,16 @@ Vec3 CollisionResolver::resolveSlidingCollision(Actor* const controlledActor, co
     return remainingMove;
 }
 
-std::vector<Actor*> CollisionResolver::CheckCollision(Actor* const controlledActor, const std::vector<Actor*>& collidableActors)
+std::vector<Actor*> CollisionResolver::CheckCollision(Actor* const controlledActor, const LayeredBroadphase& broadphase)
 {
     
     std::vector<Actor*> collisions;
+    ControlledShapes controlled;
+    getControlledShapes(controlledActor, Vec3(0, 0, 0), controlled);
 
-    for (auto* actor : collidableActors)
+    for (Actor* actor : gatherCandidates(controlled, controlledActor->getBroadphaseAABB(), CollisionMatrix::getMask(controlledActor->getCollisionLayer()), broadphase))
     {
-        if (!actor->isCollidable() || actor == controlledActor|| (actor->getActorType()!=ActorType::Static&&actor->getActorType()!=ActorType::Enemy))
-            continue;
-
-        CollisionShapeType controlledShape = controlledActor->getCollisionShapeType();
-		auto controlledWorldAABB = controlledActor->getWorldAABB();
-		auto controlledWorldSphere = controlledActor->getWorldSphere();
-        auto controlledWorldOBB = controlledActor->getWorldOBB();
-        // check 
-		CollisionResult collision;
-		switch (actor->getCollisionShapeType())
-		{
-		case CollisionShapeType::AABB:
-			if (controlledShape == CollisionShapeType::AABB)
-				collision = CollisionDetector::checkAABBAABB(controlledWorldAABB, actor->getWorldAABB());
-			else if (controlledShape == CollisionShapeType::Sphere)
-				collision = CollisionDetector::checkSphereAABB(controlledWorldSphere, actor->getWorldAABB());
-			else if (controlledShape == CollisionShapeType::OBB)
-				
-				collision = CollisionDetector::checkOBBOBB(controlledWorldOBB, OBB::fromAABB(actor->getLocalAABB(), actor->getWorldMatrix()));
-            break;
-		case CollisionShapeType::Sphere:
-			if (controlledShape == CollisionShapeType::AABB)
-				collision = CollisionDetector::checkSphereAABB(actor->getWorldSphere(), controlledWorldAABB);
-			else if (controlledShape == CollisionShapeType::Sphere)
-				collision = CollisionDetector::checkSphereSphere(controlledWorldSphere, actor->getWorldSphere());
-			else if (controlledShape == CollisionShapeType::OBB)
-				collision = CollisionDetector::checkOBBSphere(controlledWorldOBB, actor->getWorldSphere());
-            break;
-		case CollisionShapeType::OBB:
-			if (controlledShape == CollisionShapeType::AABB)
-				collision = CollisionDetector::checkOBBOBB(OBB::fromAABB(controlledActor->getLocalAABB(), controlledActor->getWorldMatrix()), actor->getWorldOBB());
-			else if (controlledShape == CollisionShapeType::Sphere)
-				collision = CollisionDetector::checkOBBSphere(actor->getWorldOBB(), controlledWorldSphere);
-			else if (controlledShape == CollisionShapeType::OBB)
-				collision = CollisionDetector::checkOBBOBB(controlledWorldOBB, actor->getWorldOBB());
-			break;
-		default:
-			continue;
-		}
-
-        if (collision.isColliding)
+        if (testShapes(controlled, actor).isColliding)
         {
             collisions.push_back(actor);
         }
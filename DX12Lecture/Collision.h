@@ -2,6 +2,7 @@
 #include "Vec3.h"
 
 #include <vector>
+#include <algorithm>
 #include <cfloat>
 
 
@@ -10,9 +11,13 @@ enum class CollisionShapeType
 	None,       
 	AABB,       
 	Sphere,      
-	OBB         // Directional bounding box (suitable for rotating objects)
+	OBB,        // Directional bounding box (suitable for rotating objects)
+	Mesh,       // Triangle mesh collider, for large static meshes
+	Hull        // Convex hulls built from the submeshes
 };
 
+struct ConvexShape;
+
 // Collision detection result
 struct CollisionResult
 {
@@ -69,6 +74,59 @@ public:
 
 	
 	Vec3 getHalfExtents() const { return (max - min) * 0.5f; }
+
+	// inclusive, so zero-thickness boxes (ground plane) still overlap
+	bool overlaps(const AABB& other) const
+	{
+		return min.x <= other.max.x && max.x >= other.min.x &&
+			min.y <= other.max.y && max.y >= other.min.y &&
+			min.z <= other.max.z && max.z >= other.min.z;
+	}
+
+	bool contains(const AABB& other) const
+	{
+		return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+			max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+	}
+
+	float getSurfaceArea() const
+	{
+		Vec3 size = getSize();
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	static AABB merge(const AABB& a, const AABB& b)
+	{
+		AABB result;
+		result.min = Min(a.min, b.min);
+		result.max = Max(a.max, b.max);
+		return result;
+	}
+
+	static AABB fromCentreExtents(const Vec3& centre, const Vec3& halfExtents)
+	{
+		AABB result;
+		result.min = centre - halfExtents;
+		result.max = centre + halfExtents;
+		return result;
+	}
+
+	// box enclosing this one after an affine transform, uses centre and |M| weighted extents
+	AABB transformed(const Matrix& mat) const
+	{
+		Vec3 c = getCenter();
+		Vec3 e = getHalfExtents();
+		const float* m = mat.m;
+		Vec3 centre(
+			c.x * m[0] + c.y * m[1] + c.z * m[2] + m[3],
+			c.x * m[4] + c.y * m[5] + c.z * m[6] + m[7],
+			c.x * m[8] + c.y * m[9] + c.z * m[10] + m[11]);
+		Vec3 extents(
+			fabsf(m[0]) * e.x + fabsf(m[1]) * e.y + fabsf(m[2]) * e.z,
+			fabsf(m[4]) * e.x + fabsf(m[5]) * e.y + fabsf(m[6]) * e.z,
+			fabsf(m[8]) * e.x + fabsf(m[9]) * e.y + fabsf(m[10]) * e.z);
+		return fromCentreExtents(centre, extents);
+	}
 };
 
 class OBB
@@ -137,20 +195,25 @@ public:
 		}
 		return vertices;
 	}
-};
 
-// Projection
-static void projectPoints(const std::vector<Vec3>& points, const Vec3& axis, float& minProj, float& maxProj)
-{
-	minProj = FLT_MAX;
-	maxProj = -FLT_MAX;
-	for (const auto& p : points)
+	// half length of the box projected onto axis
+	float getProjectedRadius(const Vec3& axis) const
 	{
-		float proj = Dot(p, axis);
-		minProj = std::min(minProj, proj);
-		maxProj = std::max(maxProj, proj);
+		return halfExtents.x * fabsf(Dot(xAxis, axis)) +
+			halfExtents.y * fabsf(Dot(yAxis, axis)) +
+			halfExtents.z * fabsf(Dot(zAxis, axis));
 	}
-}
+
+	// world AABB that encloses the box
+	AABB getEnclosingAABB() const
+	{
+		Vec3 extents(
+			fabsf(xAxis.x) * halfExtents.x + fabsf(yAxis.x) * halfExtents.y + fabsf(zAxis.x) * halfExtents.z,
+			fabsf(xAxis.y) * halfExtents.x + fabsf(yAxis.y) * halfExtents.y + fabsf(zAxis.y) * halfExtents.z,
+			fabsf(xAxis.z) * halfExtents.x + fabsf(yAxis.z) * halfExtents.y + fabsf(zAxis.z) * halfExtents.z);
+		return AABB::fromCentreExtents(center, extents);
+	}
+};
 
 // overlap
 static float getOverlap(float minA, float maxA, float minB, float maxB)
@@ -160,6 +223,63 @@ static float getOverlap(float minA, float maxA, float minB, float maxB)
 	return std::min(maxA, maxB) - std::max(minA, minB);
 }
 
+// Structure of arrays OBB storage for the batched SAT test.
+// Every array is padded to a multiple of 4 so SSE can load whole lanes.
+class OBBBatch
+{
+public:
+	std::vector<float> centreX, centreY, centreZ;
+	std::vector<float> axisX[3], axisY[3], axisZ[3];	// [0] = xAxis, [1] = yAxis, [2] = zAxis
+	std::vector<float> halfX, halfY, halfZ;
+
+	int size() const { return m_count; }
+	int paddedSize() const { return static_cast<int>(centreX.size()); }
+
+	void clear()
+	{
+		m_count = 0;
+		forEachArray([](std::vector<float>& arr) { arr.clear(); });
+	}
+
+	void reserve(int count)
+	{
+		int padded = (count + 3) & ~3;
+		forEachArray([padded](std::vector<float>& arr) { arr.reserve(padded); });
+	}
+
+	void add(const OBB& obb)
+	{
+		// grow a whole SSE lane at a time, the tail lanes stay zero
+		if (m_count == paddedSize())
+			forEachArray([this](std::vector<float>& arr) { arr.resize(m_count + 4, 0.0f); });
+
+		int i = m_count++;
+		centreX[i] = obb.center.x; centreY[i] = obb.center.y; centreZ[i] = obb.center.z;
+		const Vec3* axes[3] = { &obb.xAxis, &obb.yAxis, &obb.zAxis };
+		for (int k = 0; k < 3; k++)
+		{
+			axisX[k][i] = axes[k]->x;
+			axisY[k][i] = axes[k]->y;
+			axisZ[k][i] = axes[k]->z;
+		}
+		halfX[i] = obb.halfExtents.x; halfY[i] = obb.halfExtents.y; halfZ[i] = obb.halfExtents.z;
+	}
+
+private:
+	int m_count = 0;
+
+	template<typename Fn>
+	void forEachArray(Fn fn)
+	{
+		fn(centreX); fn(centreY); fn(centreZ);
+		for (int i = 0; i < 3; i++)
+		{
+			fn(axisX[i]); fn(axisY[i]); fn(axisZ[i]);
+		}
+		fn(halfX); fn(halfY); fn(halfZ);
+	}
+};
+
 class Sphere
 {
 public:
@@ -183,6 +303,11 @@ public:
 			radius = dist;
 		}
 	}
+
+	AABB getEnclosingAABB() const
+	{
+		return AABB::fromCentreExtents(centre, Vec3(radius, radius, radius));
+	}
 };
 
 
@@ -355,7 +480,7 @@ public:
 		return result;
 	}
 
-	// OBB-OBB
+	// OBB-OBB, separating axis test on projected half extents (no vertices, no allocation)
 	static CollisionResult checkOBBOBB(const OBB& obbA, const OBB& obbB)
 	{
 		CollisionResult result;
@@ -363,41 +488,29 @@ public:
 		Vec3 bestAxis; 
 
 		// collect all axis
-		std::vector<Vec3> axes;
-		// 
-		axes.push_back(obbA.xAxis);
-		axes.push_back(obbA.yAxis);
-		axes.push_back(obbA.zAxis);
-		// 
-		axes.push_back(obbB.xAxis);
-		axes.push_back(obbB.yAxis);
-		axes.push_back(obbB.zAxis);
-		// 
-		axes.push_back(Cross(obbA.xAxis, obbB.xAxis));
-		axes.push_back(Cross(obbA.xAxis, obbB.yAxis));
-		axes.push_back(Cross(obbA.xAxis, obbB.zAxis));
-		axes.push_back(Cross(obbA.yAxis, obbB.xAxis));
-		axes.push_back(Cross(obbA.yAxis, obbB.yAxis));
-		axes.push_back(Cross(obbA.yAxis, obbB.zAxis));
-		axes.push_back(Cross(obbA.zAxis, obbB.xAxis));
-		axes.push_back(Cross(obbA.zAxis, obbB.yAxis));
-		axes.push_back(Cross(obbA.zAxis, obbB.zAxis));
-
-		// Traverse all axes
-		for (auto& axis : axes)
+		const Vec3 axes[15] = {
+			obbA.xAxis, obbA.yAxis, obbA.zAxis,
+			obbB.xAxis, obbB.yAxis, obbB.zAxis,
+			Cross(obbA.xAxis, obbB.xAxis), Cross(obbA.xAxis, obbB.yAxis), Cross(obbA.xAxis, obbB.zAxis),
+			Cross(obbA.yAxis, obbB.xAxis), Cross(obbA.yAxis, obbB.yAxis), Cross(obbA.yAxis, obbB.zAxis),
+			Cross(obbA.zAxis, obbB.xAxis), Cross(obbA.zAxis, obbB.yAxis), Cross(obbA.zAxis, obbB.zAxis)
+		};
+
+		// Traverse all axes, stop on the first separating one
+		for (int i = 0; i < 15; i++)
 		{
 			
-			if (axis.lengthSq() < 1e-6f)
+			if (axes[i].lengthSq() < 1e-6f)
 				continue;
-			axis = axis.normalize(); 
+			Vec3 axis = axes[i].normalize(); 
 
-			
-			float minA, maxA, minB, maxB;
-			projectPoints(obbA.getVertices(), axis, minA, maxA);
-			projectPoints(obbB.getVertices(), axis, minB, maxB);
+			// box projects to [centre - radius, centre + radius]
+			float centreA = Dot(obbA.center, axis);
+			float centreB = Dot(obbB.center, axis);
+			float radiusA = obbA.getProjectedRadius(axis);
+			float radiusB = obbB.getProjectedRadius(axis);
 
-			
-			float overlap = getOverlap(minA, maxA, minB, maxB);
+			float overlap = getOverlap(centreA - radiusA, centreA + radiusA, centreB - radiusB, centreB + radiusB);
 			if (overlap < 0)
 				return result; 
 
@@ -421,6 +534,8 @@ public:
 
 		return result;
 	}
+	// OBB against a packed batch, hits[i] is set to 1 if batch box i overlaps. Returns the hit count
+	static int checkOBBOBBBatch(const OBB& obb, const OBBBatch& batch, unsigned char* hits);
 	// OBB-Sphere
 	static CollisionResult checkOBBSphere(const OBB& obb, const Sphere& sphere)
 	{
@@ -461,20 +576,232 @@ public:
 
 		return result;
 	}
+
+	// **** swept sphere, toi is the fraction of motion at first contact ****//
+
+	// Sphere moving by motion against a static AABB. Ray against the box grown by the
+	// radius, then edge/corner regions are refined against capsules (Ericson 5.5.7)
+	static CollisionResult sweepSphereAABB(const Sphere& sphere, const Vec3& motion, const AABB& aabb, float& toi)
+	{
+		CollisionResult result;
+
+		// already touching at the start
+		Vec3 closestStart(
+			std::clamp(sphere.centre.x, aabb.min.x, aabb.max.x),
+			std::clamp(sphere.centre.y, aabb.min.y, aabb.max.y),
+			std::clamp(sphere.centre.z, aabb.min.z, aabb.max.z));
+		Vec3 startOffset = sphere.centre - closestStart;
+		if (startOffset.lengthSq() <= sphere.radius * sphere.radius)
+		{
+			toi = 0.0f;
+			result.isColliding = true;
+			result.normal = startOffset.lengthSq() > 1e-12f ? startOffset.normalize() : Vec3(0, 1, 0);
+			return result;
+		}
+
+		float length = motion.length();
+		if (length < 1e-6f)
+			return result;
+		Vec3 dir = motion / length;
+
+		// ray against the expanded box
+		AABB expanded = AABB::fromCentreExtents(aabb.getCenter(), aabb.getHalfExtents() + Vec3(sphere.radius, sphere.radius, sphere.radius));
+		float tNear = 0.0f;
+		float tFar = length;
+		for (int i = 0; i < 3; i++)
+		{
+			float o = sphere.centre.coords[i];
+			float d = dir.coords[i];
+			float lo = expanded.min.coords[i];
+			float hi = expanded.max.coords[i];
+			if (fabsf(d) < 1e-8f)
+			{
+				if (o < lo || o > hi)
+					return result;
+				continue;
+			}
+			float t1 = (lo - o) / d;
+			float t2 = (hi - o) / d;
+			if (t1 > t2)
+				std::swap(t1, t2);
+			tNear = std::max(tNear, t1);
+			tFar = std::min(tFar, t2);
+			if (tNear > tFar)
+				return result;
+		}
+
+		// which side of the original box the hit point is on
+		Vec3 p = sphere.centre + dir * tNear;
+		int outside = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			if (p.coords[i] < aabb.min.coords[i] || p.coords[i] > aabb.max.coords[i])
+				outside++;
+		}
+
+		float t = tNear;
+		if (outside >= 2)
+		{
+			// edge or corner region, the rounded part is a capsule around each box edge
+			t = FLT_MAX;
+			Vec3 corner(
+				p.x < aabb.getCenter().x ? aabb.min.x : aabb.max.x,
+				p.y < aabb.getCenter().y ? aabb.min.y : aabb.max.y,
+				p.z < aabb.getCenter().z ? aabb.min.z : aabb.max.z);
+			for (int i = 0; i < 3; i++)
+			{
+				Vec3 other = corner;
+				other.coords[i] = corner.coords[i] == aabb.min.coords[i] ? aabb.max.coords[i] : aabb.min.coords[i];
+				float tCapsule;
+				if (rayCapsule(sphere.centre, dir, corner, other, sphere.radius, tCapsule))
+					t = std::min(t, tCapsule);
+			}
+			if (t > length)
+				return result;
+		}
+
+		toi = t / length;
+		result.isColliding = true;
+		Vec3 centre = sphere.centre + dir * t;
+		Vec3 closest(
+			std::clamp(centre.x, aabb.min.x, aabb.max.x),
+			std::clamp(centre.y, aabb.min.y, aabb.max.y),
+			std::clamp(centre.z, aabb.min.z, aabb.max.z));
+		Vec3 n = centre - closest;
+		result.normal = n.lengthSq() > 1e-12f ? n.normalize() : -dir;
+		return result;
+	}
+
+	// Sphere moving by motion against a static OBB, solved in the box frame
+	static CollisionResult sweepSphereOBB(const Sphere& sphere, const Vec3& motion, const OBB& obb, float& toi)
+	{
+		Vec3 rel = sphere.centre - obb.center;
+		Sphere local(Vec3(Dot(rel, obb.xAxis), Dot(rel, obb.yAxis), Dot(rel, obb.zAxis)), sphere.radius);
+		Vec3 localMotion(Dot(motion, obb.xAxis), Dot(motion, obb.yAxis), Dot(motion, obb.zAxis));
+
+		CollisionResult result = sweepSphereAABB(local, localMotion, AABB::fromCentreExtents(Vec3(0, 0, 0), obb.halfExtents), toi);
+		if (result.isColliding)
+			result.normal = (obb.xAxis * result.normal.x + obb.yAxis * result.normal.y + obb.zAxis * result.normal.z).normalize();
+		return result;
+	}
+
+	// Sphere moving by motion against a static sphere
+	static CollisionResult sweepSphereSphere(const Sphere& sphere, const Vec3& motion, const Sphere& target, float& toi)
+	{
+		CollisionResult result;
+
+		Vec3 d = sphere.centre - target.centre;
+		float radiusSum = sphere.radius + target.radius;
+		float c = d.lengthSq() - radiusSum * radiusSum;
+		if (c <= 0.0f)
+		{
+			toi = 0.0f;
+			result.isColliding = true;
+			result.normal = d.lengthSq() > 1e-12f ? d.normalize() : Vec3(0, 1, 0);
+			return result;
+		}
+
+		float a = motion.lengthSq();
+		float b = Dot(d, motion);
+		// not moving or moving away
+		if (a < 1e-12f || b >= 0.0f)
+			return result;
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+			return result;
+
+		float t = (-b - sqrt(discriminant)) / a;
+		if (t > 1.0f)
+			return result;
+
+		toi = t;
+		result.isColliding = true;
+		result.normal = (sphere.centre + motion * t - target.centre).normalize();
+		return result;
+	}
+
+	// **** generic convex narrowphase ****//
+	// Any pair of spheres, boxes and hulls, the normal pushes a out of b.
+	// Sphere and box pairs use the analytic tests, the rest goes through GJK and EPA
+	// When they are apart and separatingAxis is given, it receives a unit axis from b towards a
+	// that separates them (not filled by the box-box SAT path)
+	static CollisionResult checkConvex(const ConvexShape& a, const ConvexShape& b, Vec3* separatingAxis = nullptr);
+	// gap between the shapes along a unit axis pointing from b to a, positive means separated
+	static float separationAlongAxis(const ConvexShape& a, const ConvexShape& b, const Vec3& axis);
+	// conservative advancement on the GJK distance, exact for a translating sphere
+	static CollisionResult sweepSphereConvex(const Sphere& sphere, const Vec3& motion, const ConvexShape& shape, float& toi);
+
+	// Ray (unit dir) against capsule ab with radius r, t is the distance along the ray
+	static bool rayCapsule(const Vec3& origin, const Vec3& dir, const Vec3& a, const Vec3& b, float radius, float& t)
+	{
+		t = FLT_MAX;
+		Vec3 ab = b - a;
+		Vec3 ao = origin - a;
+		float abab = Dot(ab, ab);
+		float abDir = Dot(ab, dir);
+		float abAo = Dot(ab, ao);
+
+		// cylinder part
+		float qa = abab - abDir * abDir;
+		float qb = abab * Dot(ao, dir) - abAo * abDir;
+		float qc = abab * Dot(ao, ao) - abAo * abAo - radius * radius * abab;
+		if (qa > 1e-8f)
+		{
+			float h = qb * qb - qa * qc;
+			if (h >= 0.0f)
+			{
+				float tc = (-qb - sqrt(h)) / qa;
+				float y = abAo + tc * abDir;
+				if (tc >= 0.0f && y > 0.0f && y < abab)
+					t = tc;
+			}
+		}
+
+		// end caps
+		const Vec3* ends[2] = { &a, &b };
+		for (const Vec3* end : ends)
+		{
+			Vec3 oc = origin - *end;
+			float hb = Dot(oc, dir);
+			float hc = oc.lengthSq() - radius * radius;
+			float h = hb * hb - hc;
+			if (h < 0.0f)
+				continue;
+			float ts = -hb - sqrt(h);
+			if (ts >= 0.0f)
+				t = std::min(t, ts);
+		}
+		return t != FLT_MAX;
+	}
 };
 
 class Actor;
+class LayeredBroadphase;
+class ContactCache;
+
+// One contact along a swept path
+struct SweepHit
+{
+	Actor* actor = nullptr;
+	float toi = 0.0f;	// fraction of the motion
+	Vec3 normal = Vec3(0, 1, 0);
+};
+
 // Collision Response Toolkit
+// Candidates come from the broadphase tree, narrowphase only runs on those.
 class CollisionResolver
 {
 public:
 	// Sliding collision response
+	// Test positions are applied as an offset to the cached shapes, the actor is not moved.
+	// With a contact cache, pairs that have not moved reuse last frame's result
 	static Vec3 resolveSlidingCollision(
 		Actor* const controlledActor,
 		const Vec3& desiredMove,
-		const std::vector<Actor*>& collidableActors,
-		float epsilon = 0.001f
+		const LayeredBroadphase& broadphase,
+		float epsilon = 0.001f,
+		ContactCache* contactCache = nullptr
 	);
 	// check collision, return all actors that triggers the collision 
-	static std::vector<Actor*> CheckCollision(Actor* const controlledActor, const std::vector<Actor*>& collidableActors);
+	static std::vector<Actor*> CheckCollision(Actor* const controlledActor, const LayeredBroadphase& broadphase);
 };
\ No newline at end of file
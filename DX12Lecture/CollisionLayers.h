@@ -0,0 +1,41 @@
+#pragma once
+
+// Collision layers, each collidable actor lives in exactly one
+enum class CollisionLayer
+{
+	Static,
+	Player,
+	Enemy,
+	Projectile,
+	Trigger,
+	Count
+};
+
+const int MaxCollisionLayers = 32;
+const unsigned int AllCollisionLayers = 0xFFFFFFFFu;
+
+constexpr unsigned int layerBit(CollisionLayer layer) { return 1u << static_cast<int>(layer); }
+
+// Symmetric 32x32 table of which layers interact, one mask per layer.
+// Queries made on behalf of an actor use its row as their layer mask
+class CollisionMatrix
+{
+	static unsigned int s_masks[MaxCollisionLayers];
+public:
+	static unsigned int getMask(CollisionLayer layer) { return s_masks[static_cast<int>(layer)]; }
+	static bool interacts(CollisionLayer a, CollisionLayer b) { return (getMask(a) & layerBit(b)) != 0; }
+
+	static void setInteraction(CollisionLayer a, CollisionLayer b, bool enable)
+	{
+		if (enable)
+		{
+			s_masks[static_cast<int>(a)] |= layerBit(b);
+			s_masks[static_cast<int>(b)] |= layerBit(a);
+		}
+		else
+		{
+			s_masks[static_cast<int>(a)] &= ~layerBit(b);
+			s_masks[static_cast<int>(b)] &= ~layerBit(a);
+		}
+	}
+};
@@ -0,0 +1,179 @@
+#include "Components.h"
+#include "World.h"
+
+
+// **** collider ****//
+
+void ColliderComponent::refreshWorldShapes()
+{
+	if (transformId == TransformStore::InvalidId)
+		return;
+	TransformStore& transforms = TransformStore::Get();
+	unsigned int version = transforms.getVersion(transformId);
+	if (worldShapeVersion == version && version != 0)
+		return;
+	worldShapeVersion = version;
+
+	worldAABB = AABB();
+	worldOBB = OBB();
+	worldSphere = Sphere();
+
+	const Matrix& worldMat = transforms.getWorldMatrix(transformId);
+	switch (shapeType)
+	{
+	case CollisionShapeType::AABB:
+		// transform centre and extents instead of all 8 corners, the matrix is affine
+		worldAABB = localAABB.transformed(worldMat);
+		break;
+	case CollisionShapeType::Mesh:
+		// bounds for the broadphase and fallback tests, the inverse for local space queries
+		worldAABB = localAABB.transformed(worldMat);
+		worldOBB = OBB::fromAABB(localAABB, worldMat);
+		worldToLocal = Matrix(worldMat).invert();
+		break;
+	case CollisionShapeType::Hull:
+		// hull pieces are transformed on the fly, keep the matrices and a box around them
+		worldAABB = localAABB.transformed(worldMat);
+		worldOBB = OBB::fromAABB(localAABB, worldMat);
+		worldMatrix = worldMat;
+		worldToLocal = Matrix(worldMat).invert();
+		break;
+	case CollisionShapeType::OBB:
+		worldOBB = OBB::fromAABB(localAABB, worldMat);
+		break;
+	case CollisionShapeType::Sphere:
+	{
+		Vec3 worldCentre = Matrix(worldMat).mulPoint(localSphere.centre);
+		Vec3 scale = transforms.getScale(transformId);
+		float worldRadius = localSphere.radius * std::max({ scale.x, scale.y, scale.z });
+		worldSphere = Sphere(worldCentre, worldRadius);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+AABB ColliderComponent::getBroadphaseAABB()
+{
+	refreshWorldShapes();
+	switch (shapeType)
+	{
+	case CollisionShapeType::AABB:
+	case CollisionShapeType::Mesh:
+	case CollisionShapeType::Hull:
+		return worldAABB;
+	case CollisionShapeType::Sphere:
+		return worldSphere.getEnclosingAABB();
+	case CollisionShapeType::OBB:
+		return worldOBB.getEnclosingAABB();
+	default:
+	{
+		Vec3 pos = transformId != TransformStore::InvalidId ? TransformStore::Get().getPosition(transformId) : Vec3(0, 0, 0);
+		return AABB::fromCentreExtents(pos, Vec3(0, 0, 0));
+	}
+	}
+}
+
+void ColliderComponent::fitLocalShape(const std::vector<Vec3>& vertices)
+{
+	for (const Vec3& v : vertices)
+	{
+		localAABB.extend(v);
+		localSphere.extend(v);
+	}
+	localSphere.centre = localAABB.getCenter();
+	worldShapeVersion = 0;
+}
+
+void ColliderComponent::createProxy()
+{
+	if (broadphase != nullptr && collidable && active && proxyId < 0)
+		proxyId = broadphase->createProxy(layer, getBroadphaseAABB(), owner);
+}
+
+void ColliderComponent::destroyProxy()
+{
+	if (broadphase != nullptr && proxyId >= 0)
+		broadphase->destroyProxy(layer, proxyId);
+	proxyId = -1;
+}
+
+void ColliderComponent::refitProxy(bool predictMotion)
+{
+	if (broadphase == nullptr || proxyId < 0)
+		return;
+	AABB aabb = getBroadphaseAABB();
+	// use the movement of the centre as the predicted displacement
+	Vec3 displacement(0.0f, 0.0f, 0.0f);
+	if (predictMotion)
+		displacement = aabb.getCenter() - broadphase->getFatAABB(layer, proxyId).getCenter();
+	broadphase->moveProxy(layer, proxyId, aabb, displacement);
+}
+
+void ColliderSystem::refit(LayeredBroadphase& broadphase)
+{
+	for (ColliderComponent& collider : ComponentArray<ColliderComponent>::Get())
+	{
+		if (collider.broadphase == &broadphase)
+			collider.refitProxy();
+	}
+}
+
+// **** renderable ****//
+
+void RenderSystem::draw(const Level* level)
+{
+	World* myWorld = World::Get();
+	Core* core = myWorld->GetCore();
+	PSOManager* psos = myWorld->GetPSOManager();
+	Pipelines* pipes = myWorld->GetPipelines();
+	s_drawCount = 0;
+	for (RenderableComponent& renderable : ComponentArray<RenderableComponent>::Get())
+	{
+		if (renderable.level != level || !renderable.active || !renderable.visible)
+			continue;
+		s_drawCount++;
+		if (core->isHeadless())
+			continue;
+		switch (renderable.kind)
+		{
+		case RenderKind::Mesh:
+			renderable.staticMesh->draw(core, psos, renderable.pipeline, pipes);
+			break;
+		case RenderKind::MeshSingle:
+			renderable.staticMesh->drawSingle(core, psos, renderable.pipeline, pipes);
+			break;
+		case RenderKind::Instanced:
+			renderable.staticMesh->drawInstances(core, psos, renderable.pipeline, pipes, renderable.instanceMatrices,
+				static_cast<int>(renderable.instanceMatrices->size()));
+			break;
+		case RenderKind::Animated:
+			renderable.animatedModel->drawSingle(core, psos, renderable.pipeline, pipes, renderable.animationInstance,
+				myWorld->GetDeltatime(), renderable.stateMachine);
+			break;
+		}
+	}
+}
+
+// **** animator ****//
+
+void AnimationSystem::update(const Level* level, float dt)
+{
+	SlotMap<AnimatorComponent>& animators = ComponentArray<AnimatorComponent>::Get();
+	auto updateRange = [&animators, level, dt](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			AnimatorComponent& animator = animators[i];
+			if (animator.level == level && animator.active && animator.stateMachine != nullptr)
+				animator.stateMachine->Update(dt);
+		}
+	};
+
+	JobSystem* jobs = JobSystem::Get();
+	if (FramePhases::get(FramePhase::Animation).parallelActors && jobs != nullptr)
+		jobs->parallelFor(0, animators.size(), AnimatorsPerJob, updateRange);
+	else
+		updateRange(0, animators.size());
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include "SlotMap.h"
+#include "Collision.h"
+#include "DynamicAABBTree.h"
+#include "TransformStore.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class Actor;
+class Level;
+class MeshCollider;
+class ConvexHull;
+class StaticMesh;
+class AnimatedModel;
+class AnimationInstance;
+class AnimationStateMachine;
+
+using ComponentHandle = SlotHandle;
+
+// Dense storage for one component type, shared by every actor. Systems loop over it
+// directly instead of calling through Actor*. Components move when others are removed,
+// so keep the handle rather than a pointer. Added and removed on the main thread
+template<typename T>
+class ComponentArray
+{
+public:
+	static SlotMap<T>& Get()
+	{
+		static SlotMap<T> components;
+		return components;
+	}
+};
+
+// **** collider ****//
+struct ColliderComponent
+{
+	Actor* owner = nullptr;
+	uint32_t transformId = TransformStore::InvalidId;
+	CollisionShapeType shapeType = CollisionShapeType::None;
+	CollisionLayer layer = CollisionLayer::Static;
+	bool collidable = false;
+	bool active = true;
+	// broadphase proxy, only valid while collidable, active and attached to a tree
+	LayeredBroadphase* broadphase = nullptr;
+	int proxyId = -1;
+
+	AABB localAABB;
+	Sphere localSphere;
+	// triangle collider for CollisionShapeType::Mesh, shared between actors using the same asset
+	std::shared_ptr<MeshCollider> meshCollider;
+	// convex pieces for CollisionShapeType::Hull, also shared per asset
+	std::shared_ptr<const std::vector<ConvexHull>> convexHulls;
+
+	// cached world shapes, version 0 means never built
+	unsigned int worldShapeVersion = 0;
+	AABB worldAABB;
+	OBB worldOBB;
+	Sphere worldSphere;
+	Matrix worldToLocal;
+	Matrix worldMatrix;
+
+	// rebuild the world shapes if the transform changed since they were built
+	void refreshWorldShapes();
+	// world bounds of whichever shape is in use
+	AABB getBroadphaseAABB();
+	// local bounds around the vertices of a mesh
+	void fitLocalShape(const std::vector<Vec3>& vertices);
+
+	void createProxy();
+	void destroyProxy();
+	// move the proxy after the transform changed. A placement or a shape change is no motion,
+	// predicting it would stretch the fat box across the whole jump
+	void refitProxy(bool predictMotion = true);
+};
+
+// **** renderable ****//
+enum class RenderKind
+{
+	Mesh,			// StaticMesh::draw
+	MeshSingle,		// StaticMesh::drawSingle
+	Instanced,		// StaticMesh::drawInstances over instanceMatrices
+	Animated		// AnimatedModel::drawSingle
+};
+
+struct RenderableComponent
+{
+	Actor* owner = nullptr;
+	const Level* level = nullptr;
+	RenderKind kind = RenderKind::Mesh;
+	std::string pipeline;
+	StaticMesh* staticMesh = nullptr;
+	AnimatedModel* animatedModel = nullptr;
+	std::vector<Matrix>* instanceMatrices = nullptr;
+	AnimationInstance* animationInstance = nullptr;
+	AnimationStateMachine* stateMachine = nullptr;
+	// hidden actors still collide, they are just not drawn
+	bool visible = true;
+	bool active = true;
+
+	static RenderableComponent mesh(StaticMesh* mesh, const std::string& pipeline, RenderKind kind = RenderKind::Mesh)
+	{
+		RenderableComponent renderable;
+		renderable.kind = kind;
+		renderable.staticMesh = mesh;
+		renderable.pipeline = pipeline;
+		return renderable;
+	}
+	static RenderableComponent instanced(StaticMesh* mesh, const std::string& pipeline, std::vector<Matrix>* instanceMatrices)
+	{
+		RenderableComponent renderable = RenderableComponent::mesh(mesh, pipeline, RenderKind::Instanced);
+		renderable.instanceMatrices = instanceMatrices;
+		return renderable;
+	}
+	static RenderableComponent animated(AnimatedModel* model, const std::string& pipeline, AnimationInstance* instance, AnimationStateMachine* stateMachine)
+	{
+		RenderableComponent renderable;
+		renderable.kind = RenderKind::Animated;
+		renderable.animatedModel = model;
+		renderable.pipeline = pipeline;
+		renderable.animationInstance = instance;
+		renderable.stateMachine = stateMachine;
+		return renderable;
+	}
+};
+
+// **** animator ****//
+struct AnimatorComponent
+{
+	Actor* owner = nullptr;
+	const Level* level = nullptr;
+	AnimationStateMachine* stateMachine = nullptr;
+	bool active = true;
+};
+
+// **** systems ****//
+// each one is a loop over a single component array
+
+class ColliderSystem
+{
+public:
+	// refit every proxy in this broadphase
+	static void refit(LayeredBroadphase& broadphase);
+};
+
+class RenderSystem
+{
+public:
+	// with a headless core nothing is submitted, the draws are only counted
+	static void draw(const Level* level);
+	// renderables drawn, or recorded when headless, by the last draw
+	static int getDrawCount() { return s_drawCount; }
+private:
+	inline static int s_drawCount = 0;
+};
+
+class AnimationSystem
+{
+public:
+	// state machines of one level, on the job system when it exists
+	static void update(const Level* level, float dt);
+	static const int AnimatorsPerJob = 16;
+};
@@ -6,6 +6,7 @@ void ConstantBuffer::init(Core* core, unsigned int sizeInBytes, unsigned int _ma
 	unsigned int cbSizeInBytesAligned = cbSizeInBytes * _maxDrawCalls;
 	maxDrawCalls = _maxDrawCalls;
 	offsetIndex = 0;
+#ifdef _WIN32
 	HRESULT hr;
 	D3D12_HEAP_PROPERTIES heapprops = {};
 	heapprops.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -22,6 +23,7 @@ void ConstantBuffer::init(Core* core, unsigned int sizeInBytes, unsigned int _ma
 	cbDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 	core->device->CreateCommittedResource(&heapprops, D3D12_HEAP_FLAG_NONE, &cbDesc, D3D12_RESOURCE_STATE_GENERIC_READ, NULL,
 		IID_PPV_ARGS(&constantBuffer));
+#endif
 	//constantBuffer->Map(0, NULL, (void**)&buffer);
 
 }
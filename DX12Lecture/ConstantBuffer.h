@@ -37,15 +37,21 @@ public:
 
 	void update(std::string name, void* data)
 	{
+#ifdef _WIN32
 		ConstantBufferVariable cbVariable = constantBufferData[name];
 		unsigned int offset = offsetIndex * cbSizeInBytes;
 		constantBuffer->Map(0, NULL, (void**)&buffer);
 		memcpy(&buffer[offset + cbVariable.offset], data, cbVariable.size);
 		constantBuffer->Unmap(0, NULL);
+#endif
 	}
 	D3D12_GPU_VIRTUAL_ADDRESS getGPUAddress() const
 	{
+#ifdef _WIN32
 		return (constantBuffer->GetGPUVirtualAddress() + (offsetIndex * cbSizeInBytes));
+#else
+		return 0;
+#endif
 	}
 
 	void next()
@@ -62,6 +68,7 @@ public:
 	static std::vector<ConstantBuffer> reflect(Core* core, ID3DBlob* shader, std::map<std::string, int>* const textureBindPoints = nullptr)
 	{
 		std::vector<ConstantBuffer> buffers;
+#ifdef _WIN32
 		ID3D12ShaderReflection* reflection;
 		D3DReflect(shader->GetBufferPointer(), shader->GetBufferSize(), IID_PPV_ARGS(&reflection));
 		D3D12_SHADER_DESC desc;
@@ -108,6 +115,7 @@ public:
 				}
 			}
 		}
+#endif
 		
 
 		return buffers;
@@ -115,8 +123,10 @@ public:
 
 	void free()
 	{
+#ifdef _WIN32
 		constantBuffer->Unmap(0, NULL);
 		constantBuffer->Release();
+#endif
 	}
 };
 
@@ -0,0 +1,77 @@
+#pragma once
+#include "Collision.h"
+
+#include <cstring>
+#include <map>
+#include <utility>
+
+class Actor;
+
+// Narrowphase results kept between frames, keyed by (moving actor, other actor).
+// A pair whose poses match the stored ones reuses the result outright, a pair that
+// was apart tries its old separating axis before running the full test.
+class ContactCache
+{
+public:
+	// frames a pair survives without being tested
+	static const unsigned int MaxIdleFrames = 2;
+
+	struct Pair
+	{
+		Matrix poseA;						// test pose of the moving actor, offset included
+		unsigned int versionB = 0;			// transform version of the other actor
+		CollisionShapeType typeA = CollisionShapeType::None;
+		CollisionShapeType typeB = CollisionShapeType::None;
+		CollisionResult result;
+		Vec3 separatingAxis;				// from b towards a, only valid while apart
+		bool hasSeparatingAxis = false;
+		unsigned int lastFrame = 0;
+
+		bool matches(const Matrix& pose, unsigned int version, CollisionShapeType shapeA, CollisionShapeType shapeB) const
+		{
+			return versionB == version && typeA == shapeA && typeB == shapeB &&
+				memcmp(poseA.m, pose.m, sizeof(pose.m)) == 0;
+		}
+	};
+
+	// creates the pair on first use and marks it as alive this frame
+	Pair& touch(const Actor* a, const Actor* b, bool& created)
+	{
+		auto result = m_pairs.emplace(std::make_pair(a, b), Pair());
+		created = result.second;
+		result.first->second.lastFrame = m_frame;
+		return result.first->second;
+	}
+
+	// call once per frame, drops pairs that stopped being tested
+	void nextFrame()
+	{
+		m_frame++;
+		for (auto it = m_pairs.begin(); it != m_pairs.end(); )
+		{
+			if (m_frame - it->second.lastFrame > MaxIdleFrames)
+				it = m_pairs.erase(it);
+			else
+				++it;
+		}
+	}
+
+	// forget every pair with this actor, for actors that are being destroyed
+	void removeActor(const Actor* actor)
+	{
+		for (auto it = m_pairs.begin(); it != m_pairs.end(); )
+		{
+			if (it->first.first == actor || it->first.second == actor)
+				it = m_pairs.erase(it);
+			else
+				++it;
+		}
+	}
+
+	void clear() { m_pairs.clear(); }
+	int getPairCount() const { return static_cast<int>(m_pairs.size()); }
+
+private:
+	std::map<std::pair<const Actor*, const Actor*>, Pair> m_pairs;
+	unsigned int m_frame = 0;
+};
@@ -0,0 +1,352 @@
+#include "ConvexHull.h"
+#include "Mesh.h"
+
+
+std::map<std::string, std::shared_ptr<const std::vector<ConvexHull>>> ConvexHull::s_sharedHulls;
+
+// **** quickhull ****//
+
+namespace
+{
+	struct HullFace
+	{
+		int v[3];
+		Vec3 normal;
+		float d = 0.0f;
+		std::vector<int> outside;	// points above this face
+		int furthest = -1;
+		float furthestDist = 0.0f;
+		bool alive = true;
+	};
+
+	HullFace makeFace(const std::vector<Vec3>& points, int a, int b, int c, const Vec3& fallbackNormal)
+	{
+		HullFace face;
+		face.v[0] = a;
+		face.v[1] = b;
+		face.v[2] = c;
+		Vec3 n = Cross(points[b] - points[a], points[c] - points[a]);
+		face.normal = n.lengthSq() > 1e-20f ? n.normalize() : fallbackNormal;
+		face.d = Dot(face.normal, points[a]);
+		return face;
+	}
+
+	float faceDistance(const HullFace& face, const Vec3& p)
+	{
+		return Dot(face.normal, p) - face.d;
+	}
+
+	// put a point on the first face it is above, points above no face are inside
+	bool assignPoint(std::vector<HullFace>& faces, int firstFace, const std::vector<Vec3>& points, int point, float eps)
+	{
+		for (int f = firstFace; f < static_cast<int>(faces.size()); f++)
+		{
+			HullFace& face = faces[f];
+			if (!face.alive)
+				continue;
+			float dist = faceDistance(face, points[point]);
+			if (dist > eps)
+			{
+				face.outside.push_back(point);
+				if (dist > face.furthestDist)
+				{
+					face.furthestDist = dist;
+					face.furthest = point;
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+
+	ConvexHull::Plane makePlane(const Vec3& normal, float d)
+	{
+		ConvexHull::Plane plane;
+		plane.normal = normal;
+		plane.d = d;
+		return plane;
+	}
+}
+
+ConvexHull ConvexHull::build(const std::vector<Vec3>& points, int maxVertices)
+{
+	ConvexHull hull;
+	if (points.empty())
+		return hull;
+
+	for (const Vec3& p : points)
+		hull.m_bounds.extend(p);
+	Vec3 size = hull.m_bounds.getSize();
+	float eps = std::max(1e-5f * (size.x + size.y + size.z), 1e-7f);
+	maxVertices = std::max(maxVertices, 4);
+
+	// flat or degenerate input becomes its bounding box, thickened by eps
+	auto boxHull = [&]()
+	{
+		AABB box = AABB::fromCentreExtents(hull.m_bounds.getCenter(),
+			Vec3(std::max(size.x * 0.5f, eps), std::max(size.y * 0.5f, eps), std::max(size.z * 0.5f, eps)));
+		hull.m_bounds = box;
+		hull.m_vertices = box.getVertices();
+		hull.m_planes = {
+			makePlane(Vec3(1, 0, 0), box.max.x), makePlane(Vec3(-1, 0, 0), -box.min.x),
+			makePlane(Vec3(0, 1, 0), box.max.y), makePlane(Vec3(0, -1, 0), -box.min.y),
+			makePlane(Vec3(0, 0, 1), box.max.z), makePlane(Vec3(0, 0, -1), -box.min.z)
+		};
+		return hull;
+	};
+
+	// initial tetrahedron: widest pair of axis extremes, then furthest from the line, then from the plane
+	int extremes[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (points[i].coords[k] < points[extremes[k * 2]].coords[k])
+				extremes[k * 2] = i;
+			if (points[i].coords[k] > points[extremes[k * 2 + 1]].coords[k])
+				extremes[k * 2 + 1] = i;
+		}
+	}
+	int i0 = extremes[0], i1 = extremes[1];
+	for (int k = 1; k < 3; k++)
+	{
+		if ((points[extremes[k * 2 + 1]] - points[extremes[k * 2]]).lengthSq() > (points[i1] - points[i0]).lengthSq())
+		{
+			i0 = extremes[k * 2];
+			i1 = extremes[k * 2 + 1];
+		}
+	}
+	Vec3 lineDir = points[i1] - points[i0];
+	if (lineDir.lengthSq() < eps * eps)
+		return boxHull();
+	lineDir = lineDir.normalize();
+
+	int i2 = -1;
+	float bestDist = eps;
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		Vec3 rel = points[i] - points[i0];
+		float dist = (rel - lineDir * Dot(rel, lineDir)).length();
+		if (dist > bestDist)
+		{
+			bestDist = dist;
+			i2 = i;
+		}
+	}
+	if (i2 < 0)
+		return boxHull();
+
+	Vec3 baseNormal = Cross(points[i1] - points[i0], points[i2] - points[i0]).normalize();
+	int i3 = -1;
+	bestDist = eps;
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		float dist = fabsf(Dot(points[i] - points[i0], baseNormal));
+		if (dist > bestDist)
+		{
+			bestDist = dist;
+			i3 = i;
+		}
+	}
+	if (i3 < 0)
+		return boxHull();
+
+	std::vector<HullFace> faces;
+	const int tetra[4][3] = { { i0, i1, i2 }, { i0, i3, i1 }, { i1, i3, i2 }, { i2, i3, i0 } };
+	Vec3 centroid = (points[i0] + points[i1] + points[i2] + points[i3]) * 0.25f;
+	for (int f = 0; f < 4; f++)
+	{
+		HullFace face = makeFace(points, tetra[f][0], tetra[f][1], tetra[f][2], baseNormal);
+		// wind every face outwards
+		if (faceDistance(face, centroid) > 0.0f)
+			face = makeFace(points, tetra[f][0], tetra[f][2], tetra[f][1], -face.normal);
+		faces.push_back(face);
+	}
+	for (int i = 0; i < static_cast<int>(points.size()); i++)
+	{
+		if (i != i0 && i != i1 && i != i2 && i != i3)
+			assignPoint(faces, 0, points, i, eps);
+	}
+
+	// directed edge to the alive face that owns it, the reverse edge gives the neighbour
+	std::map<std::pair<int, int>, int> edgeFaces;
+	auto linkFace = [&](int f)
+	{
+		for (int e = 0; e < 3; e++)
+			edgeFaces[{ faces[f].v[e], faces[f].v[(e + 1) % 3] }] = f;
+	};
+	for (int f = 0; f < 4; f++)
+		linkFace(f);
+
+	int vertexCount = 4;
+	std::vector<int> visible;
+	std::vector<std::pair<int, int>> horizon;
+	std::vector<int> orphans;
+	std::vector<char> visited;
+	while (vertexCount < maxVertices)
+	{
+		// globally furthest point first, so an early stop keeps the biggest features
+		int eyeFace = -1;
+		for (int f = 0; f < static_cast<int>(faces.size()); f++)
+		{
+			if (faces[f].alive && faces[f].furthest >= 0 && (eyeFace < 0 || faces[f].furthestDist > faces[eyeFace].furthestDist))
+				eyeFace = f;
+		}
+		if (eyeFace < 0)
+			break;
+		int eye = faces[eyeFace].furthest;
+		const Vec3& eyePoint = points[eye];
+
+		// flood the faces seen from the eye, edges into unseen faces form the horizon
+		visible.clear();
+		horizon.clear();
+		orphans.clear();
+		visited.assign(faces.size(), 0);
+		visible.push_back(eyeFace);
+		visited[eyeFace] = 1;
+		for (size_t i = 0; i < visible.size(); i++)
+		{
+			const HullFace& face = faces[visible[i]];
+			for (int e = 0; e < 3; e++)
+			{
+				int from = face.v[e];
+				int to = face.v[(e + 1) % 3];
+				auto it = edgeFaces.find({ to, from });
+				if (it == edgeFaces.end())
+					continue;
+				int neighbour = it->second;
+				if (visited[neighbour] == 1)
+					continue;
+				if (visited[neighbour] == 0 && faceDistance(faces[neighbour], eyePoint) > eps)
+				{
+					visited[neighbour] = 1;
+					visible.push_back(neighbour);
+				}
+				else
+				{
+					visited[neighbour] = 2;
+					horizon.push_back({ from, to });
+				}
+			}
+		}
+
+		Vec3 fallbackNormal = faces[eyeFace].normal;
+		for (int f : visible)
+		{
+			HullFace& face = faces[f];
+			face.alive = false;
+			for (int e = 0; e < 3; e++)
+				edgeFaces.erase({ face.v[e], face.v[(e + 1) % 3] });
+			for (int p : face.outside)
+			{
+				if (p != eye)
+					orphans.push_back(p);
+			}
+			face.outside.clear();
+		}
+
+		int faceCount = static_cast<int>(faces.size());
+		for (const auto& edge : horizon)
+		{
+			faces.push_back(makeFace(points, edge.first, edge.second, eye, fallbackNormal));
+			linkFace(static_cast<int>(faces.size()) - 1);
+		}
+		// new faces first, an orphan can also still be above an old face the eye did not see
+		for (int p : orphans)
+		{
+			if (!assignPoint(faces, faceCount, points, p, eps))
+				assignPoint(faces, 0, points, p, eps);
+		}
+		vertexCount++;
+	}
+
+	// keep the vertices used by the final faces, and one plane per distinct face
+	std::vector<int> remap(points.size(), -1);
+	for (const HullFace& face : faces)
+	{
+		if (!face.alive)
+			continue;
+		for (int k = 0; k < 3; k++)
+		{
+			if (remap[face.v[k]] < 0)
+			{
+				remap[face.v[k]] = static_cast<int>(hull.m_vertices.size());
+				hull.m_vertices.push_back(points[face.v[k]]);
+			}
+		}
+
+		bool duplicate = false;
+		for (const Plane& plane : hull.m_planes)
+		{
+			if (Dot(plane.normal, face.normal) > 0.9999f && fabsf(plane.d - face.d) < eps)
+			{
+				duplicate = true;
+				break;
+			}
+		}
+		if (!duplicate)
+			hull.m_planes.push_back(makePlane(face.normal, face.d));
+	}
+
+	hull.m_bounds.reset();
+	for (const Vec3& v : hull.m_vertices)
+		hull.m_bounds.extend(v);
+	return hull;
+}
+
+std::shared_ptr<const std::vector<ConvexHull>> ConvexHull::getShared(const std::string& path, const StaticMesh& mesh, int maxVertices)
+{
+	auto it = s_sharedHulls.find(path);
+	if (it != s_sharedHulls.end())
+		return it->second;
+
+	auto hulls = std::make_shared<std::vector<ConvexHull>>();
+	for (const auto& submesh : mesh.getMeshes())
+		hulls->push_back(build(submesh.getVertices(), maxVertices));
+
+	s_sharedHulls[path] = hulls;
+	return hulls;
+}
+
+// clip the ray against every plane (Ericson 5.3.8)
+bool ConvexHull::raycast(const Vec3& origin, const Vec3& dir, float maxT, float& t, Vec3& normal) const
+{
+	if (m_planes.empty())
+		return false;
+
+	float tFirst = 0.0f;
+	float tLast = maxT;
+	Vec3 firstNormal = -dir;
+	for (const Plane& plane : m_planes)
+	{
+		float denom = Dot(plane.normal, dir);
+		float dist = plane.d - Dot(plane.normal, origin);
+		if (fabsf(denom) < 1e-12f)
+		{
+			// parallel and outside
+			if (dist < 0.0f)
+				return false;
+			continue;
+		}
+
+		float tPlane = dist / denom;
+		if (denom < 0.0f)
+		{
+			if (tPlane > tFirst)
+			{
+				tFirst = tPlane;
+				firstNormal = plane.normal;
+			}
+		}
+		else if (tPlane < tLast)
+		{
+			tLast = tPlane;
+		}
+		if (tFirst > tLast)
+			return false;
+	}
+
+	t = tFirst;
+	normal = firstNormal.normalize();
+	return true;
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include "Collision.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+class StaticMesh;
+
+// Simplified convex hull of a point cloud in local space.
+// Built with quickhull at load, the furthest points are added first so stopping
+// at the vertex cap keeps the most significant ones.
+class ConvexHull
+{
+public:
+	struct Plane
+	{
+		Vec3 normal;	// outward, unit length
+		float d;		// Dot(normal, p) == d on the plane
+	};
+
+	static const int DefaultMaxVertices = 32;
+
+	ConvexHull() = default;
+	static ConvexHull build(const std::vector<Vec3>& points, int maxVertices = DefaultMaxVertices);
+
+	// one hull per GEM submesh, shared between every actor using the asset
+	static std::shared_ptr<const std::vector<ConvexHull>> getShared(const std::string& path, const StaticMesh& mesh, int maxVertices = DefaultMaxVertices);
+
+	const std::vector<Vec3>& getVertices() const { return m_vertices; }
+	const std::vector<Plane>& getPlanes() const { return m_planes; }
+	const AABB& getBounds() const { return m_bounds; }
+
+	// furthest local vertex along a local direction
+	const Vec3& support(const Vec3& dir) const
+	{
+		int best = 0;
+		float bestDot = Dot(m_vertices[0], dir);
+		for (int i = 1; i < static_cast<int>(m_vertices.size()); i++)
+		{
+			float d = Dot(m_vertices[i], dir);
+			if (d > bestDot)
+			{
+				bestDot = d;
+				best = i;
+			}
+		}
+		return m_vertices[best];
+	}
+
+	// local space ray against the planes, dir does not need to be unit length
+	bool raycast(const Vec3& origin, const Vec3& dir, float maxT, float& t, Vec3& normal) const;
+
+private:
+	std::vector<Vec3> m_vertices;
+	std::vector<Plane> m_planes;
+	AABB m_bounds;
+
+	static std::map<std::string, std::shared_ptr<const std::vector<ConvexHull>>> s_sharedHulls;
+};
+
+// One convex piece in world space for the generic narrowphase.
+// Spheres are a core point plus radius, boxes and hulls have no radius.
+struct ConvexShape
+{
+	enum class Type
+	{
+		Sphere,
+		Box,
+		Hull
+	};
+
+	Type type = Type::Sphere;
+	Vec3 centre;
+	float radius = 0.0f;
+	Vec3 axes[3] = { Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1) };
+	Vec3 halfExtents;
+	const ConvexHull* hull = nullptr;
+	const Matrix* localToWorld = nullptr;	// must outlive the shape
+
+	static ConvexShape fromSphere(const Sphere& sphere)
+	{
+		ConvexShape shape;
+		shape.type = Type::Sphere;
+		shape.centre = sphere.centre;
+		shape.radius = sphere.radius;
+		return shape;
+	}
+
+	static ConvexShape fromAABB(const AABB& aabb)
+	{
+		ConvexShape shape;
+		shape.type = Type::Box;
+		shape.centre = aabb.getCenter();
+		shape.halfExtents = aabb.getHalfExtents();
+		return shape;
+	}
+
+	static ConvexShape fromOBB(const OBB& obb)
+	{
+		ConvexShape shape;
+		shape.type = Type::Box;
+		shape.centre = obb.center;
+		shape.axes[0] = obb.xAxis;
+		shape.axes[1] = obb.yAxis;
+		shape.axes[2] = obb.zAxis;
+		shape.halfExtents = obb.halfExtents;
+		return shape;
+	}
+
+	static ConvexShape fromHull(const ConvexHull& hull, const Matrix& localToWorld)
+	{
+		ConvexShape shape;
+		shape.type = Type::Hull;
+		shape.hull = &hull;
+		shape.localToWorld = &localToWorld;
+		const float* m = localToWorld.m;
+		Vec3 c = hull.getBounds().getCenter();
+		shape.centre = Vec3(
+			c.x * m[0] + c.y * m[1] + c.z * m[2] + m[3],
+			c.x * m[4] + c.y * m[5] + c.z * m[6] + m[7],
+			c.x * m[8] + c.y * m[9] + c.z * m[10] + m[11]);
+		return shape;
+	}
+
+	OBB toOBB() const
+	{
+		OBB obb;
+		obb.center = centre;
+		obb.xAxis = axes[0];
+		obb.yAxis = axes[1];
+		obb.zAxis = axes[2];
+		obb.halfExtents = halfExtents;
+		return obb;
+	}
+
+	// furthest point of the core (shape without radius) along dir
+	Vec3 supportCore(const Vec3& dir) const
+	{
+		switch (type)
+		{
+		case Type::Box:
+			return centre
+				+ axes[0] * (Dot(axes[0], dir) >= 0.0f ? halfExtents.x : -halfExtents.x)
+				+ axes[1] * (Dot(axes[1], dir) >= 0.0f ? halfExtents.y : -halfExtents.y)
+				+ axes[2] * (Dot(axes[2], dir) >= 0.0f ? halfExtents.z : -halfExtents.z);
+		case Type::Hull:
+		{
+			// world direction into local space with the transpose, then the vertex back out
+			const float* m = localToWorld->m;
+			Vec3 localDir(
+				dir.x * m[0] + dir.y * m[4] + dir.z * m[8],
+				dir.x * m[1] + dir.y * m[5] + dir.z * m[9],
+				dir.x * m[2] + dir.y * m[6] + dir.z * m[10]);
+			const Vec3& v = hull->support(localDir);
+			return Vec3(
+				v.x * m[0] + v.y * m[1] + v.z * m[2] + m[3],
+				v.x * m[4] + v.y * m[5] + v.z * m[6] + m[7],
+				v.x * m[8] + v.y * m[9] + v.z * m[10] + m[11]);
+		}
+		default:
+			return centre;
+		}
+	}
+};
@@ -1,4 +1,6 @@
 #include "Core.h"
+// the device side of Core, the null device is all inline in Core.h
+#ifdef _WIN32
 
 
 extern "C" {
@@ -7,6 +9,8 @@ extern "C" {
 
 void Core::uploadResource(ID3D12Resource* dstResource, const void* data, unsigned int size, D3D12_RESOURCE_STATES targetState, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* texFootprint)
 {
+	if (headless)
+		return;
 	ID3D12Resource* uploadBuffer;
 	D3D12_HEAP_PROPERTIES heapProps = {};
 	heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
@@ -51,3 +55,4 @@ void Core::uploadResource(ID3D12Resource* dstResource, const void* data, unsigne
 	uploadBuffer->Release();
 
 }
+#endif
@@ -1,9 +1,15 @@
 #pragma once
+#ifdef _WIN32
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <d3dcompiler.h>
+#else
+// no Windows SDK, only the null render device below (initHeadless) builds
+#include "NullD3D12.h"
+#endif
 #include <vector>
 #include "DescriptorHeap.h"
+#ifdef _WIN32
 #define NOMINMAX
 #pragma comment(lib, "d3d12")
 #pragma comment(lib, "dxgi")
@@ -22,12 +28,14 @@ public:
 		commandList->ResourceBarrier(1, &rb);
 	}
 };
+#endif
 
 class GPUFence {
 public:
-	ID3D12Fence* fence;
+	ID3D12Fence* fence = nullptr;
 	HANDLE eventHandle;
 	UINT64 value = 0;
+#ifdef _WIN32
 	void create(ID3D12Device5* device) {
 		device->CreateFence(value, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence));
 		eventHandle = CreateEvent(NULL, FALSE, FALSE, NULL);
@@ -35,16 +43,23 @@ public:
 	void signal(ID3D12CommandQueue* queue) {
 		queue->Signal(fence, ++value);
 	}
+	UINT64 completedValue() {
+		return fence->GetCompletedValue();
+	}
 	void wait() {
 		if (fence->GetCompletedValue() < value) {
 			fence->SetEventOnCompletion(value, eventHandle);
 			WaitForSingleObject(eventHandle, INFINITE);
 		}
 	}
+	// a headless core never creates its fences
 	~GPUFence() {
+		if (fence == nullptr)
+			return;
 		CloseHandle(eventHandle);
 		fence->Release();
 	}
+#endif
 };
 class DescriptorHeap
 {
@@ -55,6 +70,7 @@ public:
 	unsigned int incrementSize;
 	int used;
 
+#ifdef _WIN32
 	void init(ID3D12Device5* device, int num)
 	{
 		D3D12_DESCRIPTOR_HEAP_DESC uavcbvHeapDesc = {};
@@ -67,6 +83,7 @@ public:
 		incrementSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 		used = 0;
 	}
+#endif
 	
 	
 	D3D12_CPU_DESCRIPTOR_HANDLE getNextCPUHandle()
@@ -99,6 +116,8 @@ public:
 	ID3D12Resource** backbuffers;
 
 	GPUFence graphicsQueueFence[2];
+	// signalled by every finishFrame, counts the frames the GPU is done with
+	GPUFence frameFence;
 
 	// init depth buffer
 	ID3D12DescriptorHeap* dsvHeap;
@@ -113,8 +132,41 @@ public:
 	DescriptorHeap srvHeap;
 
 	UINT srvTableRootIndex = 0;
+
+	// null render device: no D3D12 objects at all, uploads and frame calls do nothing.
+	// Meshes keep their CPU data, so gameplay, collision and animation still run
+	bool headless = false;
+	bool isHeadless() const { return headless; }
+	inline void initHeadless(int _width, int _height)
+	{
+		headless = true;
+		adapter = nullptr;
+		device = nullptr;
+		graphicsQueue = nullptr;
+		copyQueue = nullptr;
+		computeQueue = nullptr;
+		swapchain = nullptr;
+		graphicsCommandAllocator[0] = graphicsCommandAllocator[1] = nullptr;
+		graphicsCommandList[0] = graphicsCommandList[1] = nullptr;
+		backbufferHeap = nullptr;
+		backbuffers = nullptr;
+		dsvHeap = nullptr;
+		dsv = nullptr;
+		rootSignature = nullptr;
+		viewport = {};
+		viewport.Width = static_cast<float>(_width);
+		viewport.Height = static_cast<float>(_height);
+		viewport.MaxDepth = 1.0f;
+		scissorRect = {};
+		scissorRect.right = _width;
+		scissorRect.bottom = _height;
+	}
+
+#ifdef _WIN32
 	~Core()
 	{
+		if (headless)
+			return;
 		rootSignature->Release();
 		graphicsCommandList[0]->Release();
 		graphicsCommandAllocator[0]->Release();
@@ -217,6 +269,7 @@ public:
 		// Fence
 		graphicsQueueFence[0].create(device);
 		graphicsQueueFence[1].create(device);
+		frameFence.create(device);
 		
 		// depth buffer
 		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc;
@@ -361,19 +414,26 @@ public:
 	// command list
 	void resetCommandList()
 	{
+		if (headless)
+			return;
 		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
 		graphicsCommandAllocator[frameIndex]->Reset();
 		graphicsCommandList[frameIndex]->Reset(graphicsCommandAllocator[frameIndex], NULL);
 	}
 
+	// nullptr when headless
 	ID3D12GraphicsCommandList4* getCommandList()
 	{
+		if (headless)
+			return nullptr;
 		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
 		return graphicsCommandList[frameIndex];
 	}
 
 	void runCommandList()
 	{
+		if (headless)
+			return;
 		getCommandList()->Close();
 		ID3D12CommandList* lists[] = { getCommandList() };
 		graphicsQueue->ExecuteCommandLists(1, lists);
@@ -381,12 +441,16 @@ public:
 
 	// flush
 	void flushGraphicsQueue() {
+		if (headless)
+			return;
 		graphicsQueueFence[0].signal(graphicsQueue);
 		graphicsQueueFence[0].wait();
 	}
 
 	void beginFrame()
 	{
+		if (headless)
+			return;
 		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
 		graphicsQueueFence[frameIndex].wait();
 		resetCommandList();
@@ -412,16 +476,21 @@ public:
 
 	void finishFrame()
 	{
+		if (headless)
+			return;
 		unsigned int frameIndex = swapchain->GetCurrentBackBufferIndex();
 		Barrier::add(backbuffers[frameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET,
 			D3D12_RESOURCE_STATE_PRESENT, getCommandList());
 		runCommandList();
 		graphicsQueueFence[frameIndex].signal(graphicsQueue);
+		frameFence.signal(graphicsQueue);
 		swapchain->Present(1, 0);
 	}
 
 	void beginRenderPass()
 	{
+		if (headless)
+			return;
 		getCommandList()->RSSetViewports(1, &viewport);
 		getCommandList()->RSSetScissorRects(1, &scissorRect);
 		getCommandList()->SetGraphicsRootSignature(rootSignature);
@@ -433,9 +502,38 @@ public:
 
 	int frameIndex()
 	{
+		if (headless)
+			return 0;
 		return swapchain->GetCurrentBackBufferIndex();
 	}
 
+	// the value frameFence reaches once the GPU is done with the frame being recorded
+	UINT64 currentFrameFenceValue()
+	{
+		return frameFence.value + 1;
+	}
+	bool isFrameFenceDone(UINT64 value)
+	{
+		if (headless)
+			return true;
+		return frameFence.completedValue() >= value;
+	}
+#else
+	// always headless here, every frame call is a no-op
+	void resetCommandList() {}
+	ID3D12GraphicsCommandList4* getCommandList() { return nullptr; }
+	void runCommandList() {}
+	void flushGraphicsQueue() {}
+	void beginFrame() {}
+	void finishFrame() {}
+	void beginRenderPass() {}
+	void uploadResource(ID3D12Resource* dstResource, const void* data, unsigned int size,
+		D3D12_RESOURCE_STATES targetState, D3D12_PLACED_SUBRESOURCE_FOOTPRINT* texFootprint = nullptr) {}
+	int frameIndex() { return 0; }
+	UINT64 currentFrameFenceValue() { return 0; }
+	bool isFrameFenceDone(UINT64 value) { return true; }
+#endif
+
 };
 
 
@@ -0,0 +1,328 @@
+#include "DynamicAABBTree.h"
+
+#include <cassert>
+
+int DynamicAABBTree::allocateNode()
+{
+	// grow the pool and thread the new nodes onto the free list
+	if (m_freeList == NullNode)
+	{
+		int oldCapacity = static_cast<int>(m_nodes.size());
+		int newCapacity = oldCapacity == 0 ? 16 : oldCapacity * 2;
+		m_nodes.resize(newCapacity);
+		for (int i = oldCapacity; i < newCapacity - 1; i++)
+		{
+			m_nodes[i].next = i + 1;
+			m_nodes[i].height = -1;
+		}
+		m_nodes[newCapacity - 1].next = NullNode;
+		m_nodes[newCapacity - 1].height = -1;
+		m_freeList = oldCapacity;
+	}
+
+	int nodeId = m_freeList;
+	TreeNode& node = m_nodes[nodeId];
+	m_freeList = node.next;
+	node.parent = NullNode;
+	node.child1 = NullNode;
+	node.child2 = NullNode;
+	node.height = 0;
+	node.userData = nullptr;
+	m_nodeCount++;
+	return nodeId;
+}
+
+void DynamicAABBTree::freeNode(int nodeId)
+{
+	assert(0 <= nodeId && nodeId < static_cast<int>(m_nodes.size()));
+	m_nodes[nodeId].next = m_freeList;
+	m_nodes[nodeId].height = -1;
+	m_freeList = nodeId;
+	m_nodeCount--;
+}
+
+int DynamicAABBTree::createProxy(const AABB& aabb, void* userData)
+{
+	int proxyId = allocateNode();
+
+	// fatten so small movements stay inside the leaf
+	Vec3 margin(m_fatMargin, m_fatMargin, m_fatMargin);
+	m_nodes[proxyId].aabb.min = aabb.min - margin;
+	m_nodes[proxyId].aabb.max = aabb.max + margin;
+	m_nodes[proxyId].userData = userData;
+	m_nodes[proxyId].height = 0;
+
+	insertLeaf(proxyId);
+	m_proxyCount++;
+	return proxyId;
+}
+
+void DynamicAABBTree::destroyProxy(int proxyId)
+{
+	assert(0 <= proxyId && proxyId < static_cast<int>(m_nodes.size()));
+	assert(m_nodes[proxyId].isLeaf());
+
+	removeLeaf(proxyId);
+	freeNode(proxyId);
+	m_proxyCount--;
+}
+
+bool DynamicAABBTree::moveProxy(int proxyId, const AABB& aabb, const Vec3& displacement)
+{
+	assert(0 <= proxyId && proxyId < static_cast<int>(m_nodes.size()));
+	assert(m_nodes[proxyId].isLeaf());
+
+	// still inside the fat box, nothing to do
+	if (m_nodes[proxyId].aabb.contains(aabb))
+		return false;
+
+	removeLeaf(proxyId);
+
+	Vec3 margin(m_fatMargin, m_fatMargin, m_fatMargin);
+	AABB fat;
+	fat.min = aabb.min - margin;
+	fat.max = aabb.max + margin;
+
+	// predict the motion so fast movers are not re-inserted every frame
+	Vec3 d = displacement * m_displacementMultiplier;
+	if (d.x < 0.0f) fat.min.x += d.x; else fat.max.x += d.x;
+	if (d.y < 0.0f) fat.min.y += d.y; else fat.max.y += d.y;
+	if (d.z < 0.0f) fat.min.z += d.z; else fat.max.z += d.z;
+
+	m_nodes[proxyId].aabb = fat;
+	insertLeaf(proxyId);
+	return true;
+}
+
+void DynamicAABBTree::insertLeaf(int leaf)
+{
+	if (m_root == NullNode)
+	{
+		m_root = leaf;
+		m_nodes[m_root].parent = NullNode;
+		return;
+	}
+
+	// find the best sibling using the surface area heuristic
+	AABB leafAABB = m_nodes[leaf].aabb;
+	int index = m_root;
+	while (!m_nodes[index].isLeaf())
+	{
+		int child1 = m_nodes[index].child1;
+		int child2 = m_nodes[index].child2;
+
+		float area = m_nodes[index].aabb.getSurfaceArea();
+		float combinedArea = AABB::merge(m_nodes[index].aabb, leafAABB).getSurfaceArea();
+
+		// cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](int child)
+		{
+			AABB merged = AABB::merge(leafAABB, m_nodes[child].aabb);
+			if (m_nodes[child].isLeaf())
+				return merged.getSurfaceArea() + inheritanceCost;
+			return merged.getSurfaceArea() - m_nodes[child].aabb.getSurfaceArea() + inheritanceCost;
+		};
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+
+	// new parent for sibling and leaf
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = allocateNode();
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].userData = nullptr;
+	m_nodes[newParent].aabb = AABB::merge(leafAABB, m_nodes[sibling].aabb);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+
+	if (oldParent != NullNode)
+	{
+		if (m_nodes[oldParent].child1 == sibling)
+			m_nodes[oldParent].child1 = newParent;
+		else
+			m_nodes[oldParent].child2 = newParent;
+	}
+	else
+	{
+		m_root = newParent;
+	}
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	refitAncestors(m_nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = NullNode;
+		return;
+	}
+
+	int parent = m_nodes[leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent != NullNode)
+	{
+		// hook the sibling onto the grandparent and drop the parent
+		if (m_nodes[grandParent].child1 == parent)
+			m_nodes[grandParent].child1 = sibling;
+		else
+			m_nodes[grandParent].child2 = sibling;
+		m_nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		refitAncestors(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = NullNode;
+		freeNode(parent);
+	}
+}
+
+void DynamicAABBTree::refitAncestors(int nodeId)
+{
+	// walk back up fixing heights and bounds
+	int index = nodeId;
+	while (index != NullNode)
+	{
+		index = balance(index);
+
+		int child1 = m_nodes[index].child1;
+		int child2 = m_nodes[index].child2;
+		m_nodes[index].height = 1 + std::max(m_nodes[child1].height, m_nodes[child2].height);
+		m_nodes[index].aabb = AABB::merge(m_nodes[child1].aabb, m_nodes[child2].aabb);
+
+		index = m_nodes[index].parent;
+	}
+}
+
+// Rotate the subtree at iA if it is out of balance, returns the new subtree root
+int DynamicAABBTree::balance(int iA)
+{
+	TreeNode* A = &m_nodes[iA];
+	if (A->isLeaf() || A->height < 2)
+		return iA;
+
+	int iB = A->child1;
+	int iC = A->child2;
+	TreeNode* B = &m_nodes[iB];
+	TreeNode* C = &m_nodes[iC];
+
+	int heightDiff = C->height - B->height;
+
+	// rotate C up
+	if (heightDiff > 1)
+	{
+		int iF = C->child1;
+		int iG = C->child2;
+		TreeNode* F = &m_nodes[iF];
+		TreeNode* G = &m_nodes[iG];
+
+		// swap A and C
+		C->child1 = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+
+		if (C->parent != NullNode)
+		{
+			if (m_nodes[C->parent].child1 == iA)
+				m_nodes[C->parent].child1 = iC;
+			else
+				m_nodes[C->parent].child2 = iC;
+		}
+		else
+		{
+			m_root = iC;
+		}
+
+		// keep the taller grandchild under C
+		if (F->height > G->height)
+		{
+			C->child2 = iF;
+			A->child2 = iG;
+			G->parent = iA;
+			A->aabb = AABB::merge(B->aabb, G->aabb);
+			C->aabb = AABB::merge(A->aabb, F->aabb);
+			A->height = 1 + std::max(B->height, G->height);
+			C->height = 1 + std::max(A->height, F->height);
+		}
+		else
+		{
+			C->child2 = iG;
+			A->child2 = iF;
+			F->parent = iA;
+			A->aabb = AABB::merge(B->aabb, F->aabb);
+			C->aabb = AABB::merge(A->aabb, G->aabb);
+			A->height = 1 + std::max(B->height, F->height);
+			C->height = 1 + std::max(A->height, G->height);
+		}
+		return iC;
+	}
+
+	// rotate B up
+	if (heightDiff < -1)
+	{
+		int iD = B->child1;
+		int iE = B->child2;
+		TreeNode* D = &m_nodes[iD];
+		TreeNode* E = &m_nodes[iE];
+
+		// swap A and B
+		B->child1 = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+
+		if (B->parent != NullNode)
+		{
+			if (m_nodes[B->parent].child1 == iA)
+				m_nodes[B->parent].child1 = iB;
+			else
+				m_nodes[B->parent].child2 = iB;
+		}
+		else
+		{
+			m_root = iB;
+		}
+
+		if (D->height > E->height)
+		{
+			B->child2 = iD;
+			A->child1 = iE;
+			E->parent = iA;
+			A->aabb = AABB::merge(C->aabb, E->aabb);
+			B->aabb = AABB::merge(A->aabb, D->aabb);
+			A->height = 1 + std::max(C->height, E->height);
+			B->height = 1 + std::max(A->height, D->height);
+		}
+		else
+		{
+			B->child2 = iE;
+			A->child1 = iD;
+			D->parent = iA;
+			A->aabb = AABB::merge(C->aabb, D->aabb);
+			B->aabb = AABB::merge(A->aabb, E->aabb);
+			A->height = 1 + std::max(C->height, D->height);
+			B->height = 1 + std::max(A->height, E->height);
+		}
+		return iB;
+	}
+
+	return iA;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "Collision.h"
+#include "CollisionLayers.h"
+
+#include <vector>
+
+// Dynamic bounding volume tree used as the collision broadphase.
+// Leaves store fat AABBs so small movements do not touch the tree,
+// internal nodes are kept balanced with AVL style rotations.
+class DynamicAABBTree
+{
+public:
+	static const int NullNode = -1;
+
+	DynamicAABBTree(float fatMargin = 0.2f, float displacementMultiplier = 2.0f)
+		: m_root(NullNode), m_freeList(NullNode), m_nodeCount(0), m_proxyCount(0),
+		m_fatMargin(fatMargin), m_displacementMultiplier(displacementMultiplier) {}
+
+	// proxy api
+	int createProxy(const AABB& aabb, void* userData);
+	void destroyProxy(int proxyId);
+	// Returns true if the proxy had to be re-inserted
+	bool moveProxy(int proxyId, const AABB& aabb, const Vec3& displacement);
+
+	void* getUserData(int proxyId) const { return m_nodes[proxyId].userData; }
+	const AABB& getFatAABB(int proxyId) const { return m_nodes[proxyId].aabb; }
+	int getProxyCount() const { return m_proxyCount; }
+	int getHeight() const { return m_root == NullNode ? 0 : m_nodes[m_root].height; }
+
+	// Calls callback(proxyId) for every leaf whose fat AABB overlaps aabb.
+	// Return false from the callback to stop the query.
+	template<typename Callback>
+	void query(const AABB& aabb, Callback&& callback) const
+	{
+		traverse([&aabb](const AABB& nodeAABB) { return nodeAABB.overlaps(aabb); }, callback);
+	}
+
+	// Generic traversal, nodeTest(aabb) decides whether to descend into a node,
+	// leafCallback(proxyId) is called for accepted leaves and returns false to stop.
+	template<typename NodeTest, typename LeafCallback>
+	void traverse(NodeTest&& nodeTest, LeafCallback&& leafCallback) const
+	{
+		if (m_root == NullNode)
+			return;
+
+		// the tree is balanced, so the inline stack is plenty. Should it ever run out the
+		// walk moves to the heap rather than writing past it
+		int inlineStack[InlineStackDepth];
+		std::vector<int> heapStack;
+		int* stack = inlineStack;
+		int capacity = InlineStackDepth;
+		int count = 0;
+		stack[count++] = m_root;
+		while (count > 0)
+		{
+			int nodeId = stack[--count];
+			const TreeNode& node = m_nodes[nodeId];
+			if (!nodeTest(node.aabb))
+				continue;
+
+			if (node.isLeaf())
+			{
+				if (!leafCallback(nodeId))
+					return;
+			}
+			else
+			{
+				if (count + 2 > capacity)
+				{
+					capacity *= 2;
+					if (stack == inlineStack)
+						heapStack.assign(inlineStack, inlineStack + count);
+					heapStack.resize(capacity);
+					stack = heapStack.data();
+				}
+				stack[count++] = node.child1;
+				stack[count++] = node.child2;
+			}
+		}
+	}
+
+private:
+	static const int InlineStackDepth = 256;
+
+	struct TreeNode
+	{
+		AABB aabb;
+		void* userData = nullptr;
+		union
+		{
+			int parent;
+			int next;	// free list
+		};
+		int child1 = NullNode;
+		int child2 = NullNode;
+		int height = -1;	// leaf = 0, free node = -1
+
+		TreeNode() : parent(NullNode) {}
+		bool isLeaf() const { return child1 == NullNode; }
+	};
+
+	int allocateNode();
+	void freeNode(int nodeId);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int nodeId);
+	void refitAncestors(int nodeId);
+
+	std::vector<TreeNode> m_nodes;
+	int m_root;
+	int m_freeList;
+	int m_nodeCount;
+	int m_proxyCount;
+	float m_fatMargin;
+	float m_displacementMultiplier;
+};
+
+// One tree per collision layer, so a query only walks the layers in its mask
+class LayeredBroadphase
+{
+public:
+	int createProxy(CollisionLayer layer, const AABB& aabb, void* userData) { return tree(layer).createProxy(aabb, userData); }
+	void destroyProxy(CollisionLayer layer, int proxyId) { tree(layer).destroyProxy(proxyId); }
+	bool moveProxy(CollisionLayer layer, int proxyId, const AABB& aabb, const Vec3& displacement) { return tree(layer).moveProxy(proxyId, aabb, displacement); }
+	const AABB& getFatAABB(CollisionLayer layer, int proxyId) const { return tree(layer).getFatAABB(proxyId); }
+
+	const DynamicAABBTree& getTree(CollisionLayer layer) const { return tree(layer); }
+	int getProxyCount() const
+	{
+		int count = 0;
+		for (const DynamicAABBTree& layerTree : m_trees)
+			count += layerTree.getProxyCount();
+		return count;
+	}
+
+	// calls callback(userData) for every proxy in layerMask whose fat AABB overlaps aabb,
+	// return false from the callback to stop the query
+	template<typename Callback>
+	void query(const AABB& aabb, unsigned int layerMask, Callback&& callback) const
+	{
+		traverse(layerMask, [&aabb](const AABB& nodeAABB) { return nodeAABB.overlaps(aabb); }, callback);
+	}
+
+	// DynamicAABBTree::traverse over every layer in layerMask, the leaf callback gets the user data
+	template<typename NodeTest, typename LeafCallback>
+	void traverse(unsigned int layerMask, NodeTest&& nodeTest, LeafCallback&& leafCallback) const
+	{
+		bool stopped = false;
+		for (int layer = 0; layer < LayerCount && !stopped; layer++)
+		{
+			if (!(layerMask & (1u << layer)) || m_trees[layer].getProxyCount() == 0)
+				continue;
+			const DynamicAABBTree& layerTree = m_trees[layer];
+			layerTree.traverse(nodeTest, [&](int proxyId)
+			{
+				stopped = !leafCallback(layerTree.getUserData(proxyId));
+				return !stopped;
+			});
+		}
+	}
+
+private:
+	static const int LayerCount = static_cast<int>(CollisionLayer::Count);
+
+	DynamicAABBTree& tree(CollisionLayer layer) { return m_trees[static_cast<int>(layer)]; }
+	const DynamicAABBTree& tree(CollisionLayer layer) const { return m_trees[static_cast<int>(layer)]; }
+
+	DynamicAABBTree m_trees[LayerCount];
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+// Fixed order of work in a frame. Input and the three simulation phases run once per
+// fixed step, RenderPrep once per frame before drawing
+enum class FramePhase
+{
+	Input,		// player movement and collision response, run by the game loop
+	Gameplay,	// actor OnTick
+	Physics,	// projectiles, broadphase refit
+	Animation,	// animation state machines and bone poses
+	RenderPrep,	// per frame data for drawing
+	Count
+};
+
+// data a phase reads or writes
+namespace FrameResource
+{
+	const unsigned int Input = 1u << 0;
+	const unsigned int OwnActor = 1u << 1;		// the actor being updated, nothing else
+	const unsigned int OtherActors = 1u << 2;	// state of any other actor
+	const unsigned int Transforms = 1u << 3;	// world transforms of all actors
+	const unsigned int Broadphase = 1u << 4;
+	const unsigned int Projectiles = 1u << 5;
+	const unsigned int AnimationAssets = 1u << 6;	// shared skeletons and clips
+	const unsigned int Commands = 1u << 7;		// the level's command buffer, thread safe
+	const unsigned int RenderData = 1u << 8;
+
+	// writes that stay inside one actor or go through a thread safe queue
+	const unsigned int PerActorWrites = OwnActor | Commands;
+}
+
+struct FramePhaseDesc
+{
+	const char* name;
+	unsigned int reads;
+	unsigned int writes;
+	bool parallelActors;	// actors are updated on the job system
+};
+
+// Read and write sets of every phase. Parallel phases may only write per-actor state, a
+// write to another actor is queued and applied at the phase boundary (Level::FlushCommands)
+class FramePhases
+{
+public:
+	static constexpr FramePhaseDesc Table[static_cast<int>(FramePhase::Count)] =
+	{
+		{ "Input",
+			FrameResource::Input | FrameResource::Transforms | FrameResource::Broadphase,
+			FrameResource::OtherActors | FrameResource::Transforms | FrameResource::Commands, false },
+		{ "Gameplay",
+			FrameResource::OwnActor | FrameResource::Transforms | FrameResource::Broadphase,
+			FrameResource::OwnActor | FrameResource::Commands, true },
+		{ "Physics",
+			FrameResource::Transforms | FrameResource::Broadphase | FrameResource::Projectiles,
+			FrameResource::Broadphase | FrameResource::Projectiles | FrameResource::OtherActors, false },
+		{ "Animation",
+			FrameResource::OwnActor | FrameResource::AnimationAssets,
+			FrameResource::OwnActor, true },
+		{ "RenderPrep",
+			FrameResource::Transforms | FrameResource::Projectiles,
+			FrameResource::RenderData, false },
+	};
+
+	static constexpr const FramePhaseDesc& get(FramePhase phase) { return Table[static_cast<int>(phase)]; }
+
+	static constexpr bool writesOnlyPerActor(const FramePhaseDesc& desc)
+	{
+		return (desc.writes & ~FrameResource::PerActorWrites) == 0;
+	}
+	static constexpr bool parallelPhasesAreSafe()
+	{
+		for (const FramePhaseDesc& desc : Table)
+		{
+			if (desc.parallelActors && !writesOnlyPerActor(desc))
+				return false;
+		}
+		return true;
+	}
+};
+
+static_assert(FramePhases::parallelPhasesAreSafe(), "a parallel phase writes shared state");
@@ -26,6 +26,7 @@ SOFTWARE.
 
 #include <vector>
 #include <string>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -9,7 +9,14 @@
 #include "algorithm"
 #include "World.h"
 #include "TextureManager.h"
+#include "SceneQuery.h"
+#include "AssetCache.h"
+#include "JobSystem.h"
 #include "World.h"
+#include "DynamicAABBTree.h"
+
+#include <random>
+#include <set>
 //#include "GamesEngineeringBase.h"
 #define M_PI       3.14159265358979323846   // pi
 
@@ -24,6 +31,7 @@ const bool LOCK_MOUSE_ON_START = true;
 // Gravity Parameters
 const float GRAVITY = 98.0f;              
 const float GROUND_THRESHOLD = 0.01f;     
+const float GROUND_PROBE_DISTANCE = 1.0f;  // how far below the body still counts as ground
 const float JUMP_FORCE = 30.0f;           
 const float GROUND_ADJUST = 0.01f;        
 bool IsGravityMode = true;
@@ -56,7 +64,9 @@ void submitToCommandList(Core* core, std::vector<ConstantBuffer>& constantBuffer
 {
 	for (int i = 0; i < constantBuffers.size(); i++)
 	{
+#ifdef _WIN32
 		core->getCommandList()->SetGraphicsRootConstantBufferView(i, constantBuffers[i].getGPUAddress());
+#endif
 		constantBuffers[i].next();
 	}
 }
@@ -66,9 +76,512 @@ const std::string LEVEL1_PATH = "level1.lvl";
 const std::string LEVEL2_PATH = "level2.lvl"; // no exist
 int currentLevel = 1; // current level index
 
+// headless run: -headless [ticks]
+const std::string HEADLESS_REPORT_PATH = "headless_report.txt";
+const int HEADLESS_DEFAULT_TICKS = 3600;
+// the level is saved with its spawn here, out of reach of every cell, and switched to
+const std::string HEADLESS_SWITCH_PATH = "headless_switch.lvl";
+const Vec3 HEADLESS_SWITCH_SPAWN = Vec3(0.0f, 15.0f, 1000.0f);
+
+// TestMap without a window or GPU, for soak tests, bots and tick-rate benchmarks.
+// Ticks run back to back, the report keeps simulation and render prep cost apart
+int runHeadless(int ticks)
+{
+	Core core;
+	core.initHeadless(WIDTH, HEIGHT);
+
+	World* myWorld = World::Create(core);
+	JobSystem* jobs = JobSystem::Create();
+	GeneralMatrix::Create();
+	TextureManager::Create();
+	myWorld->LoadNewLevel(std::make_shared<TestMap>());
+	Actor* viewActor = myWorld->GetLevel()->GetActor("FPSActor");
+
+	Timer timer;
+	float simulationTime = 0.0f;
+	float renderPrepTime = 0.0f;
+	for (int i = 0; i < ticks; i++)
+	{
+		timer.reset();
+		myWorld->garbageCollection();
+		if (viewActor)
+			myWorld->ExecuteStreaming(viewActor->getWorldPos());
+		myWorld->ExecuteBeginPlays();
+		myWorld->StepFixed();
+		simulationTime += timer.dt();
+
+		// draws are only recorded
+		myWorld->ExecuteRenderPrep();
+		myWorld->ExecuteDraw();
+		renderPrepTime += timer.dt();
+	}
+
+	std::ofstream report(HEADLESS_REPORT_PATH, std::ios::trunc);
+	report << "ticks " << ticks << "\n";
+	report << "simulation ms/tick " << simulationTime * 1000.0f / ticks << "\n";
+	report << "render prep ms/tick " << renderPrepTime * 1000.0f / ticks << "\n";
+	report << "actors " << myWorld->GetLevel()->GetAllActors().size() << "\n";
+	report << "draws per frame " << RenderSystem::getDrawCount() << "\n";
+
+	// a switch must release the meshes only the old level's cells used
+	int meshesBefore = AssetCache::getStaticMeshCount();
+	myWorld->GetLevel()->SetSpawnPoint(HEADLESS_SWITCH_SPAWN);
+	if (myWorld->GetLevel()->SaveLevel(HEADLESS_SWITCH_PATH) &&
+		myWorld->RequestLevelSwitch(std::make_shared<TestMap>(false), HEADLESS_SWITCH_PATH))
+	{
+		while (myWorld->IsSwitchingLevel())
+			myWorld->UpdateLevelSwitch();
+	}
+	report << "static meshes before switch " << meshesBefore << "\n";
+	report << "static meshes after switch " << AssetCache::getStaticMeshCount() << "\n";
+
+	jobs->shutdown();
+	return 0;
+}
+
+// benchmark run: -bench, each timing is against the code it replaced
+const std::string BENCH_REPORT_PATH = "bench_report.txt";
+const int BENCH_QUERIES = 10000;
+const int BENCH_OBB_BOXES = 1024;
+const int BENCH_OBB_TESTED = 256;
+const int BENCH_PARALLEL_ITEMS = 1 << 22;
+const int BENCH_LEVEL_ACTORS = 100000;
+const int BENCH_PROJECTILES = 10000;
+const int BENCH_PROJECTILE_TICKS = 300;
+const int BENCH_PROJECTILE_WALLS = 32;		// per side of the grid of boxes they fly through
+const std::string BENCH_LEVEL_V1_PATH = "bench_v1.lvl";
+const std::string BENCH_LEVEL_V2_PATH = "bench_v2.lvl";
+
+// Broadphase queries against the linear scan over every collidable the resolver used to do.
+// Static boxes at a fixed density, so the level grows with the count, queried with a
+// character sized box
+void benchBroadphase(std::ofstream& report)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int count : { 100, 1000, 10000 })
+	{
+		float extent = 10.0f * sqrtf(static_cast<float>(count));
+		std::vector<AABB> boxes(count);
+		DynamicAABBTree tree;
+		for (AABB& box : boxes)
+		{
+			Vec3 centre((unit(random) * 2.0f - 1.0f) * extent, 0.0f, (unit(random) * 2.0f - 1.0f) * extent);
+			Vec3 halfExtents = Vec3(0.5f, 0.5f, 0.5f) + Vec3(unit(random), unit(random), unit(random)) * 2.0f;
+			box = AABB::fromCentreExtents(centre, halfExtents);
+			tree.createProxy(box, &box);
+		}
+		std::vector<AABB> queries(BENCH_QUERIES);
+		for (AABB& query : queries)
+		{
+			Vec3 centre((unit(random) * 2.0f - 1.0f) * extent, 1.0f, (unit(random) * 2.0f - 1.0f) * extent);
+			query = AABB::fromCentreExtents(centre, Vec3(0.5f, 1.0f, 0.5f));
+		}
+
+		Timer timer;
+		int treeCandidates = 0;
+		for (const AABB& query : queries)
+			tree.query(query, [&treeCandidates](int) { treeCandidates++; return true; });
+		float treeTime = timer.dt();
+
+		int scanCandidates = 0;
+		for (const AABB& query : queries)
+		{
+			for (const AABB& box : boxes)
+			{
+				if (box.overlaps(query))
+					scanCandidates++;
+			}
+		}
+		float scanTime = timer.dt();
+
+		// the tree's leaves are fat, so it hands the narrowphase a few more
+		report << "broadphase " << count << " static actors: tree " << treeTime * 1e6f / BENCH_QUERIES
+			<< " us/query, linear scan " << scanTime * 1e6f / BENCH_QUERIES << " us/query, candidates/query "
+			<< static_cast<float>(treeCandidates) / BENCH_QUERIES << " / "
+			<< static_cast<float>(scanCandidates) / BENCH_QUERIES << "\n";
+	}
+}
+
+// checkOBBOBB as it was, projecting all eight corners of both boxes on each axis
+CollisionResult checkOBBOBBByVertices(const OBB& obbA, const OBB& obbB)
+{
+	auto project = [](const std::vector<Vec3>& points, const Vec3& axis, float& minProj, float& maxProj)
+	{
+		minProj = FLT_MAX;
+		maxProj = -FLT_MAX;
+		for (const Vec3& p : points)
+		{
+			float proj = Dot(p, axis);
+			minProj = std::min(minProj, proj);
+			maxProj = std::max(maxProj, proj);
+		}
+	};
+
+	CollisionResult result;
+	float minPenetration = FLT_MAX;
+	Vec3 bestAxis;
+	std::vector<Vec3> axes = {
+		obbA.xAxis, obbA.yAxis, obbA.zAxis,
+		obbB.xAxis, obbB.yAxis, obbB.zAxis,
+		Cross(obbA.xAxis, obbB.xAxis), Cross(obbA.xAxis, obbB.yAxis), Cross(obbA.xAxis, obbB.zAxis),
+		Cross(obbA.yAxis, obbB.xAxis), Cross(obbA.yAxis, obbB.yAxis), Cross(obbA.yAxis, obbB.zAxis),
+		Cross(obbA.zAxis, obbB.xAxis), Cross(obbA.zAxis, obbB.yAxis), Cross(obbA.zAxis, obbB.zAxis)
+	};
+	for (Vec3& axis : axes)
+	{
+		if (axis.lengthSq() < 1e-6f)
+			continue;
+		axis = axis.normalize();
+
+		float minA, maxA, minB, maxB;
+		project(obbA.getVertices(), axis, minA, maxA);
+		project(obbB.getVertices(), axis, minB, maxB);
+		float overlap = getOverlap(minA, maxA, minB, maxB);
+		if (overlap < 0)
+			return result;
+		if (overlap < minPenetration)
+		{
+			minPenetration = overlap;
+			bestAxis = axis;
+		}
+	}
+
+	result.isColliding = true;
+	result.penetration = minPenetration;
+	if (Dot(bestAxis, obbB.center - obbA.center) < 0)
+		bestAxis = -bestAxis;
+	result.normal = bestAxis;
+	return result;
+}
+
+// The old vertex projection against checkOBBOBB and checkOBBOBBBatch, over the same random
+// pairs. About a third of them overlap. Mismatches are pairs where a path disagrees with the old
+// one on the hit, or checkOBBOBB on the depth
+void benchOBB(std::ofstream& report)
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto randomOBB = [&]()
+	{
+		OBB obb;
+		obb.center = Vec3(unit(random), unit(random), unit(random)) * 5.0f;
+		Vec3 x = Vec3(unit(random), unit(random), unit(random)) + Vec3(0.0f, 0.0f, 0.01f);
+		obb.xAxis = x.normalize();
+		obb.yAxis = Cross(obb.xAxis, Vec3(unit(random), unit(random), unit(random)) + Vec3(0.01f, 0.0f, 0.0f)).normalize();
+		obb.zAxis = Cross(obb.xAxis, obb.yAxis);
+		obb.halfExtents = Vec3(unit(random), unit(random), unit(random)) + Vec3(2.0f, 2.0f, 2.0f);
+		return obb;
+	};
+	std::vector<OBB> boxes(BENCH_OBB_BOXES);
+	OBBBatch batch;
+	batch.reserve(BENCH_OBB_BOXES);
+	for (OBB& box : boxes)
+	{
+		box = randomOBB();
+		batch.add(box);
+	}
+	std::vector<OBB> tested(BENCH_OBB_TESTED);
+	for (OBB& box : tested)
+		box = randomOBB();
+
+	const int pairs = BENCH_OBB_TESTED * BENCH_OBB_BOXES;
+	std::vector<CollisionResult> byVertices(pairs);
+	std::vector<CollisionResult> bySAT(pairs);
+	std::vector<unsigned char> byBatch(static_cast<size_t>(BENCH_OBB_TESTED) * batch.paddedSize());
+
+	Timer timer;
+	for (int a = 0; a < BENCH_OBB_TESTED; a++)
+	{
+		for (int b = 0; b < BENCH_OBB_BOXES; b++)
+			byVertices[a * BENCH_OBB_BOXES + b] = checkOBBOBBByVertices(tested[a], boxes[b]);
+	}
+	float verticesTime = timer.dt();
+	for (int a = 0; a < BENCH_OBB_TESTED; a++)
+	{
+		for (int b = 0; b < BENCH_OBB_BOXES; b++)
+			bySAT[a * BENCH_OBB_BOXES + b] = CollisionDetector::checkOBBOBB(tested[a], boxes[b]);
+	}
+	float satTime = timer.dt();
+	for (int a = 0; a < BENCH_OBB_TESTED; a++)
+		CollisionDetector::checkOBBOBBBatch(tested[a], batch, &byBatch[static_cast<size_t>(a) * batch.paddedSize()]);
+	float batchTime = timer.dt();
+
+	int hits = 0;
+	int satMismatches = 0;
+	int batchMismatches = 0;
+	for (int a = 0; a < BENCH_OBB_TESTED; a++)
+	{
+		for (int b = 0; b < BENCH_OBB_BOXES; b++)
+		{
+			const CollisionResult& reference = byVertices[a * BENCH_OBB_BOXES + b];
+			const CollisionResult& sat = bySAT[a * BENCH_OBB_BOXES + b];
+			hits += reference.isColliding ? 1 : 0;
+			if (sat.isColliding != reference.isColliding ||
+				(reference.isColliding && fabsf(sat.penetration - reference.penetration) > 1e-3f))
+				satMismatches++;
+			if ((byBatch[static_cast<size_t>(a) * batch.paddedSize() + b] != 0) != reference.isColliding)
+				batchMismatches++;
+		}
+	}
+
+	report << "obb " << pairs << " pairs, " << hits << " overlapping: vertex projection "
+		<< verticesTime * 1e9f / pairs << " ns/test, checkOBBOBB " << satTime * 1e9f / pairs << " ns/test ("
+		<< satMismatches << " mismatches), checkOBBOBBBatch " << batchTime * 1e9f / pairs << " ns/test ("
+		<< batchMismatches << " mismatches)\n";
+}
+
+// a compute bound loop serially and through parallelFor at a few grain sizes
+void benchParallelFor(std::ofstream& report)
+{
+	JobSystem* jobs = JobSystem::Get();
+	std::vector<float> values(BENCH_PARALLEL_ITEMS);
+	auto body = [&values](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+			values[i] = sqrtf(static_cast<float>(i)) * sinf(static_cast<float>(i));
+	};
+
+	Timer timer;
+	body(0, BENCH_PARALLEL_ITEMS);
+	float serialTime = timer.dt();
+	report << "parallelFor " << BENCH_PARALLEL_ITEMS << " items on " << jobs->getWorkerCount() << " workers: serial "
+		<< serialTime * 1000.0f << " ms";
+	for (int grainSize : { 1 << 10, 1 << 14, 1 << 18 })
+	{
+		timer.reset();
+		jobs->parallelFor(0, BENCH_PARALLEL_ITEMS, grainSize, body);
+		float parallelTime = timer.dt();
+		report << ", grain " << grainSize << " " << parallelTime * 1000.0f << " ms (" << serialTime / parallelTime << "x)";
+	}
+	report << "\n";
+}
+
+// the old SaveLevel, Level only keeps its reader
+bool saveLevelV1(const Level& level, const std::string& filePath)
+{
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	Vec3 spawnPoint = level.GetSpawnPoint();
+	file.write(reinterpret_cast<const char*>(&spawnPoint), sizeof(Vec3));
+	int actorCount = static_cast<int>(level.GetAllActors().size());
+	file.write(reinterpret_cast<const char*>(&actorCount), sizeof(int));
+	for (const Actor* actor : level.GetAllActors())
+	{
+		const std::string& actorName = actor->getName();
+		int nameLen = static_cast<int>(actorName.size());
+		file.write(reinterpret_cast<const char*>(&nameLen), sizeof(int));
+		file.write(actorName.c_str(), nameLen);
+
+		std::string className = actor->GetClassName();
+		int classLen = static_cast<int>(className.size());
+		file.write(reinterpret_cast<const char*>(&classLen), sizeof(int));
+		file.write(className.c_str(), classLen);
+
+		actor->Save(file);
+	}
+	return file.good();
+}
+
+// The same boxes loaded from a v1 and a v2 file. Both create the same actors and the box
+// mesh is already cached, so the difference is the reading
+void benchLevelLoad(World* world, std::ofstream& report)
+{
+	std::shared_ptr<Level> level = std::make_shared<TestMap>(false);
+	world->LoadNewLevel(level);
+	int side = static_cast<int>(sqrtf(static_cast<float>(BENCH_LEVEL_ACTORS)));
+	for (int i = 0; i < BENCH_LEVEL_ACTORS; i++)
+	{
+		Actor* box = new BoxActor();
+		box->setWorldPos(Vec3(static_cast<float>(i % side) * 4.0f, 0.0f, static_cast<float>(i / side) * 4.0f));
+		level->AddActor("BoxActor" + std::to_string(i), box);
+	}
+	if (!saveLevelV1(*level, BENCH_LEVEL_V1_PATH) || !level->SaveLevel(BENCH_LEVEL_V2_PATH))
+	{
+		report << "level load: the files could not be written\n";
+		return;
+	}
+
+	Timer timer;
+	for (const std::string& path : { BENCH_LEVEL_V1_PATH, BENCH_LEVEL_V2_PATH })
+	{
+		level->ClearActors();
+		timer.reset();
+		bool loaded = level->LoadLevel(path);
+		float loadTime = timer.dt();
+		report << "level load " << path << ": " << loadTime * 1000.0f << " ms, " << level->GetAllActors().size()
+			<< " actors" << (loaded ? "" : ", failed") << "\n";
+	}
+	level->ClearActors();
+}
+
+// Every class's files, fetched one after the other as the actor constructors used to, then
+// by AssetCache::prefetch on the job system. The same rules as prefetchAsync: the textures
+// named by the materials follow their file, and without a device no texture is decoded
+void benchPrefetch(Core* core, std::ofstream& report)
+{
+	AssetList assets;
+	for (const auto& classAssets : Actor::m_classAssets)
+		assets.add(classAssets.second.assets);
+	bool withTextures = !core->isHeadless();
+
+	// once untimed, so neither pass pays for a cold disk
+	{
+		AssetPrefetch warmUp;
+		AssetCache::prefetch(core, assets, warmUp);
+	}
+
+	Timer timer;
+	float slowestFile = 0.0f;
+	{
+		std::vector<std::shared_ptr<GEMFileData>> files;
+		std::vector<std::shared_ptr<TextureImage>> textures;
+		std::set<std::string> requestedTextures;
+		auto fetchTexture = [&](const std::string& path)
+		{
+			if (!requestedTextures.insert(path).second)
+				return;
+			Timer fileTimer;
+			textures.push_back(AssetCache::prefetchTexture(path));
+			slowestFile = std::max(slowestFile, fileTimer.dt());
+		};
+		auto fetchFile = [&](const std::string& path, bool animated)
+		{
+			Timer fileTimer;
+			files.push_back(AssetCache::prefetchGEM(path, animated));
+			slowestFile = std::max(slowestFile, fileTimer.dt());
+			if (!withTextures)
+				return;
+			for (GEMLoader::GEMMesh& mesh : files.back()->meshes)
+			{
+				for (const char* property : { "albedo", "nh" })
+				{
+					std::string texture = mesh.material.find(property).getValue();
+					if (!texture.empty())
+						fetchTexture(texture);
+				}
+			}
+		};
+		timer.reset();
+		for (const std::string& path : assets.staticMeshes)
+			fetchFile(path, false);
+		for (const std::string& path : assets.animatedModels)
+			fetchFile(path, true);
+		if (withTextures)
+		{
+			for (const std::string& path : assets.textures)
+				fetchTexture(path);
+		}
+	}
+	float serialTime = timer.dt();
+
+	{
+		AssetPrefetch prefetched;
+		timer.reset();
+		AssetCache::prefetch(core, assets, prefetched);
+	}
+	float parallelTime = timer.dt();
+
+	// the parallel pass cannot finish before its slowest file
+	report << "prefetch " << assets.staticMeshes.size() + assets.animatedModels.size() << " files"
+		<< (withTextures ? " and their textures" : "") << ": serial " << serialTime * 1000.0f << " ms, parallel "
+		<< parallelTime * 1000.0f << " ms on " << JobSystem::Get()->getWorkerCount() << " workers, slowest file "
+		<< slowestFile * 1000.0f << " ms\n";
+}
+
+// ProjectileSystem at 10k live projectiles, flying level through a grid of static boxes.
+// Walls and the life time retire some every tick, new ones bring the count back to 10k
+// before each update. Update and render prep are timed, spawning is not
+void benchProjectiles(World* world, std::ofstream& report)
+{
+	std::shared_ptr<Level> level = std::make_shared<TestMap>(false);
+	world->LoadNewLevel(level);
+	const float spacing = 40.0f;
+	const float extent = spacing * BENCH_PROJECTILE_WALLS * 0.5f;
+	for (int x = 0; x < BENCH_PROJECTILE_WALLS; x++)
+	{
+		for (int z = 0; z < BENCH_PROJECTILE_WALLS; z++)
+		{
+			Actor* box = new BoxActor();
+			box->setWorldPos(Vec3(x * spacing - extent, 0.0f, z * spacing - extent));
+			level->AddActor(box);
+		}
+	}
+	// places the boxes in the broadphase
+	world->ExecuteBeginPlays();
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	ProjectileSystem& projectiles = level->GetProjectiles();
+	float dt = world->GetFixedDeltaTime();
+	Timer timer;
+	float updateTime = 0.0f;
+	float renderPrepTime = 0.0f;
+	int retired = 0;
+	for (int tick = 0; tick < BENCH_PROJECTILE_TICKS; tick++)
+	{
+		while (projectiles.getCount() < BENCH_PROJECTILES)
+		{
+			Vec3 pos(unit(random) * extent, 1.0f, unit(random) * extent);
+			Vec3 dir(unit(random), unit(random) * 0.05f, unit(random) + 0.01f);
+			projectiles.spawn(pos, dir, 100.0f, 10);
+		}
+		timer.reset();
+		projectiles.update(dt, level->GetBroadphase());
+		updateTime += timer.dt();
+		projectiles.prepareRender(0.5f);
+		renderPrepTime += timer.dt();
+		retired += BENCH_PROJECTILES - projectiles.getCount();
+	}
+
+	report << "projectiles " << BENCH_PROJECTILES << " live, " << BENCH_PROJECTILE_WALLS * BENCH_PROJECTILE_WALLS
+		<< " boxes: update " << updateTime * 1000.0f / BENCH_PROJECTILE_TICKS << " ms/tick, prepareRender "
+		<< renderPrepTime * 1000.0f / BENCH_PROJECTILE_TICKS << " ms/tick, "
+		<< static_cast<float>(retired) / BENCH_PROJECTILE_TICKS << " stopped or expired per tick, "
+		<< (updateTime + renderPrepTime) * 1000.0f / BENCH_PROJECTILE_TICKS << " ms/tick together against a 1 ms budget\n";
+	level->ClearActors();
+}
+
+// every benchmark, one after the other, into the report
+int runBenchmarks()
+{
+	std::ofstream report(BENCH_REPORT_PATH, std::ios::trunc);
+	benchBroadphase(report);
+	benchOBB(report);
+
+	// the rest runs the engine headless, as -headless does
+	Core core;
+	core.initHeadless(WIDTH, HEIGHT);
+	World* myWorld = World::Create(core);
+	JobSystem* jobs = JobSystem::Create();
+	GeneralMatrix::Create();
+	TextureManager::Create();
+	benchParallelFor(report);
+	// before anything is built, prefetch skips resident files
+	benchPrefetch(&core, report);
+	benchLevelLoad(myWorld, report);
+	benchProjectiles(myWorld, report);
+
+	jobs->shutdown();
+	return 0;
+}
+
+#ifdef _WIN32
 int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	PSTR lpCmdLine, int nCmdShow)
 {
+	if (strstr(lpCmdLine, "-bench") != nullptr)
+		return runBenchmarks();
+
+	const char* headlessArg = strstr(lpCmdLine, "-headless");
+	if (headlessArg != nullptr)
+	{
+		int ticks = atoi(headlessArg + strlen("-headless"));
+		return runHeadless(ticks > 0 ? ticks : HEADLESS_DEFAULT_TICKS);
+	}
+
 	// activate or create single instance
 	Window win;
 	Core core;
@@ -77,13 +590,14 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	core.init(win.hwnd, WIDTH, HEIGHT);
 
 	World* myWorld = World::Create(core);
+	JobSystem* jobs = JobSystem::Create();
 	GeneralMatrix* gm = GeneralMatrix::Create();
 	TextureManager* textures = TextureManager::Create();
 
 	// Initial load TestMap and save it as Level 1
-	auto initialLevel = std::make_shared<TestMap>();
-	initialLevel->SaveLevel(LEVEL1_PATH); 
-	myWorld->LoadNewLevel(initialLevel);
+	// the world is the only owner, so a level switch frees it
+	myWorld->LoadNewLevel(std::make_shared<TestMap>());
+	myWorld->GetLevel()->SaveLevel(LEVEL1_PATH);
 
 	Actor* mainActor = myWorld->GetLevel()->GetActor("FPSActor");
 	CameraControllable* mainCameraController = dynamic_cast<CameraControllable*>(mainActor);
@@ -128,6 +642,7 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 	float verticalVelocity = 0.0f; 
 	bool isGrounded = false;       
 	bool firstframe = true;
+	bool jumpRequested = false;    // latched until a tick consumes it
 
 	
 	// calculate window center
@@ -154,47 +669,37 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 		//Process messages 
 		win.processMessages();
 
-		// level switch
-		
+		// level switch, the file loads in the background and the level swaps in below once ready.
+		// Levels from file start empty, the actors come from the file and the streaming cells
 		if (win.keys['1'] && win.keyJustPressed['1']) {
-			auto level1 = std::make_shared<TestMap>();
-			if (level1->LoadLevel(LEVEL1_PATH)) {
-				myWorld->LoadNewLevel(level1);
-				
-				mainActor = myWorld->GetLevel()->GetActor("FPSActor");
-				mainCameraController = dynamic_cast<CameraControllable*>(mainActor);
-				if (mainCameraController)
-				{
-					mainCameraController->updatePos(myWorld->GetLevel()->GetSpawnPoint());
-				}
+			if (myWorld->RequestLevelSwitch(std::make_shared<TestMap>(false), LEVEL1_PATH)) {
+				currentLevel = 1;
 			}
-			currentLevel = 1;
-			
 		}
 
-		// switch to level 2 (haven't achieved)
 		if (win.keys['2'] && win.keyJustPressed['2']) {
-			auto level2 = std::make_shared<TestMap>();
-			if (!level2->LoadLevel(LEVEL2_PATH)) {
-				
-				level2->SetSpawnPoint(Vec3(60.0f, 15.0f, 0.0f)); 
+			if (!myWorld->RequestLevelSwitch(std::make_shared<TestMap>(false), LEVEL2_PATH)) {
+				// first visit, level 2 is TestMap with its own spawn point
+				auto level2 = std::make_shared<TestMap>();
+				level2->SetSpawnPoint(Vec3(60.0f, 15.0f, 0.0f));
 				level2->SaveLevel(LEVEL2_PATH);
+				myWorld->RequestLevelSwitch(std::make_shared<TestMap>(false), LEVEL2_PATH);
 			}
-			myWorld->LoadNewLevel(level2);
-			
+			currentLevel = 2;
+		}
+
+		// frame boundary, nothing of the old level is held past here
+		if (myWorld->UpdateLevelSwitch()) {
 			mainActor = myWorld->GetLevel()->GetActor("FPSActor");
 			mainCameraController = dynamic_cast<CameraControllable*>(mainActor);
 			if (mainCameraController)
 			{
 				mainCameraController->updatePos(myWorld->GetLevel()->GetSpawnPoint());
 			}
-			currentLevel = 2;
-			
 		}
 
 		// update time
 		myWorld->UpdateTime();
-		float dt = myWorld->GetDeltatime();
 
 		// garbage Collection 
 		if (!firstframe)
@@ -204,8 +709,7 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 		static bool testspawn = true;
 		if (myWorld->GetLevel() != nullptr && testspawn)
 		{
-			Actor* bullet = new BulletActor(Vec3(0.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f), 0.f);
-			myWorld->addActor("bullet", bullet);
+			myWorld->spawnProjectile(Vec3(0.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f), 0.f);
 			testspawn = false;
 		}
 		// Process mouse control
@@ -234,7 +738,14 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 
 		Vec3 cameraForward;
 		Vec3 cameraLeft;
-		// begin play
+		Vec3 cameraUp = Vec3(0.0f, 1.0f, 0.0f);
+		Vec3 moveForward;
+		Vec3 moveRight;
+		// stream cells around the player, then begin play
+		if (mainActor)
+		{
+			myWorld->ExecuteStreaming(mainActor->getWorldPos());
+		}
 		myWorld->ExecuteBeginPlays();
 		// perspective control
 		if (mouseLocked ) 
@@ -258,7 +769,6 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 
 			
 			
-			Vec3 moveForward;
 			cameraForward.x = cos(cameraYaw) * cos(cameraPitch);
 			cameraForward.y = sin(cameraPitch);
 			
@@ -275,185 +785,199 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 			}*/
 			// Calculate the left direction of the camera
 			cameraLeft = Cross(cameraForward, Vec3(0.0f, 1.0f, 0.0f)).normalize();
-			Vec3 cameraUp = Vec3(0.0f, 1.0f, 0.0f); 
 
-			Vec3 moveRight = Cross(moveForward, Vec3(0.0f, 1.0f, 0.0f)).normalize();
-			
-			Vec3 desiredMove = Vec3(0, 0, 0);
-			Vec3 gravityMove = Vec3(0.f, 0.f, 0.f);
-			if (IsGravityMode)
+			moveRight = Cross(moveForward, Vec3(0.0f, 1.0f, 0.0f)).normalize();
+		}
+
+		// jump presses are latched so a frame without a tick does not lose them
+		if (win.keys[VK_SPACE] && win.keyJustPressed[VK_SPACE])
+		{
+			jumpRequested = true;
+		}
+
+		// fixed step simulation, zero or more ticks per frame
+		while (myWorld->BeginFixedStep())
+		{
+			float dt = myWorld->GetFixedDeltaTime();
+			if (mouseLocked)
 			{
+				Vec3 desiredMove = Vec3(0, 0, 0);
+				Vec3 gravityMove = Vec3(0.f, 0.f, 0.f);
+				if (IsGravityMode)
+				{
 				
 
-				if (win.keys['W']) desiredMove += moveForward * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['S']) desiredMove -= moveForward * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['A']) desiredMove += moveRight * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['D']) desiredMove -= moveRight * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['W']) desiredMove += moveForward * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['S']) desiredMove -= moveForward * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['A']) desiredMove += moveRight * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['D']) desiredMove -= moveRight * CAMERA_MOVE_SPEED * dt;
 				
-				desiredMove.y = 0.f;
-				//desiredMove.normalize();
-				//if (win.keys['Q']) desiredMove.y -= CAMERA_MOVE_SPEED * dt;
-				//if (win.keys['E']) desiredMove.y += CAMERA_MOVE_SPEED * dt;
-				if (win.keys['F']) mainActor->setWorldPos(Vec3(40.f,15.f,0.f));
+					desiredMove.y = 0.f;
+					//desiredMove.normalize();
+					//if (win.keys['Q']) desiredMove.y -= CAMERA_MOVE_SPEED * dt;
+					//if (win.keys['E']) desiredMove.y += CAMERA_MOVE_SPEED * dt;
+					if (win.keys['F']) mainActor->setWorldPos(Vec3(40.f,15.f,0.f));
 				
-				// add verticalVelocity for gravity
-				if (!firstframe&& !isGrounded)
-				{
+					// add verticalVelocity for gravity
+					if (!firstframe&& !isGrounded)
+					{
 					
-					verticalVelocity -= GRAVITY * dt; 
+						verticalVelocity -= GRAVITY * dt; 
 					
-				}
-				else
-				{
-					firstframe = false;
-				}
+					}
+					else
+					{
+						firstframe = false;
+					}
 					
-				//}
+					//}
 
-				// jump
-				if (win.keys[VK_SPACE] && win.keyJustPressed[VK_SPACE] && isGrounded)
-				{
-					verticalVelocity = JUMP_FORCE; 
-					isGrounded = false;           
+					// jump
+					if (jumpRequested && isGrounded)
+					{
+						verticalVelocity = JUMP_FORCE; 
+						isGrounded = false;           
 					
-				}
+					}
 
-				// merge gravity move
-				gravityMove = Vec3(0, verticalVelocity*dt , 0);
-				desiredMove += gravityMove;
-			}
-			else
-			{
+					// merge gravity move
+					gravityMove = Vec3(0, verticalVelocity*dt , 0);
+					desiredMove += gravityMove;
+				}
+				else
+				{
 				
 
-				if (win.keys['W']) desiredMove += cameraForward * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['S']) desiredMove -= cameraForward * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['A']) desiredMove += cameraLeft * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['D']) desiredMove -= cameraLeft * CAMERA_MOVE_SPEED * dt;
-				if (win.keys['Q']) desiredMove.y -= CAMERA_MOVE_SPEED * dt;
-				if (win.keys['E']) desiredMove.y += CAMERA_MOVE_SPEED * dt;
-			}
+					if (win.keys['W']) desiredMove += cameraForward * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['S']) desiredMove -= cameraForward * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['A']) desiredMove += cameraLeft * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['D']) desiredMove -= cameraLeft * CAMERA_MOVE_SPEED * dt;
+					if (win.keys['Q']) desiredMove.y -= CAMERA_MOVE_SPEED * dt;
+					if (win.keys['E']) desiredMove.y += CAMERA_MOVE_SPEED * dt;
+				}
 			
 			
 			
-			// slide collision check
-			auto collidableActors = myWorld->getCollidableActors();
-			Vec3 resolvedMove = CollisionResolver::resolveSlidingCollision(mainActor, desiredMove, collidableActors, 0.01f);
+				// the world shapes come from the store, rebuild so a teleport this tick shows
+				TransformStore::Get().updateWorldMatrices();
+				// slide collision check
+				Vec3 resolvedMove = CollisionResolver::resolveSlidingCollision(mainActor, desiredMove, myWorld->GetLevel()->GetBroadphase(), 0.01f, &myWorld->GetLevel()->GetContactCache());
 
-			if (IsGravityMode)
-			{
-				// check if grounded
-				float verticalDesired = gravityMove.y; 
-				float verticalResolved = resolvedMove.y; 
-				if (verticalDesired < -GROUND_THRESHOLD && abs(verticalResolved - verticalDesired) > GROUND_THRESHOLD)
+				if (IsGravityMode)
 				{
+					// check if grounded
+					float verticalDesired = gravityMove.y; 
+					float verticalResolved = resolvedMove.y; 
+					if (verticalDesired < -GROUND_THRESHOLD && abs(verticalResolved - verticalDesired) > GROUND_THRESHOLD)
+					{
 					
-					verticalVelocity = 0.0f;
-					isGrounded = true;
+						verticalVelocity = 0.0f;
+						isGrounded = true;
 
 					
-					Vec3 currentPos = mainActor->getWorldPos();
-					mainActor->setWorldPos(Vec3(currentPos.x, currentPos.y, currentPos.z));
-				}
+						Vec3 currentPos = mainActor->getWorldPos();
+						mainActor->setWorldPos(Vec3(currentPos.x, currentPos.y, currentPos.z));
+					}
 				
-				//Vec3 currentPos = mainActor->getWorldPos();
-				//Vec3 newPos = currentPos + resolvedMove;
-				//mainActor->setWorldPos(newPos); 
+					//Vec3 currentPos = mainActor->getWorldPos();
+					//Vec3 newPos = currentPos + resolvedMove;
+					//mainActor->setWorldPos(newPos); 
 
 				
-				//float verticalDesired = gravityMove.y; 
-				//float verticalResolved = resolvedMove.y; 
-				//isGrounded = false; 
-
-				
-				//bool isBlockedByGround = (verticalDesired < -GROUND_THRESHOLD) && (abs(verticalResolved - verticalDesired) > GROUND_THRESHOLD);
-				
-				//bool isRayHitGround = false;
-				//if (mainActor)
-				//{
-			
-				//	Vec3 rayOrigin = mainActor->getWorldPos() + Vec3(0, GROUND_THRESHOLD, 0); 
-				//	Vec3 rayDir = Vec3(0, -10, 0); 
-				//	Ray groundRay(rayOrigin, rayDir);
-				//	float t; 
-				//	AABB actorAABB = mainActor->getWorldAABB();
+					//float verticalDesired = gravityMove.y; 
+					//float verticalResolved = resolvedMove.y; 
+					//isGrounded = false; 
 
 				
-				//	for (auto* collActor : myWorld->getCollidableActors())
-				//	{
-				//		if (!collActor || collActor == mainActor || collActor->getActorType() != ActorType::Static)
-				//			continue;
-
-				//		if (collActor->getCollisionShapeType() == CollisionShapeType::AABB)
-				//		{
-				//			CollisionResult rayResult = CollisionDetector::checkRayAABB(groundRay, collActor->getWorldAABB(), t);
-				//			if (rayResult.isColliding && t <= (GROUND_THRESHOLD * 2))
-				//			{
-				//				isRayHitGround = true;
-				//				isGrounded = true;
-				//				break;
-				//			}
-				//		}
-				//		else if (collActor->getCollisionShapeType() == CollisionShapeType::Sphere)
-				//		{
-				//			CollisionResult rayResult = CollisionDetector::checkRaySphere(groundRay, collActor->getWorldSphere(), t);
-				//			if (rayResult.isColliding && t <= (GROUND_THRESHOLD * 2))
-				//			{
-				//				isRayHitGround = true;
-				//				isGrounded = true;
-				//				break;
-				//			}
-				//		}
-				//	}
-				//}
-
+					//bool isBlockedByGround = (verticalDesired < -GROUND_THRESHOLD) && (abs(verticalResolved - verticalDesired) > GROUND_THRESHOLD);
 				
-				//if (isBlockedByGround || isRayHitGround)
-				//{
-				//	isGrounded = true;
-				//	verticalVelocity = 0.0f; 
+					//if (isBlockedByGround || isRayHitGround)
+					//{
+					//	isGrounded = true;
+					//	verticalVelocity = 0.0f; 
 
 			
-				//	if (isRayHitGround)
-				//	{
-				//		Vec3 pos = mainActor->getWorldPos();
-				//		mainActor->setWorldPos(Vec3(pos.x, pos.y, pos.z));
-				//	}
-				//	else
-				//	{
-				//		Vec3 pos = mainActor->getWorldPos();
-				//		mainActor->setWorldPos(Vec3(pos.x, pos.y, pos.z));
-				//	}
-				//}
-				else if (verticalDesired > GROUND_THRESHOLD && abs(verticalResolved - verticalDesired) > GROUND_THRESHOLD)
-				{
-					verticalVelocity = 0.0f; 
+					//	if (isRayHitGround)
+					//	{
+					//		Vec3 pos = mainActor->getWorldPos();
+					//		mainActor->setWorldPos(Vec3(pos.x, pos.y, pos.z));
+					//	}
+					//	else
+					//	{
+					//		Vec3 pos = mainActor->getWorldPos();
+					//		mainActor->setWorldPos(Vec3(pos.x, pos.y, pos.z));
+					//	}
+					//}
+					else if (verticalDesired > GROUND_THRESHOLD && abs(verticalResolved - verticalDesired) > GROUND_THRESHOLD)
+					{
+						verticalVelocity = 0.0f; 
+					}
+					else
+					{
+					
+						Vec3 currentPos = mainActor->getWorldPos();
+						mainActor->setWorldPos(currentPos + resolvedMove);
+					}
 				}
 				else
 				{
-					
+				
 					Vec3 currentPos = mainActor->getWorldPos();
 					mainActor->setWorldPos(currentPos + resolvedMove);
 				}
+			
+
+				// ground probe, start falling again after walking off a ledge
+				if (IsGravityMode && isGrounded)
+				{
+					// probe from where the move above put the player, not the last phase's matrix
+					TransformStore::Get().updateWorldMatrices();
+					const Sphere& body = mainActor->getWorldSphere();
+					SceneQuery sceneQuery(myWorld->GetLevel()->GetBroadphase());
+					RaycastHit groundHit;
+					Ray groundRay(body.centre, Vec3(0, -1, 0));
+					if (!sceneQuery.raycastClosest(groundRay, body.radius + GROUND_PROBE_DISTANCE, groundHit, QueryFilter::only(CollisionLayer::Static, mainActor)))
+					{
+						isGrounded = false;
+					}
+				}
 			}
-			else
+			jumpRequested = false;
+
+			// shoot, the fire rate runs on the tick
+			static bool testbool = true;
+			static float gaptime = 0.2f;
+			if (win.mouseButtons[0] && testbool)
 			{
-				
-				Vec3 currentPos = mainActor->getWorldPos();
-				mainActor->setWorldPos(currentPos + resolvedMove);
+				Vec3 up = Cross(cameraLeft, cameraForward).normalize();
+				myWorld->spawnProjectile(mainActor->getWorldPos() + cameraForward * 2.f - cameraLeft * 0.4 - up * 0.6, cameraForward, 100.f);
+				testbool = false;
+			}
+			if (!testbool)
+			{
+				gaptime -= dt;
+				if (gaptime<=0.f)
+				{
+					testbool = true;
+					gaptime = 0.2f;
+				}
 			}
-			
 
-			
-			Vec3 cameraPos = mainActor->getWorldPos();
+			//fpsActor->Tick(myWorld->GetDeltatime());
+			myWorld->ExecuteTicks();
+		}
+
+		if (mouseLocked)
+		{
+			// the camera follows the body drawn between the last two ticks
+			Matrix renderMat = mainActor->getRenderMatrix();
+			Vec3 cameraPos = Vec3(renderMat.m[3], renderMat.m[7], renderMat.m[11]);
 
 			// update view Projection matrix
 			Matrix p = Matrix::perspective(0.01f, 10000.0f, (float)WIDTH / HEIGHT, 45.0f);
 			Matrix v = Matrix::lookAt(cameraPos, cameraPos + cameraForward, cameraUp);
 			gm->viewProjMatrix = v * p;
 
-			mainCameraController->updatePos(cameraPos);
-
 			// calculate rotation matrix
 			float modelYaw = cameraYaw + M_PI / 2.0f;
 			Quaternion qYaw = Quaternion::fromYRotation(-modelYaw);
@@ -483,36 +1007,14 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 				fpsAnimation->TriggerReload();
 				
 			}
-			// shoot
-			static bool testbool = true;
-			static float gaptime = 0.2f;
+			// shoot animation, the bullets are spawned on the tick
 			if (win.mouseButtons[0]) {
 				fpsAnimation->TriggerFire();
-				if (testbool)
-				{
-					Vec3 up = Cross(cameraLeft, cameraForward).normalize();
-					myWorld->addActor("bullet1", new BulletActor(fpsActor->getWorldPos() + cameraForward * 2.f - cameraLeft * 0.4 - up * 0.6, cameraForward, 100.f));
-					testbool = false;
-				}
-				
-				
-				
-			}
-			
-			if (!testbool)
-			{
-				gaptime -= myWorld->GetDeltatime();
-				if (gaptime<=0.f)
-				{
-					testbool = true;
-					gaptime = 0.2f;
-				}
 			}
 		}
 
-		//fpsActor->Tick(myWorld->GetDeltatime());
-		myWorld->ExecuteTicks();
-		// draw
+		// per frame draw data, then draw
+		myWorld->ExecuteRenderPrep();
 		core.beginFrame();
 
 		core.getCommandList()->SetGraphicsRootSignature(core.rootSignature);
@@ -537,9 +1039,27 @@ int WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 
 	}
 	
+	jobs->shutdown();
 	core.flushGraphicsQueue();
 
 
 	return 0;
 
-}
\ No newline at end of file
+}
+#else
+// no window or device off Windows, only the headless runs: -bench, or -headless [ticks], the default.
+// Every source but JobSystemTests.cpp, which has its own main, goes in:
+//   g++ -std=c++17 -O2 -pthread $(ls *.cpp Levels/*.cpp Animation/*.cpp | grep -v JobSystemTests) -o Game
+int main(int argc, char** argv)
+{
+	int ticks = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-bench") == 0)
+			return runBenchmarks();
+		if (strcmp(argv[i], "-headless") == 0 && i + 1 < argc)
+			ticks = atoi(argv[i + 1]);
+	}
+	return runHeadless(ticks > 0 ? ticks : HEADLESS_DEFAULT_TICKS);
+}
+#endif
@@ -0,0 +1,170 @@
+#include "JobSystem.h"
+
+
+JobSystem* JobSystem::SingleInstance = nullptr;
+thread_local int JobSystem::t_queueIndex = 0;
+
+JobSystem::JobSystem(int workerCount)
+{
+	if (workerCount < 0)
+		workerCount = std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0);
+
+	for (int i = 0; i <= workerCount; i++)
+		m_queues.push_back(std::make_unique<Queue>());
+	for (int i = 1; i <= workerCount; i++)
+		m_workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_running = false;
+	}
+	m_wake.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		if (worker.joinable())
+			worker.join();
+	}
+	m_workers.clear();
+}
+
+void JobSystem::run(Job job, JobCounter* counter)
+{
+	if (counter != nullptr)
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+	Task task;
+	task.job = std::move(job);
+	task.counter = counter;
+	push(std::move(task));
+}
+
+void JobSystem::runAfter(JobCounter& dependency, Job job, JobCounter* counter)
+{
+	// count the job now, so waiting on counter also covers the time it is parked
+	if (counter != nullptr)
+		counter->m_count.fetch_add(1, std::memory_order_relaxed);
+	Task task;
+	task.job = std::move(job);
+	task.counter = counter;
+	{
+		// checked under the lock finish takes, so the continuation cannot be missed
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (!dependency.isDone())
+		{
+			auto shared = std::make_shared<Task>(std::move(task));
+			dependency.m_continuations.push_back([this, shared]() { push(std::move(*shared)); });
+			return;
+		}
+	}
+	push(std::move(task));
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	Task task;
+	while (!counter.isDone())
+	{
+		if (tryGetTask(t_queueIndex, task))
+			execute(task);
+		else
+			std::this_thread::yield();
+	}
+	// the last finish may still hold the lock
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::push(Task task)
+{
+	int index = t_queueIndex < static_cast<int>(m_queues.size()) ? t_queueIndex : 0;
+	{
+		std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+		m_queues[index]->tasks.push_back(std::move(task));
+	}
+	m_queuedTasks.fetch_add(1, std::memory_order_release);
+	// taking the lock orders this against a worker checking the predicate
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+bool JobSystem::tryGetTask(int queueIndex, Task& task)
+{
+	if (m_queuedTasks.load(std::memory_order_acquire) == 0)
+		return false;
+
+	{
+		Queue& own = *m_queues[queueIndex];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			m_queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	int queueCount = static_cast<int>(m_queues.size());
+	for (int i = 1; i < queueCount; i++)
+	{
+		Queue& victim = *m_queues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			m_queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Task& task)
+{
+	task.job();
+	task.job = nullptr;
+	finish(task.counter);
+}
+
+void JobSystem::finish(JobCounter* counter)
+{
+	if (counter == nullptr)
+		return;
+
+	// decrement under the lock: wait takes it before returning, so the counter cannot
+	// go out of scope while this is still using it
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_mutex);
+		if (counter->m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations.swap(counter->m_continuations);
+	}
+	// last job of the counter, release what was waiting on it
+	for (auto& continuation : continuations)
+		continuation();
+}
+
+void JobSystem::workerLoop(int queueIndex)
+{
+	t_queueIndex = queueIndex;
+	Task task;
+	while (m_running)
+	{
+		if (tryGetTask(queueIndex, task))
+		{
+			execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this]() { return !m_running || m_queuedTasks.load(std::memory_order_acquire) > 0; });
+	}
+}
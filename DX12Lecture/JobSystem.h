@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Number of unfinished jobs tied to it. Wait on it with JobSystem::wait, or chain work
+// after it with JobSystem::runAfter
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool isDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+	std::atomic<int> m_count{ 0 };
+	std::mutex m_mutex;
+	std::vector<std::function<void()>> m_continuations;
+};
+
+// Work-stealing job system on std::thread, no platform code.
+// Every worker owns a deque: it pushes and pops at the back, idle workers steal from the
+// front of the others. Queue 0 belongs to the main thread and to any thread that is not a
+// worker. A thread waiting on a counter runs queued jobs until the counter reaches zero,
+// so with no workers every job still runs, on the waiting thread
+class JobSystem
+{
+public:
+	using Job = std::function<void()>;
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	//Get single instance pointer
+	static JobSystem* Get() {
+		return SingleInstance;
+	}
+
+	//Create single instance, workerCount < 0 uses one worker per core besides the caller
+	static JobSystem* Create(int workerCount = -1)
+	{
+		if (SingleInstance == nullptr)
+		{
+			SingleInstance = new JobSystem(workerCount);
+		}
+		return SingleInstance;
+	}
+
+	// stop and join the workers, queued jobs that have not started are dropped
+	void shutdown();
+
+	// queue a job, counter (optional) stays above zero until it has finished
+	void run(Job job, JobCounter* counter = nullptr);
+	// queue a job once dependency reaches zero, right away if it already has
+	void runAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+	// help with queued jobs until the counter reaches zero
+	void wait(JobCounter& counter);
+
+	// body(first, last) over [begin, end) in chunks of grainSize, the caller takes the
+	// first chunk and helps with the rest. Returns once every chunk has run
+	template<typename Body>
+	void parallelFor(int begin, int end, int grainSize, Body&& body)
+	{
+		grainSize = std::max(grainSize, 1);
+		if (end - begin <= grainSize || m_workers.empty())
+		{
+			if (begin < end)
+				body(begin, end);
+			return;
+		}
+
+		JobCounter counter;
+		for (int first = begin + grainSize; first < end; first += grainSize)
+		{
+			int last = std::min(first + grainSize, end);
+			run([&body, first, last]() { body(first, last); }, &counter);
+		}
+		body(begin, begin + grainSize);
+		wait(counter);
+	}
+
+	int getWorkerCount() const { return static_cast<int>(m_workers.size()); }
+	// true on worker threads, false on the main thread
+	static bool isWorkerThread() { return t_queueIndex > 0; }
+
+private:
+	explicit JobSystem(int workerCount);
+	~JobSystem();
+
+	struct Task
+	{
+		Job job;
+		JobCounter* counter = nullptr;
+	};
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void push(Task task);
+	// own queue from the back first, then steal from the front of the others
+	bool tryGetTask(int queueIndex, Task& task);
+	void execute(Task& task);
+	void finish(JobCounter* counter);
+	void workerLoop(int queueIndex);
+
+	static JobSystem* SingleInstance;
+	// queue used by this thread, 0 on the main and other non worker threads
+	static thread_local int t_queueIndex;
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_workers;
+	std::atomic<bool> m_running{ true };
+	std::atomic<int> m_queuedTasks{ 0 };
+	// idle workers sleep here until a job is pushed
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+};
@@ -0,0 +1,218 @@
+// Tests and a parallelFor benchmark for JobSystem. It has no Win32 code, so this builds on its
+// own, outside the game project:
+//   g++ -std=c++17 -O2 -pthread JobSystem.cpp JobSystemTests.cpp -o JobSystemTests
+// add -fsanitize=thread for a ThreadSanitizer run. Usage: JobSystemTests [workers]
+// Every test runs twice: with the workers, then after shutdown with none, where every
+// job has to run on the waiting thread. Returns non-zero if a test failed
+#include "JobSystem.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	int failures = 0;
+
+	void check(bool passed, const char* test, const char* what)
+	{
+		if (passed)
+			return;
+		printf("FAILED %s: %s\n", test, what);
+		failures++;
+	}
+
+	// **** tests ****//
+
+	// every index visited once, for grain sizes that do and do not divide the range
+	void testParallelForSum(JobSystem& jobs)
+	{
+		const int count = 100000;
+		for (int grainSize : { 1, 7, 64, 1000, count, count * 2 })
+		{
+			std::vector<int> visits(count, 0);
+			std::atomic<long long> sum{ 0 };
+			jobs.parallelFor(0, count, grainSize, [&](int first, int last)
+			{
+				long long partial = 0;
+				for (int i = first; i < last; i++)
+				{
+					visits[i]++;
+					partial += i;
+				}
+				sum += partial;
+			});
+			check(sum == static_cast<long long>(count) * (count - 1) / 2, "parallelFor sum", "wrong sum");
+			bool once = true;
+			for (int visit : visits)
+				once = once && visit == 1;
+			check(once, "parallelFor sum", "an index was not visited exactly once");
+		}
+
+		// empty and offset ranges
+		int calls = 0;
+		jobs.parallelFor(5, 5, 1, [&calls](int, int) { calls++; });
+		check(calls == 0, "parallelFor sum", "an empty range ran the body");
+		std::atomic<long long> sum{ 0 };
+		jobs.parallelFor(-50, 50, 3, [&sum](int first, int last)
+		{
+			for (int i = first; i < last; i++)
+				sum += i;
+		});
+		check(sum == -50, "parallelFor sum", "wrong sum over an offset range");
+	}
+
+	// jobs that wait on jobs they queued, three levels deep, plus parallelFor inside a job
+	void spawnTree(JobSystem& jobs, int depth, std::atomic<int>& leaves)
+	{
+		if (depth == 0)
+		{
+			leaves++;
+			return;
+		}
+		JobCounter children;
+		for (int i = 0; i < 4; i++)
+			jobs.run([&jobs, depth, &leaves]() { spawnTree(jobs, depth - 1, leaves); }, &children);
+		jobs.wait(children);
+	}
+
+	void testNestedWait(JobSystem& jobs)
+	{
+		std::atomic<int> leaves{ 0 };
+		JobCounter root;
+		jobs.run([&jobs, &leaves]() { spawnTree(jobs, 3, leaves); }, &root);
+		jobs.wait(root);
+		check(leaves == 64, "nested wait", "a nested job did not run before its wait returned");
+
+		std::atomic<int> sum{ 0 };
+		JobCounter outer;
+		for (int i = 0; i < 8; i++)
+		{
+			jobs.run([&jobs, &sum]()
+			{
+				jobs.parallelFor(0, 100, 10, [&sum](int first, int last) { sum += last - first; });
+			}, &outer);
+		}
+		jobs.wait(outer);
+		check(sum == 800, "nested wait", "parallelFor inside jobs lost chunks");
+	}
+
+	// a continuation starts only once its dependency is done, chains keep their order
+	void testRunAfterOrdering(JobSystem& jobs)
+	{
+		const int count = 64;
+		std::atomic<int> done{ 0 };
+		std::atomic<int> seenByFirst{ -1 };
+		std::atomic<int> seenBySecond{ -1 };
+		std::atomic<int> order{ 0 };
+		int firstOrder = -1;
+		int secondOrder = -1;
+
+		JobCounter work;
+		JobCounter first;
+		JobCounter second;
+		for (int i = 0; i < count; i++)
+		{
+			jobs.run([&done]()
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+				done++;
+			}, &work);
+		}
+		jobs.runAfter(work, [&]() { seenByFirst = done.load(); firstOrder = order++; }, &first);
+		jobs.runAfter(first, [&]() { seenBySecond = done.load(); secondOrder = order++; }, &second);
+		jobs.wait(second);
+		check(first.isDone(), "runAfter ordering", "waiting on the chain's end left its start unfinished");
+		check(seenByFirst == count, "runAfter ordering", "a continuation started before its dependency was done");
+		check(seenBySecond == count, "runAfter ordering", "the chained continuation started early");
+		check(firstOrder == 0 && secondOrder == 1, "runAfter ordering", "the chain ran out of order");
+
+		// a dependency that is already done queues the job right away
+		bool ran = false;
+		JobCounter idle;
+		JobCounter after;
+		jobs.runAfter(idle, [&ran]() { ran = true; }, &after);
+		jobs.wait(after);
+		check(ran, "runAfter ordering", "a job after a finished counter never ran");
+	}
+
+	// without workers nothing may be left to a thread that does not exist
+	void testOnWaitingThread(JobSystem& jobs)
+	{
+		std::thread::id caller = std::this_thread::get_id();
+		std::atomic<int> elsewhere{ 0 };
+		JobCounter counter;
+		for (int i = 0; i < 16; i++)
+		{
+			jobs.run([&]()
+			{
+				if (std::this_thread::get_id() != caller)
+					elsewhere++;
+			}, &counter);
+		}
+		jobs.wait(counter);
+		jobs.parallelFor(0, 1000, 10, [&](int, int)
+		{
+			if (std::this_thread::get_id() != caller)
+				elsewhere++;
+		});
+		check(elsewhere == 0, "zero workers", "a job ran off the waiting thread");
+	}
+
+	void runTests(JobSystem& jobs)
+	{
+		testParallelForSum(jobs);
+		testNestedWait(jobs);
+		testRunAfterOrdering(jobs);
+		if (jobs.getWorkerCount() == 0)
+			testOnWaitingThread(jobs);
+	}
+
+	// **** benchmark ****//
+
+	// the same compute bound loop serially and through parallelFor
+	void benchParallelFor(JobSystem& jobs)
+	{
+		const int count = 1 << 22;
+		std::vector<float> values(count);
+		auto body = [&values](int first, int last)
+		{
+			for (int i = first; i < last; i++)
+				values[i] = sqrtf(static_cast<float>(i)) * sinf(static_cast<float>(i));
+		};
+		using Clock = std::chrono::steady_clock;
+		auto ms = [](Clock::time_point from) { return std::chrono::duration<double, std::milli>(Clock::now() - from).count(); };
+
+		Clock::time_point start = Clock::now();
+		body(0, count);
+		double serial = ms(start);
+		printf("parallelFor %d items, %d workers: serial %.2f ms\n", count, jobs.getWorkerCount(), serial);
+		for (int grainSize : { 1 << 10, 1 << 14, 1 << 18 })
+		{
+			start = Clock::now();
+			jobs.parallelFor(0, count, grainSize, body);
+			double parallel = ms(start);
+			printf("  grain %d: %.2f ms, %.2fx\n", grainSize, parallel, serial / parallel);
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	JobSystem* jobs = JobSystem::Create(argc > 1 ? atoi(argv[1]) : -1);
+	printf("%d workers\n", jobs->getWorkerCount());
+	runTests(*jobs);
+	benchParallelFor(*jobs);
+
+	// shutdown leaves no workers, the fallback every job then takes
+	jobs->shutdown();
+	printf("0 workers after shutdown\n");
+	runTests(*jobs);
+
+	printf(failures == 0 ? "all tests passed\n" : "%d checks failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -2,173 +2,445 @@
 #include "World.h"
 #define PI       3.14159265358979323846
 
-TestMap::TestMap()
+namespace
 {
-	World* myWorld = World::Get();
-	// create skybox
-	Actor* sky = new SkyBoxActor();
-	
-	m_actors["SkyBox"] = sky;
-	
-	Actor* tree = new TreeActor(5);
-	tree->setWorldPos(Vec3(-45.f, -1.5f, -35.f));
-	dynamic_cast<TreeActor*>(tree)->generateInstanceMatrices(5,Vec3(0.f,0.f,20.f));
-	m_actors["Tree"] = tree;
+	const std::string HANGAR_MESH = "Models/hangar_006.gem";
 
-	Actor* water = new WaterActor();
-	water->setWorldPos(Vec3(100.f, -10.f, 0.f));
-	m_actors["Water"] = water;
+	CellActorDesc streamedActor(const std::string& name, const Vec3& pos, std::function<Actor* (const Vec3&)> create, AssetList assets)
+	{
+		CellActorDesc desc;
+		desc.name = name;
+		desc.position = pos;
+		desc.create = std::move(create);
+		desc.assets = std::move(assets);
+		return desc;
+	}
 
-	Actor* fpsActor = new FPSActor();
-	m_actors["FPSActor"] = fpsActor;
+	CellActorDesc streamedContainer(const std::string& name, const Vec3& pos, float yaw)
+	{
+		return streamedActor(name, pos, [yaw](const Vec3& position)
+		{
+			Actor* container = new ContainerBlueActor();
+			container->setWorldPos(position);
+			container->setWorldRotation(Vec3(0.f, yaw, 0.f));
+			container->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
+			return container;
+		}, Actor::GetClassAssets("ContainerBlueActor"));
+	}
+
+	CellActorDesc streamedEnemy(const std::string& name, const Vec3& pos)
+	{
+		return streamedActor(name, pos, [](const Vec3& position)
+		{
+			Actor* enemy = new EnemyActor();
+			enemy->setWorldPos(position);
+			return enemy;
+		}, Actor::GetClassAssets("EnemyActor"));
+	}
+}
+
+// sky, water, ground and the player stay resident, everything else streams in by cell
+TestMap::TestMap(bool populate)
+{
+	if (!populate)
+		return;
+	AddResidentActors();
+
+	m_streamer.addActor(streamedActor("Tree", Vec3(-45.f, -1.5f, -35.f), [](const Vec3& position)
+	{
+		TreeActor* tree = new TreeActor(5);
+		tree->setWorldPos(position);
+		tree->generateInstanceMatrices(5, Vec3(0.f, 0.f, 20.f));
+		return tree;
+	}, Actor::GetClassAssets("TreeActor")));
 
 	/*Actor* boxActor = new BoxActor();
 	boxActor->setWorldScale(Vec3(0.02f, 0.02f, 0.02f));
 	m_actors["BoxActor"] = boxActor;*/
 
-	Actor* boxActor1 = new BoxActor();
-	boxActor1->setWorldPos(Vec3(0.f, 0.f, 0.f));
-	boxActor1->setWorldRotation(Vec3(0.f, 1.f, 0.f));
-	boxActor1->setWorldScale(Vec3(0.025f, 0.025f, 0.025f));
-	m_actors["BoxActor1"] = boxActor1;
+	m_streamer.addActor(streamedActor("BoxActor1", Vec3(0.f, 0.f, 0.f), [](const Vec3& position)
+	{
+		Actor* box = new BoxActor();
+		box->setWorldPos(position);
+		box->setWorldRotation(Vec3(0.f, 1.f, 0.f));
+		box->setWorldScale(Vec3(0.025f, 0.025f, 0.025f));
+		return box;
+	}, Actor::GetClassAssets("BoxActor")));
+
+	m_streamer.addActor(streamedActor("BoxActor2", Vec3(10.f, 0.f, 33.75f), [](const Vec3& position)
+	{
+		Actor* box = new BoxActor();
+		box->setWorldPos(position);
+		box->setWorldScale(Vec3(0.025f, 0.025f, 0.025f));
+		return box;
+	}, Actor::GetClassAssets("BoxActor")));
+
+	m_streamer.addActor(streamedActor("BoxActor3", Vec3(3.75f, 0.f, 33.75f), [](const Vec3& position)
+	{
+		Actor* box = new BoxActor();
+		box->setWorldPos(position);
+		box->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
+		return box;
+	}, Actor::GetClassAssets("BoxActor")));
+
+	m_streamer.addActor(streamedContainer("ContainerActor", Vec3(0.f, 0.f, 40.f), 0.f));
+	m_streamer.addActor(streamedContainer("ContainerActor1", Vec3(0.f, 0.f, -40.f), 0.f));
+	m_streamer.addActor(streamedContainer("containerActor2", Vec3(20.f, 0.f, 0.f), 30.f * PI / 180));
+	m_streamer.addActor(streamedContainer("containerActor3", Vec3(-20.f, 0.f, 0.f), -30.f * PI / 180));
+
+	m_streamer.addActor(streamedActor("BlockActor", Vec3(50.f, 0.f, 0.f), [](const Vec3& position)
+	{
+		Actor* block = new BlockActor();
+		block->setWorldPos(position);
+		block->setWorldScale(Vec3(0.05, 0.08, 1.f));
+		return block;
+	}, Actor::GetClassAssets("BlockActor")));
+
+	m_streamer.addActor(streamedActor("blockActor1", Vec3(-45.f, 0.f, 0.f), [](const Vec3& position)
+	{
+		Actor* block = new BlockActor();
+		block->setWorldPos(position);
+		block->setWorldScale(Vec3(0.05, 0.08, 1.f));
+		return block;
+	}, Actor::GetClassAssets("BlockActor")));
+
+	auto hangar = [](const Vec3& position)
+	{
+		GeneralMeshActor* house = new GeneralMeshActor(HANGAR_MESH);
+		house->setWorldPos(position);
+		house->setWorldScale(Vec3(0.012f, 0.02f, 0.02f));
+		house->setUseMeshCollider(true);
+		return house;
+	};
+	m_streamer.addActor(streamedActor("houseActor", Vec3(2.f, 0.f, 90.f), hangar, { { HANGAR_MESH }, {}, {} }));
+	m_streamer.addActor(streamedActor("houseActor1", Vec3(2.f, 0.f, -100.f), hangar, { { HANGAR_MESH }, {}, {} }));
+
+	m_streamer.addActor(streamedActor("ObstacleActor", Vec3(45.f, 0.f, -90.f), [](const Vec3& position)
+	{
+		ObstacleActor* obstacle = new ObstacleActor();
+		obstacle->setWorldPos(position);
+		obstacle->setWorldScale(Vec3(0.01f, 0.01f, 0.01f));
+		obstacle->setWorldRotation(Vec3(0.f, PI / 2, 0.f));
+		obstacle->generateInstanceMatrices(20, Vec3(0.f, 0.f, 10.f));
+		return obstacle;
+	}, Actor::GetClassAssets("ObstacleActor")));
+
+	m_streamer.addActor(streamedActor("ObstacleActor1", Vec3(-40.f, 0.f, -90.f), [](const Vec3& position)
+	{
+		ObstacleActor* obstacle = new ObstacleActor();
+		obstacle->setWorldPos(position);
+		obstacle->setWorldScale(Vec3(0.02f, 0.02f, 0.02f));
+		obstacle->setWorldRotation(Vec3(0.f, PI / 2, 0.f));
+		obstacle->generateInstanceMatrices(10, Vec3(0.f, 0.f, 20.f));
+		return obstacle;
+	}, Actor::GetClassAssets("ObstacleActor")));
+
+	m_streamer.addActor(streamedEnemy("duckactor", Vec3(30.f, 0.f, -30.f)));
+	m_streamer.addActor(streamedEnemy("duckactor1", Vec3(-30.f, 0.f, -30.f)));
+	m_streamer.addActor(streamedEnemy("duckactor2", Vec3(-30.f, 0.f, 40.f)));
+	m_streamer.addActor(streamedEnemy("duckactor3", Vec3(0.f, 0.f, 20.f)));
+	m_streamer.addActor(streamedEnemy("duckactor4", Vec3(10.f, 0.f, 70.f)));
+}
+
+void TestMap::AddResidentActors()
+{
+	World* myWorld = World::Get();
+	// the resident actors' files, parsed and decoded together rather than one constructor at a time
+	AssetList residentAssets;
+	for (const char* className : { "SkyBoxActor", "WaterActor", "FPSActor", "GroundActor" })
+		residentAssets.add(Actor::GetClassAssets(className));
+	AssetPrefetch prefetched;
+	AssetCache::prefetch(myWorld->GetCore(), residentAssets, prefetched);
+
+	// create skybox
+	Actor* sky = new SkyBoxActor();
+	
+	AddActor("SkyBox", sky);
 
-	Actor* boxActor2 = new BoxActor();
-	boxActor2->setWorldPos(Vec3(10.f,0.f,33.75f));
-	boxActor2->setWorldScale(Vec3(0.025f, 0.025f, 0.025f));
-	m_actors["BoxActor2"] = boxActor2;
+	Actor* water = new WaterActor();
+	water->setWorldPos(Vec3(100.f, -10.f, 0.f));
+	AddActor("Water", water);
 
-	Actor* boxActor3 = new BoxActor();
-	boxActor3->setWorldPos(Vec3(3.75f, 0.f, 33.75f));
-	boxActor3->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
-	m_actors["BoxActor3"] = boxActor3;
+	Actor* fpsActor = new FPSActor();
+	AddActor("FPSActor", fpsActor);
 
 	Actor* groundActor = new GroundActor();
-	m_actors["GroundActor"] = groundActor;
-
-	Actor* containerActor = new ContainerBlueActor();
-	containerActor->setWorldPos(Vec3(0.f, 0.f, 40.f));
-	containerActor->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
-	m_actors["ContainerActor"] = containerActor;
-
-	Actor* containerActor1 = new ContainerBlueActor();
-	containerActor1->setWorldPos(Vec3(0.f, 0.f, -40.f));
-	containerActor1->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
-	m_actors["ContainerActor1"] = containerActor1;
-
-	/*Actor* containerActor1 = new ContainerBlueActor();
-	containerActor1->setWorldPos(Vec3(0.f, 0.f, -40.f));
-	containerActor1->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
-	m_actors["ContainerActor1"] = containerActor1;*/
-
-	Actor* containerActor2 = new ContainerBlueActor();
-	containerActor2->setWorldPos(Vec3(20.f, 0.f, 0.f));
-	containerActor2->setWorldRotation(Vec3(0.f, 30.f * PI / 180, 0.f));
-	containerActor2->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
-	m_actors["containerActor2"] = containerActor2;
-
-	Actor* containerActor3 = new ContainerBlueActor();
-	containerActor3->setWorldPos(Vec3(-20.f, 0.f, 0.f));
-	containerActor3->setWorldRotation(Vec3(0.f, -30.f * PI / 180, 0.f));
-	containerActor3->setWorldScale(Vec3(0.03f, 0.03f, 0.03f));
-	m_actors["containerActor3"] = containerActor3;
-
-	Actor* blockActor = new BlockActor();
-	blockActor->setWorldPos(Vec3(50.f, 0.f, 0.f));
-	blockActor->setWorldScale(Vec3(0.05, 0.08, 1.f));
-	m_actors["BlockActor"] = blockActor;
-
-	Actor* blockActor1 = new BlockActor();
-	blockActor1->setWorldPos(Vec3(-45.f, 0.f, 0.f));
-	blockActor1->setWorldScale(Vec3(0.05, 0.08, 1.f));
-	m_actors["blockActor1"] = blockActor1;
-
-	Actor* houseActor = new GeneralMeshActor("Models/hangar_006.gem");
-	houseActor->setWorldPos(Vec3(2.f,0.f,90.f));
-	houseActor->setWorldScale(Vec3(0.012f, 0.02f, 0.02f));
-	m_actors["houseActor"] = houseActor;
-
-	Actor* houseActor1 = new GeneralMeshActor("Models/hangar_006.gem");
-	houseActor1->setWorldPos(Vec3(2.f, 0.f, -100.f));
-	houseActor1->setWorldScale(Vec3(0.012f, 0.02f, 0.02f));
-	m_actors["houseActor1"] = houseActor1;
-
-	Actor* obstacleActor = new ObstacleActor();
-	obstacleActor->setWorldPos(Vec3(45.f, 0.f, -90.f));
-	obstacleActor->setWorldScale(Vec3(0.01f, 0.01f, 0.01f));
-	obstacleActor->setWorldRotation(Vec3(0.f, PI / 2, 0.f));
-	dynamic_cast<ObstacleActor*>(obstacleActor)->generateInstanceMatrices(20, Vec3(0.f, 0.f, 10.f));
-	m_actors["ObstacleActor"] = obstacleActor;
-
-	Actor* obstacleActor1 = new ObstacleActor();
-	obstacleActor1->setWorldPos(Vec3(-40.f, 0.f, -90.f));
-	obstacleActor1->setWorldScale(Vec3(0.02f, 0.02f, 0.02f));
-	obstacleActor1->setWorldRotation(Vec3(0.f, PI / 2, 0.f));
-	dynamic_cast<ObstacleActor*>(obstacleActor1)->generateInstanceMatrices(10, Vec3(0.f, 0.f, 20.f));
-	m_actors["ObstacleActor1"] = obstacleActor1;
-
-	Actor* duckactor = new EnemyActor();
-	duckactor->setWorldPos(Vec3(30.f, 0.f, -30.f));
-	m_actors["duckactor"] = duckactor;
-
-	Actor* duckactor1 = new EnemyActor();
-	duckactor1->setWorldPos(Vec3(-30.f, 0.f, -30.f));
-	m_actors["duckactor1"] = duckactor1;
-
-	Actor* duckactor2 = new EnemyActor();
-	duckactor2->setWorldPos(Vec3(-30.f, 0.f, 40.f));
-	m_actors["duckactor2"] = duckactor2;
-
-	Actor* duckactor3 = new EnemyActor();
-	duckactor3->setWorldPos(Vec3(0.f, 0.f, 20.f));
-	m_actors["duckactor3"] = duckactor3;
-
-	Actor* duckactor4 = new EnemyActor();
-	duckactor4->setWorldPos(Vec3(10.f, 0.f, 70.f));
-	m_actors["duckactor4"] = duckactor4;
+	AddActor("GroundActor", groundActor);
 }
 
 void TestMap::draw()
 {
-	for (auto& pair : m_actors)
-	{
-		pair.second->draw();
-	}
+	RenderSystem::draw(this);
+	m_projectiles.draw();
 }
+// v2, see LevelFormat.h. The file is assembled in memory and written in one go
 bool Level::SaveLevel(const std::string& filePath) {
+	struct SavedActor {
+		ActorRecord base;
+		std::vector<unsigned char> data;
+	};
+	// grouped by class, each class gets one record size
+	std::map<std::string, std::vector<SavedActor>> classes;
+	LevelStringWriter strings;
+	auto save = [&](const Actor& actor, uint8_t flags) {
+		SavedActor saved;
+		saved.base = {};
+		saved.base.name = strings.add(actor.getName());
+		actor.SaveBaseRecord(saved.base);
+		saved.base.flags = flags;
+		saved.data.assign(actor.GetRecordDataSize(), 0);
+		actor.SaveRecordData(saved.data.data(), strings);
+		classes[actor.GetClassName()].push_back(std::move(saved));
+	};
+	// inactive actors are not part of it, streamed ones are saved with their cell
+	for (Actor* actor : m_actors) {
+		if (actor->isActive() && !m_streamer.isStreamed(actor))
+			save(*actor, 0);
+	}
+	// the cells' actors, loaded or not, go after the resident ones of their class
+	m_streamer.forEachActor(*this, [&save](Actor& actor) { save(actor, ActorRecordStreamed); });
+
+	std::vector<ActorClassEntry> classEntries;
+	std::vector<unsigned char> records;
+	for (const auto& actorClass : classes) {
+		size_t dataSize = 0;
+		for (const SavedActor& saved : actorClass.second)
+			dataSize = std::max(dataSize, saved.data.size());
+
+		ActorClassEntry entry = {};
+		entry.className = strings.add(actorClass.first);
+		entry.recordSize = static_cast<uint32_t>(alignLevelOffset(sizeof(ActorRecord) + dataSize));
+		entry.recordCount = static_cast<uint32_t>(actorClass.second.size());
+		// relative to the records chunk for now
+		entry.recordsOffset = records.size();
+		records.resize(records.size() + static_cast<size_t>(entry.recordSize) * entry.recordCount, 0);
+
+		unsigned char* record = records.data() + entry.recordsOffset;
+		for (const SavedActor& saved : actorClass.second) {
+			memcpy(record, &saved.base, sizeof(saved.base));
+			if (!saved.data.empty())
+				memcpy(record + sizeof(ActorRecord), saved.data.data(), saved.data.size());
+			record += entry.recordSize;
+		}
+		classEntries.push_back(entry);
+	}
+
+	LevelStreamingSettings streaming = m_streamer.getSettings();
+	std::vector<LevelChunk> chunks(m_streamer.hasCells() ? 4 : 3, LevelChunk{});
+	chunks[0].id = StringsChunkId;
+	chunks[0].size = strings.data().size();
+	chunks[1].id = ClassesChunkId;
+	chunks[1].count = static_cast<uint32_t>(classEntries.size());
+	chunks[1].size = classEntries.size() * sizeof(ActorClassEntry);
+	chunks[2].id = RecordsChunkId;
+	chunks[2].size = records.size();
+	if (chunks.size() > 3) {
+		chunks[3].id = StreamingChunkId;
+		chunks[3].size = sizeof(streaming);
+	}
+	uint64_t offset = sizeof(LevelFileHeader) + chunks.size() * sizeof(LevelChunk);
+	for (LevelChunk& chunk : chunks) {
+		chunk.offset = alignLevelOffset(offset);
+		offset = chunk.offset + chunk.size;
+	}
+	for (ActorClassEntry& entry : classEntries)
+		entry.recordsOffset += chunks[2].offset;
+
+	LevelFileHeader header = {};
+	memcpy(header.magic, LevelFileMagic, sizeof(header.magic));
+	header.version = LevelFileVersion;
+	header.chunkCount = static_cast<uint32_t>(chunks.size());
+	header.spawnPoint[0] = m_spawnPoint.x;
+	header.spawnPoint[1] = m_spawnPoint.y;
+	header.spawnPoint[2] = m_spawnPoint.z;
+
+	std::vector<unsigned char> image(static_cast<size_t>(offset), 0);
+	memcpy(image.data(), &header, sizeof(header));
+	memcpy(image.data() + sizeof(header), chunks.data(), chunks.size() * sizeof(LevelChunk));
+	if (!strings.data().empty())
+		memcpy(image.data() + chunks[0].offset, strings.data().data(), strings.data().size());
+	if (!classEntries.empty())
+		memcpy(image.data() + chunks[1].offset, classEntries.data(), chunks[1].size);
+	if (!records.empty())
+		memcpy(image.data() + chunks[2].offset, records.data(), records.size());
+	if (chunks.size() > 3)
+		memcpy(image.data() + chunks[3].offset, &streaming, sizeof(streaming));
+
 	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
 	if (!file.is_open()) {
 		return false;
 	}
+	file.write(reinterpret_cast<const char*>(image.data()), image.size());
+	return file.good();
+}
 
-	
+bool Level::LoadLevel(const std::string& filePath) {
+	return BeginLoadLevel(filePath) && FinishLoadLevel();
+}
 
+bool Level::BeginLoadLevel(const std::string& filePath) {
+	CancelLoadLevel();
+	std::unique_ptr<LevelLoad> load = std::make_unique<LevelLoad>();
+	load->path = filePath;
+	if (!load->file.open(filePath)) {
+		return false;
+	}
+	if (!isLevelFileV2(load->file)) {
+		// no header, an old field by field file, read as a whole at the end
+		load->file.close();
+		m_load = std::move(load);
+		return true;
+	}
+	if (!readLevelTables(load->file, load->tables)) {
+		return false;
+	}
 
-	file.write(reinterpret_cast<const char*>(&m_spawnPoint), sizeof(Vec3));
+	// everything the records will load, from the class registry and the records themselves
+	const LevelFileTables& tables = load->tables;
+	LevelStringReader strings(tables.strings, tables.stringsSize);
+	for (uint32_t c = 0; c < tables.classCount; c++) {
+		const ActorClassEntry& entry = tables.classes[c];
+		if (!tables.hasRecords(entry)) {
+			continue;
+		}
+		std::string className = strings.get(entry.className);
+		// streamed records are fetched by their cell when it comes in
+		bool resident = false;
+		const unsigned char* record = tables.records(entry);
+		for (uint32_t r = 0; r < entry.recordCount; r++, record += entry.recordSize) {
+			if (reinterpret_cast<const ActorRecord*>(record)->flags & ActorRecordStreamed) {
+				continue;
+			}
+			resident = true;
+			Actor::CollectRecordAssets(className, record + sizeof(ActorRecord), entry.recordSize - static_cast<uint32_t>(sizeof(ActorRecord)), strings, load->assets);
+		}
+		if (resident) {
+			load->assets.add(Actor::GetClassAssets(className));
+		}
+	}
 
-	int actorCount = static_cast<int>(m_actors.size());
-	file.write(reinterpret_cast<const char*>(&actorCount), sizeof(int));
+	// parsed and decoded on the workers meanwhile
+	AssetCache::prefetchAsync(World::Get()->GetCore(), load->assets, load->prefetched, load->jobs);
+	m_load = std::move(load);
+	return true;
+}
 
-	for (const auto& pair : m_actors) {
-		const std::string& actorName = pair.first;
-		Actor* actor = pair.second;
+bool Level::IsLoadLevelReady() const {
+	return m_load == nullptr || m_load->jobs.isDone();
+}
 
-		int nameLen = static_cast<int>(actorName.size());
-		file.write(reinterpret_cast<const char*>(&nameLen), sizeof(int));
-		file.write(actorName.c_str(), nameLen);
+bool Level::FinishLoadLevel() {
+	if (m_load == nullptr) {
+		return false;
+	}
+	WaitForLoadJobs();
+	bool loaded = m_load->tables.header != nullptr ? LoadLevelV2(*m_load) : LoadLevelV1(m_load->path);
+	m_load.reset();
+	return loaded;
+}
 
-		std::string className = actor->GetClassName();
-		int classLen = static_cast<int>(className.size());
-		file.write(reinterpret_cast<const char*>(&classLen), sizeof(int));
-		file.write(className.c_str(), classLen);
+void Level::CancelLoadLevel() {
+	// the jobs write into the load
+	WaitForLoadJobs();
+	m_load.reset();
+}
 
-		actor->Save(file);
+void Level::WaitForLoadJobs() {
+	JobSystem* jobs = JobSystem::Get();
+	if (m_load != nullptr && jobs != nullptr) {
+		jobs->wait(m_load->jobs);
 	}
+}
 
-	file.close();
+// records are read in place from the mapping, the only copies are into the actors and the
+// snapshots of the streamed ones
+bool Level::LoadLevelV2(const LevelLoad& load) {
+	const LevelFileTables& tables = load.tables;
+	LevelStringReader strings(tables.strings, tables.stringsSize);
+
+	m_spawnPoint = Vec3(tables.header->spawnPoint[0], tables.header->spawnPoint[1], tables.header->spawnPoint[2]);
+	ClearActors();
+	// the file's cells replace the level's own
+	m_streamer.clear();
+	if (tables.streaming != nullptr) {
+		m_streamer.configure(*tables.streaming);
+	}
+
+	// each asset uploads once before any actor asks for it, the ones already cached are shared
+	AssetCache::loadAll(World::Get()->GetCore(), load.assets);
+
+	// the streamed records' references point into it, one copy shared by all of them
+	std::shared_ptr<const std::string> stringTable;
+	for (uint32_t c = 0; c < tables.classCount; c++) {
+		const ActorClassEntry& entry = tables.classes[c];
+		if (!tables.hasRecords(entry)) {
+			continue;
+		}
+		std::string className = strings.get(entry.className);
+		const unsigned char* records = tables.records(entry);
+
+		// runs of resident records load together, streamed ones go to their cell as snapshots
+		uint32_t first = 0;
+		for (uint32_t r = 0; r <= entry.recordCount; r++) {
+			const unsigned char* record = records + static_cast<size_t>(r) * entry.recordSize;
+			bool end = r == entry.recordCount;
+			if (!end && !(reinterpret_cast<const ActorRecord*>(record)->flags & ActorRecordStreamed)) {
+				continue;
+			}
+			if (r > first && !LoadRecords(className, records + static_cast<size_t>(first) * entry.recordSize, r - first, entry.recordSize, strings)) {
+				break;
+			}
+			first = r + 1;
+			if (end) {
+				break;
+			}
+
+			if (stringTable == nullptr) {
+				stringTable = std::make_shared<const std::string>(tables.strings, tables.stringsSize);
+			}
+			std::shared_ptr<ActorSnapshot> snapshot = std::make_shared<ActorSnapshot>();
+			snapshot->className = className;
+			snapshot->record.assign(record, record + entry.recordSize);
+			snapshot->strings = stringTable;
+			m_streamer.addActor(CellActorDesc::fromSnapshot(strings.get(reinterpret_cast<const ActorRecord*>(record)->name), snapshot));
+		}
+	}
 	return true;
 }
 
-bool Level::LoadLevel(const std::string& filePath) {
+bool Level::LoadRecords(const std::string& className, const unsigned char* records, uint32_t count, uint32_t recordSize,
+	const LevelStringReader& strings) {
+	uint32_t dataSize = recordSize - static_cast<uint32_t>(sizeof(ActorRecord));
+	// classes with a schema load their data for all the records in one call
+	const Actor::RecordBulkLoader* bulkLoader = Actor::GetRecordLoader(className);
+
+	m_loadedActors.clear();
+	const unsigned char* record = records;
+	for (uint32_t r = 0; r < count; r++, record += recordSize) {
+		Actor* actor = Actor::CreateActorByClassName(className);
+		if (!actor) {
+			return false;
+		}
+		actor->LoadBaseRecord(*reinterpret_cast<const ActorRecord*>(record));
+		if (!bulkLoader) {
+			actor->LoadRecordData(record + sizeof(ActorRecord), dataSize, strings);
+		}
+		m_loadedActors.push_back(actor);
+	}
+	if (bulkLoader) {
+		(*bulkLoader)(m_loadedActors.data(), static_cast<int>(m_loadedActors.size()), records + sizeof(ActorRecord), recordSize, dataSize, strings);
+	}
+
+	record = records;
+	for (Actor* actor : m_loadedActors) {
+		AddActor(strings.get(reinterpret_cast<const ActorRecord*>(record)->name), actor);
+		record += recordSize;
+	}
+	m_loadedActors.clear();
+	return true;
+}
+
+bool Level::LoadLevelV1(const std::string& filePath) {
 	std::ifstream file(filePath, std::ios::binary);
 	if (!file.is_open()) {
 		return false;
@@ -181,10 +453,9 @@ bool Level::LoadLevel(const std::string& filePath) {
 	int actorCount;
 	file.read(reinterpret_cast<char*>(&actorCount), sizeof(int));
 
-	for (auto& pair : m_actors) {
-		delete pair.second;
-	}
-	m_actors.clear();
+	ClearActors();
+	// v1 files hold every actor, none stream
+	m_streamer.clear();
 
 	for (int i = 0; i < actorCount; ++i) {
 		int nameLen;
@@ -204,7 +475,7 @@ bool Level::LoadLevel(const std::string& filePath) {
 
 		actor->Load(file);
 
-		m_actors[actorName] = actor;
+		AddActor(actorName, actor);
 	}
 
 	file.close();
@@ -1,113 +1,310 @@
 #pragma once
 #include "iostream"
 #include "map"
+#include <unordered_map>
 #include "Actor.h"
 #include "Mesh.h"
 #include <fstream>
 #include <string>
 #include "Vec3.h"
+#include "DynamicAABBTree.h"
+#include "ContactCache.h"
+#include "ActorCommandBuffer.h"
+#include "ProjectileSystem.h"
+#include "FramePhases.h"
+#include "JobSystem.h"
+#include "TransformStore.h"
+#include "LevelStreaming.h"
+#include "LevelFormat.h"
 class Level
 {
 protected:
-	std::map<std::string, Actor*> m_actors;
+	// dense actor storage, tick, draw and gc are linear scans over it
+	SlotMap<Actor*> m_actors;
+	// optional name index, a repeated name keeps pointing at the first actor given it
+	std::unordered_map<std::string, ActorHandle> m_actorNames;
+	// collision broadphase for every collidable actor in the level, one tree per layer
+	LayeredBroadphase m_broadphase;
+	// narrowphase results kept between frames for the sliding resolver
+	ContactCache m_contactCache;
+	// spawns and destroys queued during the frame, applied in FlushCommands
+	ActorCommandBuffer m_commands;
+	std::vector<ActorCommandBuffer::Spawn> m_flushSpawns;
+	std::vector<ActorHandle> m_flushDestroys;
+	std::vector<ActorCommandBuffer::Hit> m_flushHits;
+	// actors added since the last BeginPlayInLevel
+	std::vector<ActorHandle> m_pendingBeginPlay;
+	// bullets, simulated in bulk rather than as actors
+	ProjectileSystem m_projectiles;
+	// bullet actors, for shots that need one, wait here between shots. Parked ones stay in m_actors
+	ActorPool<BulletActor> m_bulletPool;
+	// cells of actors loaded and unloaded around the view
+	LevelStreamer m_streamer;
 	Vec3 m_spawnPoint = Vec3(40.0f, 15.0f, 0.0f); // spawn point
 
+	// unlink, free and drop the actor at a dense index
+	void DestroyActorAt(int dense)
+	{
+		Actor* actor = m_actors[dense];
+		auto nameIt = m_actorNames.find(actor->getName());
+		if (nameIt != m_actorNames.end() && nameIt->second == actor->getHandle())
+			m_actorNames.erase(nameIt);
+		m_contactCache.removeActor(actor);
+		delete actor;
+		m_actors.removeDense(static_cast<uint32_t>(dense));
+	}
+
 public:
 	// construct
-	Level()
+	Level() : m_bulletPool([]() { return new BulletActor(Vec3(0.f, 0.f, 0.f), Vec3(0.f, 0.f, 1.f)); })
 	{
 		
 	}
 	~Level()
 	{
-
+		CancelLoadLevel();
+		ClearActors();
 	}
 
-	Actor* GetActor(std::string name)
+	Actor* GetActor(const std::string& name)
 	{
-		auto findIt = m_actors.find(name);
-		if (findIt == m_actors.end())
+		auto findIt = m_actorNames.find(name);
+		if (findIt == m_actorNames.end())
 		{
 			return nullptr;
 		}
-		return findIt->second;
+		return GetActor(findIt->second);
+	}
+	// nullptr once the actor has been removed
+	Actor* GetActor(ActorHandle handle)
+	{
+		Actor** actor = m_actors.get(handle);
+		return actor ? *actor : nullptr;
+	}
+	const std::vector<Actor*>& GetAllActors() const
+	{
+		return m_actors.values();
+	}
+	const LayeredBroadphase& GetBroadphase() const
+	{
+		return m_broadphase;
+	}
+	ContactCache& GetContactCache()
+	{
+		return m_contactCache;
+	}
+	// O(1), the name is only indexed if no other actor holds it
+	ActorHandle AddActor(const std::string& name, Actor* actor)
+	{
+		ActorHandle handle = AddActor(actor);
+		actor->setName(name);
+		if (!name.empty())
+			m_actorNames.emplace(name, handle);
+		return handle;
+	}
+	ActorHandle AddActor(Actor* actor)
+	{
+		ActorHandle handle = m_actors.insert(actor);
+		actor->setHandle(handle);
+		actor->setLevel(this);
+		actor->attachBroadphase(&m_broadphase);
+		m_pendingBeginPlay.push_back(handle);
+		return handle;
+	}
+	// deferred versions, safe from any thread, applied at the next FlushCommands
+	void QueueSpawn(const std::string& name, Actor* actor)
+	{
+		m_commands.spawn(name, actor);
+	}
+	void QueueDestroy(Actor* actor)
+	{
+		m_commands.destroy(actor->getHandle());
 	}
-	std::map<std::string, Actor*>& GetAllActors() 
+	void QueueProjectileHit(Actor* target, int damage)
 	{
-		return m_actors;
+		m_commands.hit(target->getHandle(), damage);
 	}
-	void AddActor(std::string name, Actor* actor)
+	void SpawnProjectile(const Vec3& pos, const Vec3& dir, float speed = 100.0f, int damage = 10)
 	{
-		// check if exist actor with same name
-		std::string realName = name;
-		int i = 0;
-		do
+		m_projectiles.spawn(pos, dir, speed, damage);
+	}
+	// fire a bullet actor from the pool. Only a pool miss allocates, the new bullet joins
+	// the level at the next FlushCommands
+	BulletActor* SpawnBullet(const Vec3& pos, const Vec3& dir, float speed = 100.0f, int damage = 10)
+	{
+		bool created = false;
+		BulletActor* bullet = m_bulletPool.acquire(created);
+		bullet->respawn(pos, dir, speed, damage, &m_bulletPool);
+		if (created)
+			QueueSpawn("", bullet);
+		return bullet;
+	}
+	ProjectileSystem& GetProjectiles()
+	{
+		return m_projectiles;
+	}
+	// sync point: hits while their targets still exist, then destroys, then spawns,
+	// which wait in the BeginPlay list
+	void FlushCommands()
+	{
+		if (m_commands.empty())
+			return;
+		m_commands.take(m_flushSpawns, m_flushDestroys, m_flushHits);
+		for (const ActorCommandBuffer::Hit& hit : m_flushHits)
 		{
-			auto findIt = m_actors.find(realName);
-			if (findIt != m_actors.end())
-			{
-				realName = name + std::to_string(i);
-				i++;
-			}
-			else
-			{
-				m_actors[realName] = actor;
-				break;
-			}
-		} while (true);
-		 
-		//m_actors[name] = actor;
+			if (Actor* target = GetActor(hit.target))
+				target->OnProjectileHit(hit.damage);
+		}
+		for (ActorHandle handle : m_flushDestroys)
+		{
+			if (m_actors.contains(handle))
+				DestroyActorAt(static_cast<int>(m_actors.denseIndex(handle)));
+		}
+		for (const ActorCommandBuffer::Spawn& spawn : m_flushSpawns)
+		{
+			AddActor(spawn.name, spawn.actor);
+		}
 	}
 	// remove single actor
 	void RemoveActor(Actor* actor)
 	{
-		auto it = std::find_if(m_actors.begin(), m_actors.end(),
-			[actor](const auto& pair) {
-				return pair.second == actor;
-			});
-		if (it != m_actors.end()) {
-			delete it->second;  
-			it->second = nullptr;
-
-			
-			m_actors.erase(it);
-
-			
+		ActorHandle handle = actor->getHandle();
+		if (m_actors.contains(handle) && *m_actors.get(handle) == actor)
+		{
+			DestroyActorAt(static_cast<int>(m_actors.denseIndex(handle)));
+		}
+	}
+	// delete every actor, queued spawns included. Queued destroys and hits go with their targets
+	void ClearActors()
+	{
+		m_commands.take(m_flushSpawns, m_flushDestroys, m_flushHits);
+		for (const ActorCommandBuffer::Spawn& spawn : m_flushSpawns)
+		{
+			delete spawn.actor;
+		}
+		m_flushSpawns.clear();
+		m_flushDestroys.clear();
+		m_flushHits.clear();
+		for (int i = m_actors.size() - 1; i >= 0; i--)
+		{
+			delete m_actors[i];
 		}
+		m_actors.clear();
+		m_actorNames.clear();
+		m_contactCache.clear();
+		m_pendingBeginPlay.clear();
+		m_projectiles.clear();
+		m_bulletPool.clear();
+		m_streamer.reset();
 	}
-	// garbage collection
+	// garbage collection, backwards so the moved-in last actor has already been checked
 	void garbageColloection()
 	{
-		
-		for (auto it = m_actors.begin(); it != m_actors.end(); ) {
-			if (it->second && it->second->getIsDestroyed()) {
-				
-				delete it->second;
-				it->second = nullptr;
-
-				
-				it = m_actors.erase(it);
-			}
-			else {
-				++it;
+		for (int i = m_actors.size() - 1; i >= 0; i--)
+		{
+			if (m_actors[i]->getIsDestroyed())
+			{
+				DestroyActorAt(i);
 			}
 		}
 	}
-	// execute begin play
+	// execute begin play on the actors added since the last call, each is visited once.
+	// Actors added from inside BeginPlay are picked up by the same call
 	void BeginPlayInLevel()
 	{
-		for (auto pair : m_actors)
+		size_t placed = 0;
+		for (size_t i = 0; i < m_pendingBeginPlay.size(); i++)
+		{
+			if (i == placed)
+				placed = PlacePendingActors(i);
+			if (Actor* actor = GetActor(m_pendingBeginPlay[i]))
+				actor->BeginPlay();
+		}
+		m_pendingBeginPlay.clear();
+	}
+	// new actors entered the broadphase with the world matrices of the last update, rebuild
+	// them and move the proxies to where the actors were put. Returns the end of the range
+	size_t PlacePendingActors(size_t first)
+	{
+		TransformStore::Get().updateWorldMatrices();
+		for (size_t i = first; i < m_pendingBeginPlay.size(); i++)
+		{
+			if (Actor* actor = GetActor(m_pendingBeginPlay[i]))
+				actor->updateBroadphase();
+		}
+		return m_pendingBeginPlay.size();
+	}
+	// once per frame before the begin plays, loads the cells near the view and drops the far ones
+	void StreamAround(const Vec3& viewPos)
+	{
+		m_streamer.update(*this, viewPos);
+	}
+	LevelStreamer& GetStreamer()
+	{
+		return m_streamer;
+	}
+	// **** frame phases ****//
+	// run fn on every active actor, on the job system when the phase allows it.
+	// The actor array must not change meanwhile, spawns and destroys are queued
+	template<typename Fn>
+	void ForEachActiveActor(FramePhase phase, Fn&& fn)
+	{
+		JobSystem* jobs = JobSystem::Get();
+		if (FramePhases::get(phase).parallelActors && jobs != nullptr)
+		{
+			jobs->parallelFor(0, m_actors.size(), ActorsPerJob, [&](int first, int last)
+			{
+				for (int i = first; i < last; i++)
+				{
+					if (m_actors[i]->isActive())
+						fn(m_actors[i]);
+				}
+			});
+			return;
+		}
+		for (int i = 0; i < m_actors.size(); i++)
 		{
-			pair.second->BeginPlay();
+			if (m_actors[i]->isActive())
+				fn(m_actors[i]);
 		}
 	}
-	// execute Tick
+	static const int ActorsPerJob = 16;
+
+	// Gameplay: actor OnTick in parallel, writes to other actors are queued
 	void TickInLevel(float dt)
 	{
-		for (auto pair : m_actors)
+		// batched rebuild of what Input moved, so jobs only resolve the transforms they change
+		TransformStore::Get().updateWorldMatrices();
+		ForEachActiveActor(FramePhase::Gameplay, [dt](Actor* actor) { actor->Tick(dt); });
+	}
+	// Physics: projectiles move against the broadphase the actors left and report their
+	// hits, then the broadphase is refit
+	void PhysicsInLevel(float dt)
+	{
+		TransformStore::Get().updateWorldMatrices();
+		m_projectiles.update(dt, m_broadphase);
+		for (const ProjectileHit& hit : m_projectiles.getHits())
 		{
-			pair.second->Tick(dt);
+			hit.actor->OnProjectileHit(hit.damage);
 		}
+		UpdateBroadphase();
+	}
+	// Animation: state machines and bone poses in parallel, straight over the animator components
+	void AnimateInLevel(float dt)
+	{
+		AnimationSystem::update(this, dt);
+	}
+	// RenderPrep: once per frame, before draw
+	void PrepareRenderInLevel(float alpha)
+	{
+		TransformStore::Get().updateWorldMatrices();
+		m_projectiles.prepareRender(alpha);
+	}
+	// refit broadphase proxies after actors moved
+	void UpdateBroadphase()
+	{
+		ColliderSystem::refit(m_broadphase);
+		m_contactCache.nextFrame();
 	}
 	virtual void draw() = 0;
 
@@ -117,8 +314,40 @@ public:
 		Vec3 GetSpawnPoint() const { return m_spawnPoint; }
 
 		
+		// writes v2, reads v2 or v1
 		virtual bool SaveLevel(const std::string& filePath);
 		virtual bool LoadLevel(const std::string& filePath);
+
+		// LoadLevel in two halves, so the file can load while another level plays.
+		// Begin maps the file and fetches the assets its actors use on the job system,
+		// Finish waits for them and replaces the actors. Main thread
+		bool BeginLoadLevel(const std::string& filePath);
+		bool IsLoadLevelReady() const;
+		bool FinishLoadLevel();
+		void CancelLoadLevel();
+
+	protected:
+		// a load between Begin and Finish
+		struct LevelLoad
+		{
+			std::string path;
+			MappedFile file;
+			// no header for v1 files
+			LevelFileTables tables;
+			AssetList assets;
+			AssetPrefetch prefetched;
+			JobCounter jobs;
+		};
+		std::unique_ptr<LevelLoad> m_load;
+		// the actors of one class between creation and AddActor, kept for its capacity
+		std::vector<Actor*> m_loadedActors;
+
+		void WaitForLoadJobs();
+		bool LoadLevelV1(const std::string& filePath);
+		bool LoadLevelV2(const LevelLoad& load);
+		// count records of a class, recordSize bytes apart, into new actors. False if the class is not registered
+		bool LoadRecords(const std::string& className, const unsigned char* records, uint32_t count, uint32_t recordSize,
+			const LevelStringReader& strings);
 };
 
 
@@ -127,8 +356,13 @@ class TestMap : public Level
 	
 
 public:
-	TestMap();
+	// populate false leaves the actors and the cells out, for a level about to be loaded from a
+	// file, which brings both
+	TestMap(bool populate = true);
 	virtual void draw() override;
 
+private:
+	void AddResidentActors();
+
 
 };
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "LevelFormat.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+LevelStringRef LevelStringWriter::add(const std::string& value)
+{
+	auto it = m_refs.find(value);
+	if (it != m_refs.end())
+		return it->second;
+
+	LevelStringRef ref;
+	ref.offset = static_cast<uint32_t>(m_data.size());
+	ref.length = static_cast<uint32_t>(value.size());
+	m_data += value;
+	m_refs[value] = ref;
+	return ref;
+}
+
+std::string LevelStringReader::get(const LevelStringRef& ref) const
+{
+	if (static_cast<uint64_t>(ref.offset) + ref.length > m_size)
+		return std::string();
+	return std::string(m_data + ref.offset, ref.length);
+}
+
+bool LevelFileTables::hasRecords(const ActorClassEntry& entry) const
+{
+	uint64_t length = static_cast<uint64_t>(entry.recordSize) * entry.recordCount;
+	return entry.recordSize >= sizeof(ActorRecord) && entry.recordSize % LevelFileAlignment == 0 &&
+		entry.recordsOffset <= size && length <= size - entry.recordsOffset;
+}
+
+bool isLevelFileV2(const MappedFile& file)
+{
+	return file.size() >= sizeof(LevelFileMagic) && memcmp(file.data(), LevelFileMagic, sizeof(LevelFileMagic)) == 0;
+}
+
+bool readLevelTables(const MappedFile& file, LevelFileTables& tables)
+{
+	const unsigned char* data = file.data();
+	uint64_t size = file.size();
+	auto inFile = [size](uint64_t offset, uint64_t length) { return offset <= size && length <= size - offset; };
+
+	if (!inFile(0, sizeof(LevelFileHeader)))
+		return false;
+	const LevelFileHeader* header = reinterpret_cast<const LevelFileHeader*>(data);
+	if (header->version != LevelFileVersion || !inFile(sizeof(LevelFileHeader), static_cast<uint64_t>(header->chunkCount) * sizeof(LevelChunk)))
+		return false;
+
+	// unknown chunks are skipped, so later versions can add some
+	const LevelChunk* chunks = reinterpret_cast<const LevelChunk*>(data + sizeof(LevelFileHeader));
+	const LevelChunk* stringsChunk = nullptr;
+	const LevelChunk* classesChunk = nullptr;
+	const LevelChunk* streamingChunk = nullptr;
+	for (uint32_t i = 0; i < header->chunkCount; i++)
+	{
+		if (!inFile(chunks[i].offset, chunks[i].size))
+			return false;
+		if (chunks[i].id == StringsChunkId)
+			stringsChunk = &chunks[i];
+		else if (chunks[i].id == ClassesChunkId)
+			classesChunk = &chunks[i];
+		else if (chunks[i].id == StreamingChunkId && chunks[i].size >= sizeof(LevelStreamingSettings))
+			streamingChunk = &chunks[i];
+	}
+	if (stringsChunk == nullptr || classesChunk == nullptr ||
+		classesChunk->size < static_cast<uint64_t>(classesChunk->count) * sizeof(ActorClassEntry))
+		return false;
+
+	tables.header = header;
+	tables.classes = reinterpret_cast<const ActorClassEntry*>(data + classesChunk->offset);
+	tables.classCount = classesChunk->count;
+	tables.strings = reinterpret_cast<const char*>(data + stringsChunk->offset);
+	tables.stringsSize = static_cast<size_t>(stringsChunk->size);
+	tables.streaming = streamingChunk != nullptr ? reinterpret_cast<const LevelStreamingSettings*>(data + streamingChunk->offset) : nullptr;
+	tables.data = data;
+	tables.size = size;
+	return true;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+
+	m_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping == NULL)
+	{
+		close();
+		return false;
+	}
+	m_data = static_cast<const unsigned char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != nullptr)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	m_fd = ::open(path.c_str(), O_RDONLY);
+	if (m_fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(m_fd, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		return false;
+	}
+	m_size = static_cast<size_t>(info.st_size);
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	m_data = static_cast<const unsigned char*>(data);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	if (m_fd >= 0)
+		::close(m_fd);
+	m_data = nullptr;
+	m_fd = -1;
+	m_size = 0;
+}
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// **** level file v2 ****//
+// Header, chunk table, then the chunks, each 16 byte aligned:
+//   Strings  every name, class name and path, referenced by offset and length
+//   Classes  one ActorClassEntry per actor class
+//   Records  per class, a packed array of fixed size records: ActorRecord, then the
+//            class's own data, padded to 16 bytes
+//   Streaming  optional, the level streams by cell. Its records flagged ActorRecordStreamed
+//            are handed to their cell instead of being created with the level
+// Offsets are from the start of the file, so a mapped file is read in place.
+// v1 files have no header and start with the spawn point
+
+constexpr uint32_t makeChunkId(char a, char b, char c, char d)
+{
+	return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+const char LevelFileMagic[4] = { 'L', 'V', 'L', '2' };
+const uint32_t LevelFileVersion = 2;
+const uint32_t LevelFileAlignment = 16;
+const uint32_t StringsChunkId = makeChunkId('S', 'T', 'R', 'S');
+const uint32_t ClassesChunkId = makeChunkId('C', 'L', 'S', 'S');
+const uint32_t RecordsChunkId = makeChunkId('R', 'E', 'C', 'S');
+const uint32_t StreamingChunkId = makeChunkId('S', 'T', 'R', 'M');
+
+inline uint64_t alignLevelOffset(uint64_t offset)
+{
+	return (offset + LevelFileAlignment - 1) & ~static_cast<uint64_t>(LevelFileAlignment - 1);
+}
+
+struct LevelStringRef
+{
+	uint32_t offset = 0;
+	uint32_t length = 0;
+};
+
+struct LevelFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t chunkCount;
+	uint32_t reserved;
+	float spawnPoint[3];
+	uint32_t reserved2;
+};
+
+struct LevelChunk
+{
+	uint32_t id;
+	uint32_t count;		// entries in the chunk, 0 where it means nothing
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct ActorClassEntry
+{
+	LevelStringRef className;
+	uint32_t recordSize;
+	uint32_t recordCount;
+	uint64_t recordsOffset;
+};
+
+// what SaveBase writes in v1, as one fixed record
+struct ActorRecord
+{
+	LevelStringRef name;
+	int32_t actorType;
+	int32_t collisionShapeType;
+	float position[3];
+	float rotation[3];
+	float scale[3];
+	uint8_t collidable;
+	uint8_t destroyed;
+	uint8_t flags;
+	uint8_t reserved;
+};
+
+// ActorRecord::flags
+const uint8_t ActorRecordStreamed = 1;
+
+// the LevelStreamer settings of a streaming level
+struct LevelStreamingSettings
+{
+	float cellSize;
+	float loadRadius;
+	float unloadMargin;
+	float uploadBudgetMs;
+};
+
+static_assert(sizeof(LevelFileHeader) % 16 == 0, "header keeps the chunk table aligned");
+static_assert(sizeof(LevelChunk) == 24, "chunk table layout");
+static_assert(sizeof(ActorClassEntry) == 24, "class table layout");
+static_assert(sizeof(ActorRecord) == 56, "record layout");
+static_assert(sizeof(LevelStreamingSettings) == 16, "streaming chunk layout");
+
+// builds the string table, each distinct string is stored once
+class LevelStringWriter
+{
+public:
+	LevelStringRef add(const std::string& value);
+	const std::string& data() const { return m_data; }
+
+private:
+	std::string m_data;
+	std::map<std::string, LevelStringRef> m_refs;
+};
+
+// the string table inside a loaded file, out of range references read as empty
+class LevelStringReader
+{
+public:
+	LevelStringReader(const char* data, size_t size) : m_data(data), m_size(size) {}
+	std::string get(const LevelStringRef& ref) const;
+
+private:
+	const char* m_data;
+	size_t m_size;
+};
+
+// the tables of a mapped v2 file, checked against its size by readLevelTables
+struct LevelFileTables
+{
+	const LevelFileHeader* header = nullptr;
+	const ActorClassEntry* classes = nullptr;
+	uint32_t classCount = 0;
+	const char* strings = nullptr;
+	size_t stringsSize = 0;
+	// nullptr for levels that do not stream
+	const LevelStreamingSettings* streaming = nullptr;
+	const unsigned char* data = nullptr;
+	uint64_t size = 0;
+
+	// the class's records lie in the file and are laid out as the format says, others are skipped
+	bool hasRecords(const ActorClassEntry& entry) const;
+	const unsigned char* records(const ActorClassEntry& entry) const { return data + entry.recordsOffset; }
+};
+
+// a read-only file mapped into memory in one go
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const unsigned char* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
+
+// true if the mapping is a v2 file
+bool isLevelFileV2(const MappedFile& file);
+// false if the header or a table runs out of the file, unknown chunks are skipped
+bool readLevelTables(const MappedFile& file, LevelFileTables& tables);
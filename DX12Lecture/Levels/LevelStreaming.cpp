@@ -0,0 +1,354 @@
+#include "LevelStreaming.h"
+#include "Level.h"
+#include "World.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+
+std::shared_ptr<const ActorSnapshot> ActorSnapshot::capture(const Actor& actor)
+{
+	std::shared_ptr<ActorSnapshot> snapshot = std::make_shared<ActorSnapshot>();
+	snapshot->className = actor.GetClassName();
+	snapshot->record.assign(sizeof(ActorRecord) + actor.GetRecordDataSize(), 0);
+
+	LevelStringWriter strings;
+	ActorRecord base = {};
+	base.name = strings.add(actor.getName());
+	actor.SaveBaseRecord(base);
+	memcpy(snapshot->record.data(), &base, sizeof(base));
+	actor.SaveRecordData(snapshot->record.data() + sizeof(ActorRecord), strings);
+	snapshot->strings = std::make_shared<const std::string>(strings.data());
+	return snapshot;
+}
+
+Actor* ActorSnapshot::create() const
+{
+	Actor* actor = Actor::CreateActorByClassName(className);
+	if (actor == nullptr)
+		return nullptr;
+	LevelStringReader reader(strings->data(), strings->size());
+	ActorRecord base;
+	memcpy(&base, record.data(), sizeof(base));
+	actor->setName(reader.get(base.name));
+	actor->LoadBaseRecord(base);
+	actor->LoadRecordData(record.data() + sizeof(ActorRecord), static_cast<uint32_t>(record.size() - sizeof(ActorRecord)), reader);
+	return actor;
+}
+
+AssetList ActorSnapshot::getAssets() const
+{
+	AssetList assets = Actor::GetClassAssets(className);
+	LevelStringReader reader(strings->data(), strings->size());
+	Actor::CollectRecordAssets(className, record.data() + sizeof(ActorRecord), static_cast<uint32_t>(record.size() - sizeof(ActorRecord)),
+		reader, assets);
+	return assets;
+}
+
+CellActorDesc CellActorDesc::fromSnapshot(const std::string& name, std::shared_ptr<const ActorSnapshot> snapshot)
+{
+	ActorRecord base;
+	memcpy(&base, snapshot->record.data(), sizeof(base));
+
+	CellActorDesc desc;
+	desc.name = name;
+	desc.position = Vec3(base.position[0], base.position[1], base.position[2]);
+	desc.assets = snapshot->getAssets();
+	// the record puts the actor back where it was, the position only picks the cell
+	desc.create = [snapshot](const Vec3&) { return snapshot->create(); };
+	return desc;
+}
+
+LevelStreamer::~LevelStreamer()
+{
+	// the fetch jobs write into the cells
+	waitForJobs();
+}
+
+void LevelStreamer::addActor(CellActorDesc desc)
+{
+	CellKey key = cellOf(desc.position);
+	StreamingCell& cell = m_cells[key];
+	cell.x = key.first;
+	cell.z = key.second;
+
+	cell.manifest.assets.add(desc.assets);
+	// a cell that is already in picks the actor up the next time it loads
+	cell.manifest.actors.push_back(std::move(desc));
+}
+
+void LevelStreamer::update(Level& level, const Vec3& viewPos)
+{
+	Core* core = World::Get()->GetCore();
+	// meshes of cells unloaded a few frames ago, once the GPU has finished drawing them
+	AssetCache::releaseRetired(core);
+	if (m_cells.empty())
+		return;
+	if (!m_primed)
+	{
+		loadAround(level, viewPos);
+		return;
+	}
+
+	float unloadRadius = m_loadRadius + m_unloadMargin;
+	bool unloaded = false;
+	for (auto& entry : m_cells)
+	{
+		StreamingCell& cell = entry.second;
+		float distance = distanceTo(cell, viewPos);
+		switch (cell.state)
+		{
+		case CellState::Unloaded:
+			if (distance <= m_loadRadius)
+				startLoading(cell);
+			break;
+		case CellState::Loading:
+			// fetch jobs cannot be cancelled, a cell left behind meanwhile is dropped once they finish
+			if (cell.jobs->isDone())
+			{
+				if (distance <= unloadRadius)
+				{
+					cell.state = CellState::Uploading;
+				}
+				else
+				{
+					cell.prefetched->clear();
+					cell.state = CellState::Unloaded;
+				}
+			}
+			break;
+		case CellState::Uploading:
+		case CellState::Loaded:
+			if (distance > unloadRadius)
+			{
+				unload(level, cell);
+				unloaded = true;
+			}
+			break;
+		}
+	}
+	// meshes only the unloaded cells used. Frames in flight may still draw them, so they
+	// are released later rather than flushing the queue now
+	if (unloaded)
+		AssetCache::retireUnused(core);
+
+	// creating an actor uploads its meshes, spread that over frames. At least one actor
+	// goes in per frame, so a slow one cannot stall streaming
+	auto start = std::chrono::steady_clock::now();
+	for (auto& entry : m_cells)
+	{
+		StreamingCell& cell = entry.second;
+		while (cell.state == CellState::Uploading)
+		{
+			uploadNext(level, cell);
+			std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed.count() >= m_uploadBudgetMs)
+				return;
+		}
+	}
+}
+
+void LevelStreamer::loadAround(Level& level, const Vec3& viewPos)
+{
+	for (auto& entry : m_cells)
+	{
+		StreamingCell& cell = entry.second;
+		if (cell.state == CellState::Unloaded && distanceTo(cell, viewPos) <= m_loadRadius)
+			startLoading(cell);
+	}
+	waitForJobs();
+	for (auto& entry : m_cells)
+	{
+		StreamingCell& cell = entry.second;
+		if (cell.state == CellState::Loading)
+			cell.state = CellState::Uploading;
+		while (uploadNext(level, cell))
+		{
+		}
+	}
+	m_primed = true;
+}
+
+void LevelStreamer::reset()
+{
+	for (auto& entry : m_cells)
+	{
+		StreamingCell& cell = entry.second;
+		if (cell.state == CellState::Uploading || cell.state == CellState::Loaded)
+		{
+			cell.actors.clear();
+			cell.prefetched->clear();
+			cell.nextActor = 0;
+			cell.state = CellState::Unloaded;
+		}
+	}
+	m_primed = false;
+}
+
+void LevelStreamer::clear()
+{
+	waitForJobs();
+	m_cells.clear();
+	m_primed = false;
+}
+
+void LevelStreamer::configure(const LevelStreamingSettings& settings)
+{
+	if (!m_cells.empty())
+		return;
+	m_cellSize = settings.cellSize;
+	m_loadRadius = settings.loadRadius;
+	m_unloadMargin = settings.unloadMargin;
+	m_uploadBudgetMs = settings.uploadBudgetMs;
+}
+
+LevelStreamingSettings LevelStreamer::getSettings() const
+{
+	return { m_cellSize, m_loadRadius, m_unloadMargin, m_uploadBudgetMs };
+}
+
+void LevelStreamer::forEachActor(Level& level, const std::function<void(Actor& actor)>& fn) const
+{
+	for (const auto& entry : m_cells)
+	{
+		const StreamingCell& cell = entry.second;
+		for (int i = 0; i < static_cast<int>(cell.manifest.actors.size()); i++)
+		{
+			if (i < cell.nextActor)
+			{
+				// killed or destroyed ones are left out, as unload would drop them
+				Actor* actor = level.GetActor(cell.actors[i]);
+				if (actor != nullptr && !actor->getIsDestroyed())
+					fn(*actor);
+				continue;
+			}
+			const CellActorDesc& desc = cell.manifest.actors[i];
+			Actor* actor = desc.create(desc.position);
+			if (actor == nullptr)
+				continue;
+			actor->setName(desc.name);
+			fn(*actor);
+			delete actor;
+		}
+	}
+}
+
+bool LevelStreamer::isStreamed(const Actor* actor) const
+{
+	SlotHandle handle = actor->getHandle();
+	for (const auto& entry : m_cells)
+	{
+		const StreamingCell& cell = entry.second;
+		for (int i = 0; i < cell.nextActor; i++)
+		{
+			if (cell.actors[i] == handle)
+				return true;
+		}
+	}
+	return false;
+}
+
+int LevelStreamer::getCellCount(CellState state) const
+{
+	int count = 0;
+	for (const auto& entry : m_cells)
+	{
+		if (entry.second.state == state)
+			count++;
+	}
+	return count;
+}
+
+LevelStreamer::CellKey LevelStreamer::cellOf(const Vec3& pos) const
+{
+	return { static_cast<int>(floorf(pos.x / m_cellSize)), static_cast<int>(floorf(pos.z / m_cellSize)) };
+}
+
+float LevelStreamer::distanceTo(const StreamingCell& cell, const Vec3& pos) const
+{
+	float minX = cell.x * m_cellSize;
+	float minZ = cell.z * m_cellSize;
+	float dx = std::max({ minX - pos.x, 0.0f, pos.x - (minX + m_cellSize) });
+	float dz = std::max({ minZ - pos.z, 0.0f, pos.z - (minZ + m_cellSize) });
+	return sqrtf(dx * dx + dz * dz);
+}
+
+void LevelStreamer::startLoading(StreamingCell& cell)
+{
+	cell.state = CellState::Loading;
+
+	// assets another cell already brought in are skipped
+	AssetCache::prefetchAsync(World::Get()->GetCore(), cell.manifest.assets, *cell.prefetched, *cell.jobs);
+}
+
+bool LevelStreamer::uploadNext(Level& level, StreamingCell& cell)
+{
+	if (cell.state != CellState::Uploading)
+		return false;
+	int count = static_cast<int>(cell.manifest.actors.size());
+	if (cell.nextActor >= count)
+	{
+		finishUpload(cell);
+		return false;
+	}
+
+	cell.actors.resize(count);
+	int index = cell.nextActor++;
+	const CellActorDesc& desc = cell.manifest.actors[index];
+	Actor* actor = desc.create(desc.position);
+	cell.actors[index] = level.AddActor(desc.name, actor);
+
+	if (cell.nextActor >= count)
+	{
+		finishUpload(cell);
+		return false;
+	}
+	return true;
+}
+
+void LevelStreamer::finishUpload(StreamingCell& cell)
+{
+	// every asset is built, the parsed files are no longer needed
+	cell.prefetched->clear();
+	cell.state = CellState::Loaded;
+}
+
+void LevelStreamer::unload(Level& level, StreamingCell& cell)
+{
+	std::vector<CellActorDesc> kept;
+	for (int i = 0; i < static_cast<int>(cell.manifest.actors.size()); i++)
+	{
+		if (i < cell.nextActor)
+		{
+			// killed or destroyed actors do not come back with the cell
+			Actor* actor = level.GetActor(cell.actors[i]);
+			bool gone = actor == nullptr || actor->getIsDestroyed();
+			// the others come back as they are now, not as the cell first made them
+			if (!gone)
+				kept.push_back(CellActorDesc::fromSnapshot(cell.manifest.actors[i].name, ActorSnapshot::capture(*actor)));
+			if (actor != nullptr)
+				level.RemoveActor(actor);
+			continue;
+		}
+		kept.push_back(std::move(cell.manifest.actors[i]));
+	}
+	cell.manifest.actors = std::move(kept);
+	cell.actors.clear();
+	cell.prefetched->clear();
+	cell.nextActor = 0;
+	cell.state = CellState::Unloaded;
+}
+
+void LevelStreamer::waitForJobs()
+{
+	JobSystem* jobs = JobSystem::Get();
+	if (jobs == nullptr)
+		return;
+	for (auto& entry : m_cells)
+	{
+		if (entry.second.state == CellState::Loading)
+			jobs->wait(*entry.second.jobs);
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Vec3.h"
+#include "SlotMap.h"
+#include "JobSystem.h"
+#include "AssetCache.h"
+#include "LevelFormat.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Actor;
+class Level;
+
+// An actor kept as its v2 record, with the string table its references point into. How a cell
+// holds the actors it read from a file or unloaded, so their state comes back with the cell
+struct ActorSnapshot
+{
+	std::string className;
+	// ActorRecord, then the class data
+	std::vector<unsigned char> record;
+	std::shared_ptr<const std::string> strings;
+
+	static std::shared_ptr<const ActorSnapshot> capture(const Actor& actor);
+	// nullptr if the class is not registered
+	Actor* create() const;
+	// the files the actor loads
+	AssetList getAssets() const;
+};
+
+// one actor of a streaming cell, built on the main thread when the cell comes in
+struct CellActorDesc
+{
+	std::string name;
+	Vec3 position;
+	// builds the actor at the position, set before anything that depends on it
+	std::function<Actor* (const Vec3& position)> create;
+	// files its constructor loads, fetched on the workers before create runs
+	AssetList assets;
+
+	// a description that rebuilds the snapshot, position is where the record puts the actor
+	static CellActorDesc fromSnapshot(const std::string& name, std::shared_ptr<const ActorSnapshot> snapshot);
+};
+
+// what a cell needs to come in: the files to fetch off the main thread, then the actors
+struct CellManifest
+{
+	AssetList assets;
+	std::vector<CellActorDesc> actors;
+};
+
+enum class CellState
+{
+	Unloaded,
+	Loading,	// fetch jobs in flight
+	Uploading,	// fetched, actors created a few per frame within the upload budget
+	Loaded
+};
+
+struct StreamingCell
+{
+	int x = 0;
+	int z = 0;
+	CellManifest manifest;
+	CellState state = CellState::Unloaded;
+
+	// the fetch jobs and what they brought in, both stay put while jobs run
+	std::unique_ptr<JobCounter> jobs = std::make_unique<JobCounter>();
+	std::unique_ptr<AssetPrefetch> prefetched = std::make_unique<AssetPrefetch>();
+	// handle of each manifest actor once created, invalid before
+	std::vector<SlotHandle> actors;
+	int nextActor = 0;
+};
+
+// Splits a level into a grid of square cells on the XZ plane. Cells within loadRadius of the
+// view are fetched on the job system and then instantiated within a per-frame time budget,
+// cells further than loadRadius + unloadMargin are removed, the margin keeps a cell on the
+// boundary from flipping in and out. Actors added straight to the level are not streamed.
+// Main thread only, outside the frame phases
+class LevelStreamer
+{
+public:
+	LevelStreamer(float cellSize = 50.0f, float loadRadius = 80.0f, float unloadMargin = 30.0f, float uploadBudgetMs = 2.0f)
+		: m_cellSize(cellSize), m_loadRadius(loadRadius), m_unloadMargin(unloadMargin), m_uploadBudgetMs(uploadBudgetMs)
+	{
+	}
+	LevelStreamer(const LevelStreamer&) = delete;
+	LevelStreamer& operator=(const LevelStreamer&) = delete;
+	~LevelStreamer();
+
+	// put the actor in the manifest of the cell its position falls in
+	void addActor(CellActorDesc desc);
+
+	// once per frame. The first call after a reset loads the cells around the view
+	// synchronously, so the level does not start empty
+	void update(Level& level, const Vec3& viewPos);
+	// start, wait for and instantiate every cell in range
+	void loadAround(Level& level, const Vec3& viewPos);
+	// the level deleted its actors, every cell goes back to unloaded
+	void reset();
+	// drop every cell, for levels that stop streaming
+	void clear();
+	// new settings, only while there are no cells
+	void configure(const LevelStreamingSettings& settings);
+	LevelStreamingSettings getSettings() const;
+
+	// Every actor of the cells, the created ones as they are and the others built from their
+	// description for the call and deleted after it. For saving, it can load assets
+	void forEachActor(Level& level, const std::function<void(Actor& actor)>& fn) const;
+
+	// true if the actor was created by a loaded cell. Those are saved with their cell, not the level
+	bool isStreamed(const Actor* actor) const;
+	bool hasCells() const { return !m_cells.empty(); }
+
+	int getCellCount() const { return static_cast<int>(m_cells.size()); }
+	int getCellCount(CellState state) const;
+	float getCellSize() const { return m_cellSize; }
+
+private:
+	using CellKey = std::pair<int, int>;
+
+	CellKey cellOf(const Vec3& pos) const;
+	// distance on XZ from the point to the nearest edge of the cell, 0 inside it
+	float distanceTo(const StreamingCell& cell, const Vec3& pos) const;
+
+	void startLoading(StreamingCell& cell);
+	// create the next actor of the cell, false once all are in
+	bool uploadNext(Level& level, StreamingCell& cell);
+	void finishUpload(StreamingCell& cell);
+	// remove the cell's actors, the ones already gone are dropped from the manifest for good and
+	// the others come back as they were
+	void unload(Level& level, StreamingCell& cell);
+	void waitForJobs();
+
+	std::map<CellKey, StreamingCell> m_cells;
+	float m_cellSize;
+	float m_loadRadius;
+	float m_unloadMargin;
+	float m_uploadBudgetMs;
+	bool m_primed = false;
+};
@@ -2,12 +2,19 @@
 #include "GEMLoader.h"
 #include "TextureManager.h"
 #include "World.h"
+#include "AssetCache.h"
 #include "StringUtils.h"
 #include "Animation/FPSAnimationStateMachine.h"
 void Mesh::init(Core* core, void* vertices, int vertexSizeInBytes, int numVertices,
 	unsigned int* indices, int numIndices)
 
 {
+	numMeshIndices = numIndices;
+	// no device, the CPU copies kept by the typed overloads are all there is
+	if (core->isHeadless())
+		return;
+
+#ifdef _WIN32
 	D3D12_HEAP_PROPERTIES heapprops = {};
 	heapprops.Type = D3D12_HEAP_TYPE_DEFAULT;
 	heapprops.CreationNodeMask = 1;
@@ -57,26 +64,30 @@ D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
 	ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
 	ibView.Format = DXGI_FORMAT_R32_UINT;
 	ibView.SizeInBytes = numIndices * sizeof(unsigned int);
-	numMeshIndices = numIndices;
+#endif
 
 
 }
 
 void Mesh::draw(Core* core)
 {
+#ifdef _WIN32
 	core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
 	core->getCommandList()->IASetIndexBuffer(&ibView);
 	core->getCommandList()->DrawIndexedInstanced(numMeshIndices, 1, 0, 0, 0);
+#endif
 
 }
 
 void Mesh::drawInstanced(Core* core, int instanceCount)
 {
+#ifdef _WIN32
 	core->getCommandList()->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	core->getCommandList()->IASetVertexBuffers(0, 1, &vbView);
 	core->getCommandList()->IASetIndexBuffer(&ibView);
 	core->getCommandList()->DrawIndexedInstanced(numMeshIndices, instanceCount, 0, 0, 0);
+#endif
 }
 
 void Mesh::CreatePlane(Core* core, Mesh* plane)
@@ -214,12 +225,31 @@ StaticMesh::StaticMesh(Core* core, std::string filename)
 }
 
 void StaticMesh::CreateFromGEM(Core* core, std::string filename)
+{
+	m_asset = AssetCache::getStaticMesh(core, filename);
+}
+
+void StaticMesh::CreateFromSphere(Core* core, int rings, int segments, float radius, std::string skyPath)
+{
+	m_asset = AssetCache::getSphere(core, rings, segments, radius, skyPath);
+}
+
+void StaticMesh::CreateFromPlane(Core* core, float sizeX, float sizeZ, int xSegments, int zSegments, std::string texName, std::string nhName)
+{
+	m_asset = AssetCache::getPlane(core, sizeX, sizeZ, xSegments, zSegments, texName, nhName);
+}
+
+void StaticMeshAsset::CreateFromGEM(Core* core, std::string filename)
 {
 	GEMLoader::GEMModelLoader loader;
-	std::vector<GEMLoader::GEMMesh> gemmeshes;
+	std::vector<GEMLoader::GEMMesh> loadedMeshes;
 	TextureManager* texMgr = TextureManager::Get();
 
-	loader.load(filename, gemmeshes);
+	// a streamed cell may have parsed the file on a worker already
+	std::shared_ptr<GEMFileData> prefetched = AssetCache::findPrefetched(filename);
+	if (!prefetched)
+		loader.load(filename, loadedMeshes);
+	std::vector<GEMLoader::GEMMesh>& gemmeshes = prefetched ? prefetched->meshes : loadedMeshes;
 	for (int i = 0; i < gemmeshes.size(); i++) {
 		Mesh mesh;
 		std::vector<STATIC_VERTEX> vertices;
@@ -256,7 +286,7 @@ void StaticMesh::draw(Core* core, PSOManager* psos, std::string pipeName, Pipeli
 	// StaticMeshBuffer
 	if (isStatic && !isInstance)
 	{
-		Pipelines::updateBaseStaticBuffer(pipeName, pipes, m_worldPosMat);
+		Pipelines::updateBaseStaticBuffer(pipeName, pipes, GetRenderMatrix());
 	}
 
 	// Instance buffer
@@ -307,7 +337,7 @@ StaticMesh::StaticMesh()
 {
 }
 
-void StaticMesh::CreateFromPlane(Core* core, float sizeX, float sizeZ, int xSegments, int zSegments, std::string texName, std::string nhName)
+void StaticMeshAsset::CreateFromPlane(Core* core, float sizeX, float sizeZ, int xSegments, int zSegments, std::string texName, std::string nhName)
 {
 	std::vector<STATIC_VERTEX> vertices;
 	std::vector<unsigned int> indices;
@@ -369,7 +399,7 @@ void StaticMesh::CreateFromPlane(Core* core, float sizeX, float sizeZ, int xSegm
 void StaticMesh::drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, const std::string& pipeName, int instanceCount)
 {
 	TextureManager* texs = TextureManager::Get();
-	for (int i = 0; i < meshes.size(); i++)
+	for (int i = 0; i < m_asset->meshes.size(); i++)
 	{
 		core->beginRenderPass();
 
@@ -377,15 +407,15 @@ void StaticMesh::drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, cons
 		
 		std::map<std::string, int> textureHeapOffsets;
 		// Albedo tex (t0)
-		if (i<textureFilenames.size())
+		if (i < m_asset->textureFilenames.size())
 		{
-			textureHeapOffsets["tex"] = texs->textures[textureFilenames[i]]->heapOffset;
+			textureHeapOffsets["tex"] = texs->textures[m_asset->textureFilenames[i]]->heapOffset;
 		}
 		
 		// normal text1
-		if (i<normalTextureFilenames.size())
+		if (i < m_asset->normalTextureFilenames.size())
 		{
-			textureHeapOffsets["normalTex"] = texs->textures[normalTextureFilenames[i]]->heapOffset;
+			textureHeapOffsets["normalTex"] = texs->textures[m_asset->normalTextureFilenames[i]]->heapOffset;
 		}
 		
 		
@@ -396,16 +426,16 @@ void StaticMesh::drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, cons
 		// draw
 		if (instanceCount > 1)
 		{
-			meshes[i].drawInstanced(core, instanceCount);
+			m_asset->meshes[i].drawInstanced(core, instanceCount);
 		}
 		else
 		{
-			meshes[i].draw(core);
+			m_asset->meshes[i].draw(core);
 		}
 	}
 }
 
-void StaticMesh::CreateFromSphere(Core* core, int rings, int segments, float radius, std::string skyPath)
+void StaticMeshAsset::CreateFromSphere(Core* core, int rings, int segments, float radius, std::string skyPath)
 {
 	// create sphere's vertices and indices
 	Mesh sphere;
@@ -452,6 +482,13 @@ void StaticMesh::CreateFromSphere(Core* core, int rings, int segments, float rad
 }
 
 
+void StaticMeshAsset::release()
+{
+	for (Mesh& mesh : meshes)
+		mesh.release();
+	meshes.clear();
+}
+
 GeneralMatrix* GeneralMatrix::SingleInstance = nullptr;
 
 AnimatedModel::AnimatedModel(Core* core, std::string filename)
@@ -460,13 +497,22 @@ AnimatedModel::AnimatedModel(Core* core, std::string filename)
 }
 
 void AnimatedModel::CreateFromGEM(Core* core, std::string filename)
+{
+	m_asset = AssetCache::getAnimatedModel(core, filename);
+}
+
+void AnimatedModelAsset::CreateFromGEM(Core* core, std::string filename)
 {
 	GEMLoader::GEMModelLoader loader;
-	std::vector<GEMLoader::GEMMesh> gemmeshes;
-	GEMLoader::GEMAnimation gemanimation;
+	std::vector<GEMLoader::GEMMesh> loadedMeshes;
+	GEMLoader::GEMAnimation loadedAnimation;
 	TextureManager* texMgr = TextureManager::Get();
 
-	loader.load(filename, gemmeshes, gemanimation);
+	std::shared_ptr<GEMFileData> prefetched = AssetCache::findPrefetched(filename);
+	if (!prefetched)
+		loader.load(filename, loadedMeshes, loadedAnimation);
+	std::vector<GEMLoader::GEMMesh>& gemmeshes = prefetched ? prefetched->meshes : loadedMeshes;
+	GEMLoader::GEMAnimation& gemanimation = prefetched ? prefetched->animation : loadedAnimation;
 	for (int i = 0; i < gemmeshes.size(); i++)
 	{
 		Mesh* mesh = new Mesh();
@@ -523,6 +569,17 @@ void AnimatedModel::CreateFromGEM(Core* core, std::string filename)
 		animation.animations.insert({ name, aseq });
 	}
 }
+
+void AnimatedModelAsset::release()
+{
+	for (Mesh* mesh : meshes)
+	{
+		mesh->release();
+		delete mesh;
+	}
+	meshes.clear();
+}
+
 void AnimatedModel::draw(Core* core, PSOManager* psos, std::string pipeName, Pipelines* pipes,
 	AnimationInstance* instance, const std::string& animName, float dt, int instanceCount)
 {
@@ -552,6 +609,7 @@ void AnimatedModel::draw(Core* core, PSOManager* psos, std::string pipeName, Pip
 
 	// **** Carry out the Buffer update strategy based on the key words ****
 	GeneralMatrix* gm = GeneralMatrix::Get();
+	Matrix renderMat = GetRenderMatrix();
 	bool isStatic = hasKeyword(pipeName, "Static", { "StaticMesh" });
 	bool isAnim = hasKeyword(pipeName, "Animation", { "Anim" });
 	bool isLight = hasKeyword(pipeName, "Light");
@@ -562,7 +620,7 @@ void AnimatedModel::draw(Core* core, PSOManager* psos, std::string pipeName, Pip
 	if (isStatic && !isInstance)
 	{
 		Pipelines::updateConstantBuffer(pipes->pipelines[pipeName].vsConstantBuffers,
-			"staticMeshBuffer", "W", &m_worldPosMat);
+			"staticMeshBuffer", "W", &renderMat);
 		Pipelines::updateConstantBuffer(pipes->pipelines[pipeName].vsConstantBuffers,
 			"staticMeshBuffer", "VP", &gm->viewProjMatrix);
 	}
@@ -571,7 +629,7 @@ void AnimatedModel::draw(Core* core, PSOManager* psos, std::string pipeName, Pip
 	if (isAnim && instance != nullptr)
 	{
 		Pipelines::updateConstantBuffer(pipes->pipelines[pipeName].vsConstantBuffers,
-			"staticMeshBuffer", "W", &m_worldPosMat);
+			"staticMeshBuffer", "W", &renderMat);
 		Pipelines::updateConstantBuffer(pipes->pipelines[pipeName].vsConstantBuffers,
 			"staticMeshBuffer", "VP", &gm->viewProjMatrix);
 		Pipelines::updateConstantBuffer(pipes->pipelines[pipeName].vsConstantBuffers,
@@ -611,7 +669,7 @@ void AnimatedModel::drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, c
 	TextureManager* texs = TextureManager::Get();
 	World* myWorld = World::Get();
 
-	for (int i = 0; i < meshes.size(); i++)
+	for (int i = 0; i < m_asset->meshes.size(); i++)
 	{
 		core->beginRenderPass();
 
@@ -619,15 +677,15 @@ void AnimatedModel::drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, c
 		std::map<std::string, int> textureHeapOffsets;
 
 		// Albedo tex
-		if (i < textureFilenames.size() && !textureFilenames[i].empty())
+		if (i < m_asset->textureFilenames.size() && !m_asset->textureFilenames[i].empty())
 		{
-			textureHeapOffsets["tex"] = texs->textures[textureFilenames[i]]->heapOffset;
+			textureHeapOffsets["tex"] = texs->textures[m_asset->textureFilenames[i]]->heapOffset;
 		}
 
 		// normalTex
-		if (i < normalTextureFilenames.size() && !normalTextureFilenames[i].empty())
+		if (i < m_asset->normalTextureFilenames.size() && !m_asset->normalTextureFilenames[i].empty())
 		{
-			textureHeapOffsets["normalTex"] = texs->textures[normalTextureFilenames[i]]->heapOffset;
+			textureHeapOffsets["normalTex"] = texs->textures[m_asset->normalTextureFilenames[i]]->heapOffset;
 		}
 
 		
@@ -638,15 +696,15 @@ void AnimatedModel::drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, c
 		psos->bind(core, pipes->pipelines[pipeName].psoName);
 
 		
-		if (meshes[i] != nullptr)
+		if (m_asset->meshes[i] != nullptr)
 		{
 			if (instanceCount > 1)
 			{
-				meshes[i]->drawInstanced(core, instanceCount);
+				m_asset->meshes[i]->drawInstanced(core, instanceCount);
 			}
 			else
 			{
-				meshes[i]->draw(core);
+				m_asset->meshes[i]->draw(core);
 			}
 		}
 	}
@@ -6,8 +6,10 @@
 #include "map"
 #include "iostream"
 #include <algorithm>
+#include <memory>
 #include "math.h"
 #include "Pipeline.h"
+#include "TransformStore.h"
 #undef min
 #undef max
 
@@ -94,6 +96,8 @@ struct AnimationSequence // This holds rescaled times
 	}
 };
 
+// Shared by every instance of a model and read by the animation jobs at once, so lookups
+// never insert: unknown names are the caller's to check with hasAnimation or find
 class Animation
 {
 public:
@@ -103,13 +107,19 @@ public:
 	{
 		return skeleton.bones.size();
 	}
-	void calcFrame(std::string name, float t, int& frame, float& interpolationFact)
+	// nullptr if the model has no such animation
+	AnimationSequence* find(const std::string& name)
 	{
-		animations[name].calcFrame(t, frame, interpolationFact);
+		auto it = animations.find(name);
+		return it != animations.end() ? &it->second : nullptr;
 	}
-	Matrix interpolateBoneToGlobal(std::string name, Matrix* matrices, int baseFrame, float interpolationFact, int boneIndex)
+	void calcFrame(const std::string& name, float t, int& frame, float& interpolationFact)
 	{
-		return animations[name].interpolateBoneToGlobal(matrices, baseFrame, interpolationFact, &skeleton, boneIndex);
+		animations.at(name).calcFrame(t, frame, interpolationFact);
+	}
+	Matrix interpolateBoneToGlobal(const std::string& name, Matrix* matrices, int baseFrame, float interpolationFact, int boneIndex)
+	{
+		return animations.at(name).interpolateBoneToGlobal(matrices, baseFrame, interpolationFact, &skeleton, boneIndex);
 	}
 	void calcTransforms(Matrix* matrices, Matrix coordTransform)
 	{
@@ -175,6 +185,11 @@ public:
 		{
 			return;
 		}
+		// unknown names hold the last pose
+		if (!animation->hasAnimation(name))
+		{
+			return;
+		}
 		int frame = 0;
 		float interpolationFact = 0;
 		animation->calcFrame(name, t, frame, interpolationFact);
@@ -190,7 +205,8 @@ public:
 	}
 	bool animationFinished()
 	{
-		if (t > animation->animations[usingAnimation].duration())
+		AnimationSequence* sequence = animation->find(usingAnimation);
+		if (sequence == nullptr || t > sequence->duration())
 		{
 			return true;
 		}
@@ -227,8 +243,8 @@ public:
 		Unknown     
 	};
 
-	ID3D12Resource* vertexBuffer;
-	ID3D12Resource* indexBuffer;
+	ID3D12Resource* vertexBuffer = nullptr;
+	ID3D12Resource* indexBuffer = nullptr;
 	D3D12_VERTEX_BUFFER_VIEW vbView;
 	D3D12_INDEX_BUFFER_VIEW ibView;
 	D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
@@ -238,6 +254,7 @@ public:
 	//D3D12_INPUT_LAYOUT_DESC inputLayoutDesc;
 	std::vector<STATIC_VERTEX> m_staticVertices;    // STATIC_VERTEX data
 	std::vector<ANIMATED_VERTEX> m_animatedVertices;// ANIMATED_VERTEX data
+	std::vector<unsigned int> m_indices;            // kept on the CPU for mesh colliders
 	VertexType m_vertexType = VertexType::Unknown;  
 	
 public:
@@ -247,6 +264,7 @@ public:
 	void init(Core* core, std::vector<STATIC_VERTEX> vertices, std::vector<unsigned int> indices)
 	{
 		m_staticVertices = std::move(vertices);
+		m_indices = indices;
 		m_vertexType = VertexType::Static;
 
 		init(core, &m_staticVertices[0], sizeof(STATIC_VERTEX), m_staticVertices.size(), &indices[0], indices.size());
@@ -256,6 +274,7 @@ public:
 	void init(Core* core, std::vector<ANIMATED_VERTEX> vertices, std::vector<unsigned int> indices)
 	{
 		m_animatedVertices = std::move(vertices);
+		m_indices = indices;
 		m_vertexType = VertexType::Animated;
 
 		init(core, &m_animatedVertices[0], sizeof(ANIMATED_VERTEX), m_animatedVertices.size(), &indices[0], indices.size());
@@ -266,6 +285,23 @@ public:
 
 	void drawInstanced(Core* core, int instanceCount);
 
+	// free the GPU buffers, the GPU must be done with them
+	void release()
+	{
+#ifdef _WIN32
+		if (vertexBuffer != nullptr)
+		{
+			vertexBuffer->Release();
+			vertexBuffer = nullptr;
+		}
+		if (indexBuffer != nullptr)
+		{
+			indexBuffer->Release();
+			indexBuffer = nullptr;
+		}
+#endif
+	}
+
 	static void CreatePlane(Core* core, Mesh* plane);
 
 	static void CreateCube(Core* core, Mesh* cube);
@@ -316,6 +352,8 @@ public:
 		return vertices;
 	}
 
+	const std::vector<unsigned int>& getIndices() const { return m_indices; }
+
 	// Return the positions of all world space vertices
 	std::vector<Vec3> getVertices(Matrix& modelMatrix) const
 	{
@@ -332,74 +370,160 @@ public:
 class WorldPosParam
 {
 protected:
-	Matrix m_worldPosMat;
-	Vec3 worldPos;
-	Vec3 worldScaling;
-	Vec3 worldRotationRadian;
-	Matrix m_worldRotation;
+	// slot in the TransformStore, which owns the local and world transform
+	uint32_t m_transformId;
+	WorldPosParam* m_parent = nullptr;
+
+	// state at the start of the last simulation tick that changed this transform, for render interpolation
+	Vec3 m_prevWorldPos;
+	Vec3 m_prevWorldScaling;
+	Vec3 m_committedWorldPos;
+	Vec3 m_committedWorldScaling;
+	unsigned int m_simulationTick = 0;
+	bool m_hasCommitted = false;
+	bool m_hasPrevState = false;
+	inline static unsigned int s_simulationTick = 0;
+	inline static float s_interpolationAlpha = 1.0f;
 public:
 	WorldPosParam()
 	{
-		worldRotationRadian = Vec3(0.f, 0.f, 0.f);
-		worldScaling = Vec3(0.01f, 0.01f, 0.01f);
-		updateWorldMatrix();
+		m_transformId = TransformStore::Get().create();
+		SetWorldScaling(Vec3(0.01f, 0.01f, 0.01f));
+	}
+	~WorldPosParam()
+	{
+		TransformStore::Get().destroy(m_transformId);
 	}
+	// the store slot is owned, a copy would free it twice
+	WorldPosParam(const WorldPosParam&) = delete;
+	WorldPosParam& operator=(const WorldPosParam&) = delete;
+
+	// local values, equal to the world ones for transforms without a parent
 	inline Vec3 GetWorldPos() const
 	{
-		return worldPos;
+		return TransformStore::Get().getPosition(m_transformId);
 	}
 	inline Vec3 GetWorldScale() const
 	{
-		return worldScaling;
+		return TransformStore::Get().getScale(m_transformId);
 	}
 	inline Vec3 GetWorldRotationRadian() const
 	{
-		return worldRotationRadian;
+		return TransformStore::Get().getRotationRadian(m_transformId);
 	}
 
-	inline Matrix GetWorldMatrix() const
+	// as of the last TransformStore::updateWorldMatrices, a set since does not show until the next
+	inline const Matrix& GetWorldMatrix() const
+	{
+		return TransformStore::Get().getWorldMatrix(m_transformId);
+	}
+	// unique across all transforms, so a swapped mesh never matches a stale version
+	inline unsigned int GetTransformVersion() const
 	{
-		return m_worldPosMat;
+		return TransformStore::Get().getVersion(m_transformId);
 	}
 
 	void SetWorldPos(const Vec3& pos)
 	{
-		worldPos = pos;
-		updateWorldMatrix();
+		TransformStore::Get().setPosition(m_transformId, pos);
+		commitState();
+	}
+	// move without interpolating from the old position, for respawns
+	void TeleportWorldPos(const Vec3& pos)
+	{
+		SetWorldPos(pos);
+		m_hasPrevState = false;
 	}
 	void SetWorldScaling(const Vec3& scaling)
 	{
-		worldScaling = scaling;
-		updateWorldMatrix();
+		TransformStore::Get().setScale(m_transformId, scaling);
+		commitState();
 	}
 	void SetWorldRotationRadian(const Vec3& rotationRadian)
 	{
-		worldRotationRadian = rotationRadian;
-		m_worldRotation = Matrix::rotateY(worldRotationRadian.y) * Matrix::rotateX(worldRotationRadian.x) * Matrix::rotateZ(worldRotationRadian.z);
-		updateWorldMatrix();
+		Matrix rotation = Matrix::rotateY(rotationRadian.y) * Matrix::rotateX(rotationRadian.x) * Matrix::rotateZ(rotationRadian.z);
+		TransformStore::Get().setRotation(m_transformId, rotationRadian, rotation);
 	}
 
 	void SetRotationMatrix(Matrix rotMat)
 	{
-		m_worldRotation = rotMat;
-		updateWorldMatrix();
+		TransformStore::Get().setRotationMatrix(m_transformId, rotMat);
 	}
 
-	void updateWorldMatrix()
+	// attach below another transform, nullptr detaches. The parent must outlive the child
+	bool SetParent(WorldPosParam* parent)
 	{
-		
-		m_worldPosMat = Matrix::scaling(worldScaling) * m_worldRotation * Matrix::translation(worldPos) ;
+		uint32_t parentId = parent != nullptr ? parent->m_transformId : TransformStore::NoParent;
+		if (!TransformStore::Get().setParent(m_transformId, parentId))
+			return false;
+		m_parent = parent;
+		return true;
+	}
+	WorldPosParam* GetParent() const { return m_parent; }
+	uint32_t GetTransformId() const { return m_transformId; }
+
+	// **** render interpolation ****//
+	// called by World before each fixed tick and once per frame before drawing
+	static void BeginSimulationTick() { s_simulationTick++; }
+	static void SetInterpolationAlpha(float alpha) { s_interpolationAlpha = alpha; }
+
+	// world matrix between the last two simulation states. Rotation is not interpolated,
+	// it is mostly driven per frame by the camera
+	Matrix GetRenderMatrix() const
+	{
+		TransformStore& store = TransformStore::Get();
+		if (!m_hasPrevState || m_simulationTick != s_simulationTick || s_interpolationAlpha >= 1.0f)
+		{
+			if (m_parent == nullptr)
+				return GetWorldMatrix();
+			return store.getLocalMatrix(m_transformId) * m_parent->GetRenderMatrix();
+		}
+
+		float alpha = s_interpolationAlpha;
+		Vec3 pos = m_prevWorldPos + (m_committedWorldPos - m_prevWorldPos) * alpha;
+		Vec3 scaling = m_prevWorldScaling + (m_committedWorldScaling - m_prevWorldScaling) * alpha;
+		Matrix rotation = store.getRotationMatrix(m_transformId);
+		Matrix mat = Matrix::scaling(scaling) * rotation * Matrix::translation(pos);
+		if (m_parent != nullptr)
+			mat = mat * m_parent->GetRenderMatrix();
+		return mat;
+	}
+
+private:
+	// the first change in a tick snapshots what the last tick ended with
+	void commitState()
+	{
+		if (m_simulationTick != s_simulationTick || !m_hasPrevState)
+		{
+			m_hasPrevState = m_hasCommitted && m_simulationTick != s_simulationTick;
+			m_prevWorldPos = m_committedWorldPos;
+			m_prevWorldScaling = m_committedWorldScaling;
+			m_simulationTick = s_simulationTick;
+		}
+		m_committedWorldPos = GetWorldPos();
+		m_committedWorldScaling = GetWorldScale();
+		m_hasCommitted = true;
 	}
 };
 
-class StaticMesh : public WorldPosParam
+// geometry and materials of a static mesh, shared through AssetCache by every StaticMesh drawing it
+struct StaticMeshAsset
 {
-	
-public:
 	std::vector<Mesh> meshes;
 	std::vector<std::string> textureFilenames;			// albedo Textures
 	std::vector<std::string> normalTextureFilenames;	// nh Textures	
 
+	void CreateFromGEM(Core* core, std::string filename);
+	void CreateFromSphere(Core* core, int rings, int segments, float radius, std::string skyPath);
+	void CreateFromPlane(Core* core, float sizeX, float sizeZ, int xSegments, int zSegments, std::string texName, std::string nhName);
+	void release();
+};
+
+// one placed static mesh: its own transform over a shared asset
+class StaticMesh : public WorldPosParam
+{
+	std::shared_ptr<StaticMeshAsset> m_asset;
+public:
 	StaticMesh();
 	StaticMesh(Core* core, std::string filename);
 	
@@ -408,6 +532,9 @@ public:
 	void CreateFromSphere(Core* core, int rings, int segments, float radius, std::string skyPath);
 	void CreateFromPlane(Core* core, float sizeX = 100.0f, float sizeZ = 100.f, int xSegments = 100, int zSegments = 100, std::string texName = "Models/Textures/Textures1_ALB.png", std::string nhName = "Models/Textures/Textures1_NH.png");
 
+	const std::vector<Mesh>& getMeshes() const { return m_asset->meshes; }
+	const std::shared_ptr<StaticMeshAsset>& getAsset() const { return m_asset; }
+
 private:
 	void drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, const std::string& pipeName, int instanceCount = 1);
 	
@@ -418,18 +545,31 @@ public:
 };
 class AnimationStateMachine;
 
-class AnimatedModel : public WorldPosParam
+// meshes, skeleton and clips of an animated model, shared through AssetCache.
+// Playback state lives in each user's AnimationInstance
+struct AnimatedModelAsset
 {
-	
-public:
 	std::vector<Mesh*> meshes;
 	Animation animation;
 	std::vector<std::string> textureFilenames;			// albedo Textures
 	std::vector<std::string> normalTextureFilenames;	// nh Textures	
 
+	void CreateFromGEM(Core* core, std::string filename);
+	void release();
+};
+
+// one placed animated model: its own transform over a shared asset
+class AnimatedModel : public WorldPosParam
+{
+	std::shared_ptr<AnimatedModelAsset> m_asset;
+public:
 	// init function (load)
 	AnimatedModel(Core* core, std::string filename);
 	void CreateFromGEM(Core* core, std::string filename);
+
+	const std::vector<Mesh*>& getMeshes() const { return m_asset->meshes; }
+	Animation& getAnimation() { return m_asset->animation; }
+	const std::shared_ptr<AnimatedModelAsset>& getAsset() const { return m_asset; }
 private:
 	
 	void drawCommon(Core* core, PSOManager* psos, Pipelines* pipes, const std::string& pipeName,
@@ -0,0 +1,511 @@
+#include "MeshCollider.h"
+#include "Mesh.h"
+
+#include <cassert>
+
+std::map<std::string, std::shared_ptr<MeshCollider>> MeshCollider::s_sharedColliders;
+
+static_assert(sizeof(MeshCollider::Node) == 32, "MeshCollider::Node should stay 32 bytes");
+
+namespace
+{
+	// Ericson 5.1.5
+	Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+	{
+		Vec3 ab = b - a;
+		Vec3 ac = c - a;
+		Vec3 ap = p - a;
+		float d1 = Dot(ab, ap);
+		float d2 = Dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		Vec3 bp = p - b;
+		float d3 = Dot(ab, bp);
+		float d4 = Dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+
+		Vec3 cp = p - c;
+		float d5 = Dot(ab, cp);
+		float d6 = Dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	// two sided Moller-Trumbore
+	bool rayTriangle(const Vec3& origin, const Vec3& dir, const Vec3& a, const Vec3& b, const Vec3& c, float& t)
+	{
+		Vec3 e1 = b - a;
+		Vec3 e2 = c - a;
+		Vec3 p = Cross(dir, e2);
+		float det = Dot(e1, p);
+		if (fabsf(det) < 1e-12f)
+			return false;
+		float invDet = 1.0f / det;
+		Vec3 s = origin - a;
+		float u = Dot(s, p) * invDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+		Vec3 q = Cross(s, e1);
+		float v = Dot(dir, q) * invDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+		t = Dot(e2, q) * invDet;
+		return t >= 0.0f;
+	}
+
+	// earliest time in [0, 1] the moving sphere touches the triangle
+	bool sweepSphereTriangle(const Sphere& sphere, const Vec3& motion, const Vec3& a, const Vec3& b, const Vec3& c, float& toi)
+	{
+		Vec3 closest = closestPointOnTriangle(sphere.centre, a, b, c);
+		if ((sphere.centre - closest).lengthSq() <= sphere.radius * sphere.radius)
+		{
+			toi = 0.0f;
+			return true;
+		}
+
+		float length = motion.length();
+		if (length < 1e-6f)
+			return false;
+		Vec3 dir = motion / length;
+
+		// face, plane facing the start position
+		Vec3 n = Cross(b - a, c - a);
+		if (n.lengthSq() > 1e-12f)
+		{
+			n = n.normalize();
+			float distance = Dot(sphere.centre - a, n);
+			if (distance < 0.0f)
+			{
+				n = -n;
+				distance = -distance;
+			}
+			float approach = -Dot(dir, n);
+			if (approach > 1e-8f)
+			{
+				float t = (distance - sphere.radius) / approach;
+				if (t >= 0.0f && t <= length)
+				{
+					Vec3 contact = sphere.centre + dir * t - n * sphere.radius;
+					if ((closestPointOnTriangle(contact, a, b, c) - contact).lengthSq() < 1e-8f)
+					{
+						toi = t / length;
+						return true;
+					}
+				}
+			}
+		}
+
+		// edges and vertices
+		float best = FLT_MAX;
+		const Vec3* corners[3] = { &a, &b, &c };
+		for (int i = 0; i < 3; i++)
+		{
+			float t;
+			if (CollisionDetector::rayCapsule(sphere.centre, dir, *corners[i], *corners[(i + 1) % 3], sphere.radius, t))
+				best = std::min(best, t);
+		}
+		if (best > length)
+			return false;
+		toi = best / length;
+		return true;
+	}
+
+	Vec3 transformPoint(const Matrix& mat, const Vec3& v)
+	{
+		const float* m = mat.m;
+		return Vec3(
+			v.x * m[0] + v.y * m[1] + v.z * m[2] + m[3],
+			v.x * m[4] + v.y * m[5] + v.z * m[6] + m[7],
+			v.x * m[8] + v.y * m[9] + v.z * m[10] + m[11]);
+	}
+}
+
+MeshCollider::MeshCollider(const std::vector<Vec3>& positions, const std::vector<unsigned int>& indices)
+	: m_positions(positions)
+{
+	int triangleCount = static_cast<int>(indices.size() / 3);
+	assert(triangleCount <= static_cast<int>(LeafFirstMask));
+
+	std::vector<AABB> triBounds(triangleCount);
+	std::vector<Vec3> centroids(triangleCount);
+	std::vector<int> order(triangleCount);
+	m_bounds.reset();
+	for (int i = 0; i < triangleCount; i++)
+	{
+		AABB& box = triBounds[i];
+		box.reset();
+		for (int k = 0; k < 3; k++)
+			box.extend(positions[indices[i * 3 + k]]);
+		centroids[i] = box.getCenter();
+		order[i] = i;
+		m_bounds.extend(box.min);
+		m_bounds.extend(box.max);
+	}
+	if (triangleCount == 0)
+		return;
+
+	// quantization grid over the whole mesh
+	Vec3 size = m_bounds.getSize();
+	for (int k = 0; k < 3; k++)
+	{
+		float extent = std::max(size.coords[k], 1e-6f);
+		m_quantizeScale.coords[k] = 65535.0f / extent;
+		m_dequantizeScale.coords[k] = extent / 65535.0f;
+	}
+
+	AABB rootBounds;
+	if (triangleCount <= MaxLeafTriangles)
+	{
+		// a root with a single leaf and an empty sibling
+		m_nodes.emplace_back();
+		Node& root = m_nodes[0];
+		root.child[0] = LeafFlag | (static_cast<uint32_t>(triangleCount) << LeafCountShift);
+		root.child[1] = LeafFlag;
+		setChildBounds(root, 0, m_bounds);
+		setChildBounds(root, 1, AABB::fromCentreExtents(m_bounds.min, Vec3(0, 0, 0)));
+	}
+	else
+	{
+		buildChild(order, triBounds, centroids, 0, triangleCount, rootBounds);
+	}
+
+	// store triangles in leaf order so leaves are contiguous ranges
+	m_indices.resize(indices.size());
+	for (int i = 0; i < triangleCount; i++)
+	{
+		for (int k = 0; k < 3; k++)
+			m_indices[i * 3 + k] = indices[order[i] * 3 + k];
+	}
+}
+
+uint32_t MeshCollider::buildChild(std::vector<int>& order, std::vector<AABB>& triBounds, std::vector<Vec3>& centroids, int first, int count, AABB& bounds)
+{
+	bounds.reset();
+	AABB centroidBounds;
+	centroidBounds.reset();
+	for (int i = first; i < first + count; i++)
+	{
+		bounds = AABB::merge(bounds, triBounds[order[i]]);
+		centroidBounds.extend(centroids[order[i]]);
+	}
+
+	if (count <= MaxLeafTriangles)
+		return LeafFlag | (static_cast<uint32_t>(count) << LeafCountShift) | static_cast<uint32_t>(first);
+
+	// binned SAH over all three axes
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lo = centroidBounds.min.coords[axis];
+		float extent = centroidBounds.max.coords[axis] - lo;
+		if (extent < 1e-9f)
+			continue;
+
+		AABB binBounds[SAHBins];
+		int binCount[SAHBins] = {};
+		float binScale = SAHBins / extent;
+		for (int i = first; i < first + count; i++)
+		{
+			int bin = std::min(SAHBins - 1, static_cast<int>((centroids[order[i]].coords[axis] - lo) * binScale));
+			binBounds[bin] = AABB::merge(binBounds[bin], triBounds[order[i]]);
+			binCount[bin]++;
+		}
+
+		// sweep from the right, then evaluate each split from the left
+		float rightArea[SAHBins];
+		int rightCount[SAHBins];
+		AABB accum;
+		int accumCount = 0;
+		for (int b = SAHBins - 1; b > 0; b--)
+		{
+			accum = AABB::merge(accum, binBounds[b]);
+			accumCount += binCount[b];
+			rightArea[b] = accumCount ? accum.getSurfaceArea() : 0.0f;
+			rightCount[b] = accumCount;
+		}
+		accum = AABB();
+		accumCount = 0;
+		for (int b = 0; b < SAHBins - 1; b++)
+		{
+			accum = AABB::merge(accum, binBounds[b]);
+			accumCount += binCount[b];
+			if (accumCount == 0 || rightCount[b + 1] == 0)
+				continue;
+			float cost = accum.getSurfaceArea() * accumCount + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	int mid;
+	if (bestAxis < 0)
+	{
+		// all centroids on top of each other, split by count
+		mid = first + count / 2;
+	}
+	else
+	{
+		float lo = centroidBounds.min.coords[bestAxis];
+		float binScale = SAHBins / (centroidBounds.max.coords[bestAxis] - lo);
+		auto it = std::partition(order.begin() + first, order.begin() + first + count, [&](int tri)
+		{
+			int bin = std::min(SAHBins - 1, static_cast<int>((centroids[tri].coords[bestAxis] - lo) * binScale));
+			return bin <= bestSplit;
+		});
+		mid = static_cast<int>(it - order.begin());
+		if (mid == first || mid == first + count)
+			mid = first + count / 2;
+	}
+
+	// reserve the node before recursing so the parent keeps a lower index
+	int nodeIndex = static_cast<int>(m_nodes.size());
+	m_nodes.emplace_back();
+	AABB leftBounds, rightBounds;
+	uint32_t left = buildChild(order, triBounds, centroids, first, mid - first, leftBounds);
+	uint32_t right = buildChild(order, triBounds, centroids, mid, first + count - mid, rightBounds);
+
+	Node& node = m_nodes[nodeIndex];
+	node.child[0] = left;
+	node.child[1] = right;
+	setChildBounds(node, 0, leftBounds);
+	setChildBounds(node, 1, rightBounds);
+	return static_cast<uint32_t>(nodeIndex);
+}
+
+void MeshCollider::setChildBounds(Node& node, int child, const AABB& bounds)
+{
+	quantize(bounds, node.boundsMin[child], node.boundsMax[child]);
+}
+
+// round outwards so the quantized box always contains the real one
+void MeshCollider::quantize(const AABB& bounds, uint16_t* qMin, uint16_t* qMax) const
+{
+	for (int k = 0; k < 3; k++)
+	{
+		float lo = (bounds.min.coords[k] - m_bounds.min.coords[k]) * m_quantizeScale.coords[k];
+		float hi = (bounds.max.coords[k] - m_bounds.min.coords[k]) * m_quantizeScale.coords[k];
+		qMin[k] = static_cast<uint16_t>(std::clamp(floorf(lo), 0.0f, 65535.0f));
+		qMax[k] = static_cast<uint16_t>(std::clamp(ceilf(hi), 0.0f, 65535.0f));
+	}
+}
+
+AABB MeshCollider::dequantize(const Node& node, int child) const
+{
+	AABB bounds;
+	for (int k = 0; k < 3; k++)
+	{
+		bounds.min.coords[k] = m_bounds.min.coords[k] + node.boundsMin[child][k] * m_dequantizeScale.coords[k];
+		bounds.max.coords[k] = m_bounds.min.coords[k] + node.boundsMax[child][k] * m_dequantizeScale.coords[k];
+	}
+	return bounds;
+}
+
+std::shared_ptr<MeshCollider> MeshCollider::getShared(const std::string& path, const StaticMesh& mesh)
+{
+	auto it = s_sharedColliders.find(path);
+	if (it != s_sharedColliders.end())
+		return it->second;
+
+	// merge all sub meshes into one triangle soup
+	std::vector<Vec3> positions;
+	std::vector<unsigned int> indices;
+	for (const auto& submesh : mesh.getMeshes())
+	{
+		unsigned int base = static_cast<unsigned int>(positions.size());
+		std::vector<Vec3> vertices = submesh.getVertices();
+		positions.insert(positions.end(), vertices.begin(), vertices.end());
+		for (unsigned int index : submesh.getIndices())
+			indices.push_back(base + index);
+	}
+
+	auto collider = std::make_shared<MeshCollider>(positions, indices);
+	s_sharedColliders[path] = collider;
+	return collider;
+}
+
+bool MeshCollider::raycast(const Vec3& origin, const Vec3& dir, float maxT, float& t, Vec3& normal) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	Vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+	auto slab = [&](const AABB& box, float limit, float& tEnter)
+	{
+		float tNear = 0.0f;
+		float tFar = limit;
+		for (int k = 0; k < 3; k++)
+		{
+			float t1 = (box.min.coords[k] - origin.coords[k]) * invDir.coords[k];
+			float t2 = (box.max.coords[k] - origin.coords[k]) * invDir.coords[k];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+		tEnter = tNear;
+		return tNear <= tFar;
+	};
+
+	float closest = maxT;
+	bool found = false;
+	int stack[MaxStackDepth];
+	int count = 0;
+	stack[count++] = 0;
+	while (count > 0)
+	{
+		const Node& node = m_nodes[stack[--count]];
+		float enter[2];
+		bool hit[2];
+		for (int i = 0; i < 2; i++)
+			hit[i] = slab(dequantize(node, i), closest, enter[i]);
+
+		// push the far child first so the near one is visited first
+		int order[2] = { 0, 1 };
+		if (hit[0] && hit[1] && enter[1] < enter[0])
+			std::swap(order[0], order[1]);
+		for (int j = 1; j >= 0; j--)
+		{
+			int i = order[j];
+			if (!hit[i])
+				continue;
+			uint32_t child = node.child[i];
+			if (child & LeafFlag)
+			{
+				int first = child & LeafFirstMask;
+				int triangles = (child & ~LeafFlag) >> LeafCountShift;
+				for (int tri = first; tri < first + triangles; tri++)
+				{
+					Vec3 a, b, c;
+					getTriangle(tri, a, b, c);
+					float tTri;
+					if (rayTriangle(origin, dir, a, b, c, tTri) && tTri <= closest)
+					{
+						closest = tTri;
+						normal = Cross(b - a, c - a).normalize();
+						found = true;
+					}
+				}
+			}
+			else
+			{
+				stack[count++] = static_cast<int>(child);
+			}
+		}
+	}
+
+	if (found)
+	{
+		t = closest;
+		// face the normal against the ray
+		if (Dot(normal, dir) > 0.0f)
+			normal = -normal;
+	}
+	return found;
+}
+
+CollisionResult MeshCollider::overlapSphere(const Sphere& sphere, const Matrix& localToWorld, const Matrix& worldToLocal) const
+{
+	CollisionResult result;
+	AABB localBounds = sphere.getEnclosingAABB().transformed(worldToLocal);
+
+	// keep the deepest contact
+	float bestDistSq = sphere.radius * sphere.radius;
+	queryTriangles(localBounds, [&](int tri)
+	{
+		Vec3 a, b, c;
+		getTriangle(tri, a, b, c);
+		a = transformPoint(localToWorld, a);
+		b = transformPoint(localToWorld, b);
+		c = transformPoint(localToWorld, c);
+
+		Vec3 closest = closestPointOnTriangle(sphere.centre, a, b, c);
+		Vec3 diff = sphere.centre - closest;
+		float distSq = diff.lengthSq();
+		if (distSq < bestDistSq)
+		{
+			bestDistSq = distSq;
+			float dist = sqrt(distSq);
+			result.isColliding = true;
+			result.penetration = sphere.radius - dist;
+			if (dist > 1e-6f)
+			{
+				result.normal = diff / dist;
+			}
+			else
+			{
+				// centre on the surface, fall back to the face normal
+				Vec3 n = Cross(b - a, c - a);
+				result.normal = n.lengthSq() > 1e-12f ? n.normalize() : Vec3(0, 1, 0);
+			}
+		}
+		return true;
+	});
+	return result;
+}
+
+CollisionResult MeshCollider::sweepSphere(const Sphere& sphere, const Vec3& motion, const Matrix& localToWorld, const Matrix& worldToLocal, float& toi) const
+{
+	CollisionResult result;
+	Sphere endSphere(sphere.centre + motion, sphere.radius);
+	AABB sweptBounds = AABB::merge(sphere.getEnclosingAABB(), endSphere.getEnclosingAABB());
+	AABB localBounds = sweptBounds.transformed(worldToLocal);
+
+	float best = FLT_MAX;
+	Vec3 hitA, hitB, hitC;
+	queryTriangles(localBounds, [&](int tri)
+	{
+		Vec3 a, b, c;
+		getTriangle(tri, a, b, c);
+		a = transformPoint(localToWorld, a);
+		b = transformPoint(localToWorld, b);
+		c = transformPoint(localToWorld, c);
+
+		float t;
+		if (sweepSphereTriangle(sphere, motion, a, b, c, t) && t < best)
+		{
+			best = t;
+			hitA = a; hitB = b; hitC = c;
+		}
+		// nothing beats touching at the start
+		return best > 0.0f;
+	});
+
+	if (best == FLT_MAX)
+		return result;
+
+	toi = best;
+	result.isColliding = true;
+	Vec3 centre = sphere.centre + motion * best;
+	Vec3 n = centre - closestPointOnTriangle(centre, hitA, hitB, hitC);
+	if (n.lengthSq() > 1e-12f)
+	{
+		result.normal = n.normalize();
+	}
+	else
+	{
+		n = Cross(hitB - hitA, hitC - hitA);
+		result.normal = n.lengthSq() > 1e-12f ? n.normalize() : Vec3(0, 1, 0);
+	}
+	return result;
+}
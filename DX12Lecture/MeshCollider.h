@@ -0,0 +1,117 @@
+#pragma once
+#include "Collision.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+class StaticMesh;
+
+// Triangle BVH over a static mesh in local space.
+// Built once per asset and shared between every actor using that asset.
+class MeshCollider
+{
+public:
+	// 32 byte node. Child bounds are quantized to 16 bits inside the mesh bounds,
+	// child[i] is a node index, or a leaf (first triangle, count) when LeafFlag is set
+	struct Node
+	{
+		uint16_t boundsMin[2][3];
+		uint16_t boundsMax[2][3];
+		uint32_t child[2];
+	};
+
+	static const uint32_t LeafFlag = 0x80000000u;
+	static const int LeafCountShift = 24;
+	static const uint32_t LeafFirstMask = 0x00FFFFFFu;
+	static const int MaxLeafTriangles = 4;
+	static const int SAHBins = 12;
+
+	MeshCollider(const std::vector<Vec3>& positions, const std::vector<unsigned int>& indices);
+
+	// build or fetch the collider for an asset path
+	static std::shared_ptr<MeshCollider> getShared(const std::string& path, const StaticMesh& mesh);
+
+	const AABB& getBounds() const { return m_bounds; }
+	int getTriangleCount() const { return static_cast<int>(m_indices.size() / 3); }
+	int getNodeCount() const { return static_cast<int>(m_nodes.size()); }
+	void getTriangle(int triangle, Vec3& a, Vec3& b, Vec3& c) const
+	{
+		a = m_positions[m_indices[triangle * 3 + 0]];
+		b = m_positions[m_indices[triangle * 3 + 1]];
+		c = m_positions[m_indices[triangle * 3 + 2]];
+	}
+
+	// local space ray, dir does not need to be unit length and t is in units of dir
+	bool raycast(const Vec3& origin, const Vec3& dir, float maxT, float& t, Vec3& normal) const;
+
+	// calls callback(triangle) for every triangle in a leaf overlapping localBounds, return false to stop
+	template<typename Callback>
+	void queryTriangles(const AABB& localBounds, Callback&& callback) const
+	{
+		if (m_nodes.empty() || !m_bounds.overlaps(localBounds))
+			return;
+
+		uint16_t qMin[3], qMax[3];
+		quantize(localBounds, qMin, qMax);
+
+		int stack[MaxStackDepth];
+		int count = 0;
+		stack[count++] = 0;
+		while (count > 0)
+		{
+			const Node& node = m_nodes[stack[--count]];
+			for (int i = 0; i < 2; i++)
+			{
+				if (!overlapsQuantized(node, i, qMin, qMax))
+					continue;
+				uint32_t child = node.child[i];
+				if (child & LeafFlag)
+				{
+					int first = child & LeafFirstMask;
+					int triangles = (child & ~LeafFlag) >> LeafCountShift;
+					for (int tri = first; tri < first + triangles; tri++)
+					{
+						if (!callback(tri))
+							return;
+					}
+				}
+				else
+				{
+					stack[count++] = static_cast<int>(child);
+				}
+			}
+		}
+	}
+
+	// World space sphere queries. The tree is walked in local space and the candidate
+	// triangles are tested in world space, so non-uniform scale stays exact.
+	// normal points from the mesh towards the sphere
+	CollisionResult overlapSphere(const Sphere& sphere, const Matrix& localToWorld, const Matrix& worldToLocal) const;
+	CollisionResult sweepSphere(const Sphere& sphere, const Vec3& motion, const Matrix& localToWorld, const Matrix& worldToLocal, float& toi) const;
+
+private:
+	static const int MaxStackDepth = 64;
+
+	uint32_t buildChild(std::vector<int>& order, std::vector<AABB>& triBounds, std::vector<Vec3>& centroids, int first, int count, AABB& bounds);
+	void setChildBounds(Node& node, int child, const AABB& bounds);
+	void quantize(const AABB& bounds, uint16_t* qMin, uint16_t* qMax) const;
+	AABB dequantize(const Node& node, int child) const;
+
+	static bool overlapsQuantized(const Node& node, int child, const uint16_t* qMin, const uint16_t* qMax)
+	{
+		return node.boundsMin[child][0] <= qMax[0] && node.boundsMax[child][0] >= qMin[0] &&
+			node.boundsMin[child][1] <= qMax[1] && node.boundsMax[child][1] >= qMin[1] &&
+			node.boundsMin[child][2] <= qMax[2] && node.boundsMax[child][2] >= qMin[2];
+	}
+
+	std::vector<Vec3> m_positions;
+	std::vector<unsigned int> m_indices;	// 3 per triangle, in leaf order
+	std::vector<Node> m_nodes;				// node 0 is the root
+	AABB m_bounds;
+	Vec3 m_quantizeScale;					// bounds to [0, 65535]
+	Vec3 m_dequantizeScale;
+
+	static std::map<std::string, std::shared_ptr<MeshCollider>> s_sharedColliders;
+};
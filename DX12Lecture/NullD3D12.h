@@ -0,0 +1,54 @@
+#pragma once
+// Without the Windows SDK, e.g. on the Linux build machines, only the null render device
+// (Core::initHeadless) exists. These stand in for the D3D12 and Win32 names the engine
+// headers mention, the interfaces stay opaque: every call into them is behind _WIN32
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+typedef unsigned int UINT;
+typedef uint64_t UINT64;
+typedef long LONG;
+typedef void* HANDLE;
+typedef void* HWND;
+
+struct IDXGIAdapter1;
+struct IDXGISwapChain3;
+struct ID3D12Device5;
+struct ID3D12CommandQueue;
+struct ID3D12CommandAllocator;
+struct ID3D12GraphicsCommandList4;
+struct ID3D12DescriptorHeap;
+struct ID3D12Resource;
+struct ID3D12Fence;
+struct ID3D12RootSignature;
+struct ID3D12PipelineState;
+struct ID3DBlob;
+
+typedef UINT64 D3D12_GPU_VIRTUAL_ADDRESS;
+struct D3D12_CPU_DESCRIPTOR_HANDLE { size_t ptr; };
+struct D3D12_GPU_DESCRIPTOR_HANDLE { UINT64 ptr; };
+struct D3D12_VIEWPORT { float TopLeftX, TopLeftY, Width, Height, MinDepth, MaxDepth; };
+struct D3D12_RECT { LONG left, top, right, bottom; };
+
+enum DXGI_FORMAT { DXGI_FORMAT_UNKNOWN = 0, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB = 29 };
+enum D3D12_RESOURCE_STATES { D3D12_RESOURCE_STATE_COMMON = 0 };
+struct D3D12_PLACED_SUBRESOURCE_FOOTPRINT;
+
+struct D3D12_VERTEX_BUFFER_VIEW { D3D12_GPU_VIRTUAL_ADDRESS BufferLocation; UINT SizeInBytes; UINT StrideInBytes; };
+struct D3D12_INDEX_BUFFER_VIEW { D3D12_GPU_VIRTUAL_ADDRESS BufferLocation; UINT SizeInBytes; DXGI_FORMAT Format; };
+struct D3D12_INPUT_ELEMENT_DESC;
+struct D3D12_INPUT_LAYOUT_DESC { const D3D12_INPUT_ELEMENT_DESC* pInputElementDescs; UINT NumElements; };
+
+// the performance counter World.h's Timer reads, in nanoseconds
+union LARGE_INTEGER { long long QuadPart; };
+inline int QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+	frequency->QuadPart = 1000000000LL;
+	return 1;
+}
+inline int QueryPerformanceCounter(LARGE_INTEGER* count)
+{
+	count->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return 1;
+}
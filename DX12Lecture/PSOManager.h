@@ -2,7 +2,9 @@
 #include <unordered_map>
 #include "Core.h"
 #include <iostream>
+#ifdef _WIN32
 #include <wrl/client.h>
+#endif
 class PSOManager
 {
 public:
@@ -14,6 +16,7 @@ public:
 		{
 			return;
 		}
+#ifdef _WIN32
 		D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
 		desc.InputLayout = layout;
 		desc.pRootSignature = core->rootSignature;
@@ -68,10 +71,13 @@ public:
 		HRESULT hr = core->device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pso));
 		
 		psos.insert({ name, pso });
+#endif
 	}
 
 	void bind(Core* core, std::string name) {
+#ifdef _WIN32
 		core->getCommandList()->SetPipelineState(psos[name]);
+#endif
 	}
 
 };
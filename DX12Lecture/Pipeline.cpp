@@ -8,6 +8,7 @@ void Pipeline::init(std::string vsPath, std::string psPath)
 	vertexShaderStr = loadstr(vsPath);
 	pixelShaderStr = loadstr(psPath);
 
+#ifdef _WIN32
 	ID3DBlob* status;
 
 	HRESULT hr = D3DCompile(vertexShaderStr.c_str(), strlen(vertexShaderStr.c_str()), NULL,
@@ -27,6 +28,7 @@ void Pipeline::init(std::string vsPath, std::string psPath)
 		(char*)status->GetBufferPointer();
 
 	}
+#endif
 
 	
 
@@ -1,11 +1,14 @@
 #pragma once
 #include "Core.h"
+#ifdef _WIN32
 #include <dxgi.h>
+#endif
 #include <iostream>
 #include "PSOManager.h"
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <algorithm>
 #include "ConstantBuffer.h"
 #include "TextureManager.h"
 
@@ -46,8 +49,10 @@ public:
 	
 	void free()
 	{
+#ifdef _WIN32
 		pixelShader->Release();
 		vertexShader->Release();
+#endif
 		for (auto cb : psConstantBuffers)
 		{
 			cb.free();
@@ -120,7 +125,9 @@ public:
 		UINT bindPoint = textureBindPoints->find(name)->second;
 		D3D12_GPU_DESCRIPTOR_HANDLE handle = core->srvHeap.gpuHandle;
 		handle.ptr = handle.ptr + (UINT64)(heapOffset) * (UINT64)core->srvHeap.incrementSize;
+#ifdef _WIN32
 		core->getCommandList()->SetGraphicsRootDescriptorTable(srvRootIndex, handle);
+#endif
 	}
 
 	static void updateTexture(std::map<std::string, int>* const textureBindPoints, Core* core, const std::map<std::string, int>& textureHeapOffsets, int srvRootIndex = 3)
@@ -141,8 +148,9 @@ public:
 			D3D12_GPU_DESCRIPTOR_HANDLE handle = core->srvHeap.gpuHandle;
 			handle.ptr += (UINT64)(heapOffset) * core->srvHeap.incrementSize;
 
-			
+#ifdef _WIN32
 			core->getCommandList()->SetGraphicsRootDescriptorTable(srvRootIndex, handle);
+#endif
 		}
 	}
 	static void submitToCommandList(Core* core, std::vector<ConstantBuffer>& constantBuffers, UINT rootIndexOffset = 0)
@@ -151,7 +159,9 @@ public:
 		{
 			//UINT rootIndex = rootIndexOffset + i;
 			UINT rootIndex = ConstantBuffer::RegisterToRootIndex[constantBuffers[i].name];
+#ifdef _WIN32
 			core->getCommandList()->SetGraphicsRootConstantBufferView(rootIndex, constantBuffers[i].getGPUAddress());
+#endif
 			constantBuffers[i].next();
 		}
 	}
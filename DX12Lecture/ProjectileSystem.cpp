@@ -0,0 +1,190 @@
+#include "ProjectileSystem.h"
+#include "Actor.h"
+#include "SceneQuery.h"
+#include "World.h"
+#include "JobSystem.h"
+#include <xmmintrin.h>
+
+
+// out of line, StaticMesh is only complete here
+ProjectileSystem::ProjectileSystem() = default;
+ProjectileSystem::~ProjectileSystem() = default;
+
+void ProjectileSystem::spawn(const Vec3& pos, const Vec3& dir, float speed, int damage)
+{
+	Vec3 velocity = dir.normalize() * speed;
+	m_posX.push_back(pos.x);
+	m_posY.push_back(pos.y);
+	m_posZ.push_back(pos.z);
+	// no interpolation from anywhere on the first frame
+	m_prevX.push_back(pos.x);
+	m_prevY.push_back(pos.y);
+	m_prevZ.push_back(pos.z);
+	m_velX.push_back(velocity.x);
+	m_velY.push_back(velocity.y);
+	m_velZ.push_back(velocity.z);
+	m_lifeTime.push_back(0.0f);
+	m_travel.push_back(1.0f);
+	m_damage.push_back(damage);
+}
+
+void ProjectileSystem::update(float dt, const LayeredBroadphase& broadphase)
+{
+	m_hits.clear();
+	int count = getCount();
+	if (count == 0)
+		return;
+
+	m_prevX = m_posX;
+	m_prevY = m_posY;
+	m_prevZ = m_posZ;
+
+	// sweep every path against statics and the layers projectiles can hit, one tree walk
+	// per packet of paths rather than per projectile
+	SceneQuery sceneQuery(broadphase);
+	QueryFilter filter;
+	filter.layerMask = CollisionMatrix::getMask(CollisionLayer::Projectile);
+	Sphere spheres[SweepBatch];
+	Vec3 motions[SweepBatch];
+	int hitCounts[SweepBatch];
+	SweepHit sweepHits[SweepBatch * MaxSweepHits];
+	for (int first = 0; first < count; first += SweepBatch)
+	{
+		int batchCount = std::min(SweepBatch, count - first);
+		for (int b = 0; b < batchCount; b++)
+		{
+			int p = first + b;
+			spheres[b] = Sphere(Vec3(m_posX[p], m_posY[p], m_posZ[p]), Radius);
+			motions[b] = Vec3(m_velX[p] * dt, m_velY[p] * dt, m_velZ[p] * dt);
+		}
+		sceneQuery.sweepSphereBatch(spheres, motions, batchCount, sweepHits, MaxSweepHits, hitCounts, filter);
+
+		for (int b = 0; b < batchCount; b++)
+		{
+			int p = first + b;
+			const SweepHit* hits = sweepHits + b * MaxSweepHits;
+			m_travel[p] = 1.0f;
+			for (int h = 0; h < hitCounts[b]; h++)
+			{
+				const SweepHit& hit = hits[h];
+				if (hit.actor->getCollisionLayer() == CollisionLayer::Static)
+				{
+					// stop at the first wall, actors behind it are safe
+					m_travel[p] = hit.toi;
+					m_lifeTime[p] = MaxLifeTime;
+					break;
+				}
+				ProjectileHit projectileHit;
+				projectileHit.actor = hit.actor;
+				projectileHit.point = spheres[b].centre + motions[b] * hit.toi;
+				projectileHit.damage = m_damage[p];
+				m_hits.push_back(projectileHit);
+			}
+		}
+	}
+
+	// integrate, four projectiles per iteration
+	const __m128 dtv = _mm_set1_ps(dt);
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 step = _mm_mul_ps(dtv, _mm_loadu_ps(&m_travel[i]));
+		_mm_storeu_ps(&m_posX[i], _mm_add_ps(_mm_loadu_ps(&m_posX[i]), _mm_mul_ps(_mm_loadu_ps(&m_velX[i]), step)));
+		_mm_storeu_ps(&m_posY[i], _mm_add_ps(_mm_loadu_ps(&m_posY[i]), _mm_mul_ps(_mm_loadu_ps(&m_velY[i]), step)));
+		_mm_storeu_ps(&m_posZ[i], _mm_add_ps(_mm_loadu_ps(&m_posZ[i]), _mm_mul_ps(_mm_loadu_ps(&m_velZ[i]), step)));
+		_mm_storeu_ps(&m_lifeTime[i], _mm_add_ps(_mm_loadu_ps(&m_lifeTime[i]), dtv));
+	}
+	for (; i < count; i++)
+	{
+		float step = dt * m_travel[i];
+		m_posX[i] += m_velX[i] * step;
+		m_posY[i] += m_velY[i] * step;
+		m_posZ[i] += m_velZ[i] * step;
+		m_lifeTime[i] += dt;
+	}
+
+	// backwards, so the projectile moved into a hole has already been checked
+	for (int p = count - 1; p >= 0; p--)
+	{
+		if (m_lifeTime[p] >= MaxLifeTime)
+			removeAt(p);
+	}
+}
+
+void ProjectileSystem::prepareRender(float alpha)
+{
+	int count = getCount();
+	m_instanceMatrices.resize(count);
+
+	Matrix base = Matrix::scaling(Vec3(0.01f, 0.01f, 0.01f));
+	auto build = [&](int first, int last)
+	{
+		for (int p = first; p < last; p++)
+		{
+			Matrix& mat = m_instanceMatrices[p];
+			mat = base;
+			mat.m[3] = m_prevX[p] + (m_posX[p] - m_prevX[p]) * alpha;
+			mat.m[7] = m_prevY[p] + (m_posY[p] - m_prevY[p]) * alpha;
+			mat.m[11] = m_prevZ[p] + (m_posZ[p] - m_prevZ[p]) * alpha;
+		}
+	};
+	JobSystem* jobs = JobSystem::Get();
+	if (jobs != nullptr)
+		jobs->parallelFor(0, count, 1024, build);
+	else
+		build(0, count);
+}
+
+void ProjectileSystem::draw()
+{
+	int count = static_cast<int>(m_instanceMatrices.size());
+	if (count == 0)
+		return;
+
+	World* myWorld = World::Get();
+	if (myWorld->GetCore()->isHeadless())
+		return;
+	if (!m_mesh)
+	{
+		m_mesh = std::make_unique<StaticMesh>();
+		m_mesh->CreateFromSphere(myWorld->GetCore(), 12, 12, 10, "Models/Textures/arms_1_Albedo_nh.png");
+		m_drawMatrices.resize(MaxInstancesPerDraw);
+	}
+
+	// the constant buffer holds MaxInstancesPerDraw matrices, bigger counts take several draws
+	for (int first = 0; first < count; first += MaxInstancesPerDraw)
+	{
+		int batch = std::min(MaxInstancesPerDraw, count - first);
+		std::copy(m_instanceMatrices.begin() + first, m_instanceMatrices.begin() + first + batch, m_drawMatrices.begin());
+		m_mesh->drawInstances(myWorld->GetCore(), myWorld->GetPSOManager(), STATIC_INSTANCE_PIPE, myWorld->GetPipelines(), &m_drawMatrices, batch);
+	}
+}
+
+void ProjectileSystem::clear()
+{
+	m_posX.clear(); m_posY.clear(); m_posZ.clear();
+	m_prevX.clear(); m_prevY.clear(); m_prevZ.clear();
+	m_velX.clear(); m_velY.clear(); m_velZ.clear();
+	m_lifeTime.clear();
+	m_travel.clear();
+	m_damage.clear();
+	m_hits.clear();
+	m_instanceMatrices.clear();
+}
+
+// swap with the last projectile, order does not matter
+void ProjectileSystem::removeAt(int index)
+{
+	int last = getCount() - 1;
+	auto moveLast = [&](auto& values)
+	{
+		values[index] = values[last];
+		values.pop_back();
+	};
+	moveLast(m_posX); moveLast(m_posY); moveLast(m_posZ);
+	moveLast(m_prevX); moveLast(m_prevY); moveLast(m_prevZ);
+	moveLast(m_velX); moveLast(m_velY); moveLast(m_velZ);
+	moveLast(m_lifeTime);
+	moveLast(m_travel);
+	moveLast(m_damage);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Vec3.h"
+
+class Actor;
+class LayeredBroadphase;
+class StaticMesh;
+
+// projectile that reached a non-static actor this tick
+struct ProjectileHit
+{
+	Actor* actor = nullptr;
+	Vec3 point;
+	int damage = 0;
+};
+
+// Every projectile of a level, stored as structure of arrays instead of one actor each.
+// A tick sweeps the paths in packets of four, integrates them all in one 4-wide SSE
+// loop, then drops the dead ones. Hits on non-static actors are collected as events.
+// Spawn from the main thread only
+class ProjectileSystem
+{
+public:
+	static constexpr float MaxLifeTime = 3.0f;
+	static constexpr float Radius = 0.1f;			// matches the 10 unit sphere drawn at 0.01 scale
+	static constexpr int MaxSweepHits = 16;
+	static constexpr int SweepBatch = 64;				// paths per sweepSphereBatch call, a multiple of its packet width
+	static constexpr int MaxInstancesPerDraw = 100;	// instanceMatrices[100] in the instanced vertex shaders
+
+	ProjectileSystem();
+	~ProjectileSystem();
+
+	void spawn(const Vec3& pos, const Vec3& dir, float speed, int damage);
+
+	// one fixed step. Projectiles stop at the first static actor on their path and
+	// report every other actor they pass through before it
+	void update(float dt, const LayeredBroadphase& broadphase);
+	// hits from the last update
+	const std::vector<ProjectileHit>& getHits() const { return m_hits; }
+
+	// RenderPrep: instance matrices for every projectile, positions interpolated
+	// between the last two updates
+	void prepareRender(float alpha);
+	// instanced, from the matrices of the last prepareRender
+	void draw();
+
+	void clear();
+	int getCount() const { return static_cast<int>(m_posX.size()); }
+
+private:
+	void removeAt(int index);
+
+	std::vector<float> m_posX, m_posY, m_posZ;
+	std::vector<float> m_prevX, m_prevY, m_prevZ;
+	std::vector<float> m_velX, m_velY, m_velZ;
+	std::vector<float> m_lifeTime;
+	std::vector<float> m_travel;		// fraction of this tick's motion before a wall
+	std::vector<int> m_damage;
+
+	std::vector<ProjectileHit> m_hits;
+	std::vector<Matrix> m_instanceMatrices;	// one per projectile
+	std::vector<Matrix> m_drawMatrices;		// one draw's worth, the size the constant buffer reads
+	// built on first draw, shares the bullet sphere through AssetCache
+	std::unique_ptr<StaticMesh> m_mesh;
+};
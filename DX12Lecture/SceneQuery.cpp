@@ -0,0 +1,546 @@
+#include "SceneQuery.h"
+#include "Actor.h"
+
+#include <xmmintrin.h>
+
+namespace
+{
+	// the local direction is not renormalised, so local t is still the world distance
+	void toLocalRay(const Ray& ray, const Matrix& worldToLocal, Vec3& localOrigin, Vec3& localDir)
+	{
+		const float* m = worldToLocal.m;
+		localOrigin = Vec3(
+			ray.o.x * m[0] + ray.o.y * m[1] + ray.o.z * m[2] + m[3],
+			ray.o.x * m[4] + ray.o.y * m[5] + ray.o.z * m[6] + m[7],
+			ray.o.x * m[8] + ray.o.y * m[9] + ray.o.z * m[10] + m[11]);
+		localDir = Vec3(
+			ray.dir.x * m[0] + ray.dir.y * m[1] + ray.dir.z * m[2],
+			ray.dir.x * m[4] + ray.dir.y * m[5] + ray.dir.z * m[6],
+			ray.dir.x * m[8] + ray.dir.y * m[9] + ray.dir.z * m[10]);
+	}
+
+	// normals go back through the inverse transpose
+	Vec3 normalToWorld(const Vec3& localNormal, const Matrix& worldToLocal)
+	{
+		const float* m = worldToLocal.m;
+		return Vec3(
+			localNormal.x * m[0] + localNormal.y * m[4] + localNormal.z * m[8],
+			localNormal.x * m[1] + localNormal.y * m[5] + localNormal.z * m[9],
+			localNormal.x * m[2] + localNormal.y * m[6] + localNormal.z * m[10]).normalize();
+	}
+
+	// exact ray test against the actor's collision shape, distance along the unit ray
+	bool rayActor(const Ray& ray, float maxDistance, const Actor* actor, float& distance, Vec3& normal)
+	{
+		float t = 0.0f;
+		CollisionResult result;
+		switch (actor->getCollisionShapeType())
+		{
+		case CollisionShapeType::AABB:
+			result = CollisionDetector::checkRayAABB(ray, actor->getWorldAABB(), t);
+			break;
+		case CollisionShapeType::Sphere:
+			result = CollisionDetector::checkRaySphere(ray, actor->getWorldSphere(), t);
+			break;
+		case CollisionShapeType::OBB:
+		{
+			// solve in the box frame
+			const OBB& obb = actor->getWorldOBB();
+			Vec3 rel = ray.o - obb.center;
+			Ray localRay(Vec3(Dot(rel, obb.xAxis), Dot(rel, obb.yAxis), Dot(rel, obb.zAxis)),
+				Vec3(Dot(ray.dir, obb.xAxis), Dot(ray.dir, obb.yAxis), Dot(ray.dir, obb.zAxis)));
+			result = CollisionDetector::checkRayAABB(localRay, AABB::fromCentreExtents(Vec3(0, 0, 0), obb.halfExtents), t);
+			if (result.isColliding)
+				result.normal = obb.xAxis * result.normal.x + obb.yAxis * result.normal.y + obb.zAxis * result.normal.z;
+			break;
+		}
+		case CollisionShapeType::Mesh:
+		{
+			const MeshCollider* collider = actor->getMeshCollider();
+			if (collider == nullptr)
+				return false;
+			const Matrix& worldToLocal = actor->getWorldToLocal();
+			Vec3 localOrigin, localDir, localNormal;
+			toLocalRay(ray, worldToLocal, localOrigin, localDir);
+			if (!collider->raycast(localOrigin, localDir, maxDistance, t, localNormal))
+				return false;
+			result.isColliding = true;
+			result.normal = normalToWorld(localNormal, worldToLocal);
+			break;
+		}
+		case CollisionShapeType::Hull:
+		{
+			const std::vector<ConvexHull>* hulls = actor->getConvexHulls();
+			if (hulls == nullptr)
+				return false;
+			const Matrix& worldToLocal = actor->getWorldToLocal();
+			Vec3 localOrigin, localDir;
+			toLocalRay(ray, worldToLocal, localOrigin, localDir);
+			// closest piece wins
+			float closest = maxDistance;
+			for (const ConvexHull& hull : *hulls)
+			{
+				float hullT;
+				Vec3 localNormal;
+				if (hull.raycast(localOrigin, localDir, closest, hullT, localNormal))
+				{
+					closest = hullT;
+					result.isColliding = true;
+					result.normal = normalToWorld(localNormal, worldToLocal);
+				}
+			}
+			t = closest;
+			break;
+		}
+		default:
+			return false;
+		}
+
+		// origin inside the shape counts as a hit at the origin
+		t = std::max(t, 0.0f);
+		if (!result.isColliding || t > maxDistance)
+			return false;
+		distance = t;
+		normal = result.normal;
+		return true;
+	}
+
+	bool rayOverlapsAABB(const Ray& ray, float maxDistance, const AABB& aabb)
+	{
+		float tNear = 0.0f;
+		float tFar = maxDistance;
+		for (int i = 0; i < 3; i++)
+		{
+			float t1 = (aabb.min.coords[i] - ray.o.coords[i]) * ray.invdir.coords[i];
+			float t2 = (aabb.max.coords[i] - ray.o.coords[i]) * ray.invdir.coords[i];
+			tNear = std::max(tNear, std::min(t1, t2));
+			tFar = std::min(tFar, std::max(t1, t2));
+		}
+		return tNear <= tFar;
+	}
+
+	// up to 4 rays in SoA form, lanes without a ray stay inactive
+	struct RayPacket
+	{
+		__m128 ox, oy, oz;
+		__m128 ix, iy, iz;
+		alignas(16) float tMax[SceneQuery::PacketWidth];
+		int activeMask = 0;
+
+		RayPacket(const Ray* rays, const float* maxDistances, int count)
+		{
+			alignas(16) float o[3][4] = {};
+			alignas(16) float inv[3][4] = {};
+			for (int lane = 0; lane < SceneQuery::PacketWidth; lane++)
+			{
+				tMax[lane] = -1.0f;
+				if (lane >= count)
+					continue;
+				for (int k = 0; k < 3; k++)
+				{
+					o[k][lane] = rays[lane].o.coords[k];
+					inv[k][lane] = rays[lane].invdir.coords[k];
+				}
+				tMax[lane] = maxDistances[lane];
+				activeMask |= 1 << lane;
+			}
+			ox = _mm_load_ps(o[0]); oy = _mm_load_ps(o[1]); oz = _mm_load_ps(o[2]);
+			ix = _mm_load_ps(inv[0]); iy = _mm_load_ps(inv[1]); iz = _mm_load_ps(inv[2]);
+		}
+
+		// lanes whose ray enters aabb before its current max distance
+		int overlaps(const AABB& aabb) const
+		{
+			__m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.min.x), ox), ix);
+			__m128 t2x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.max.x), ox), ix);
+			__m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.min.y), oy), iy);
+			__m128 t2y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.max.y), oy), iy);
+			__m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.min.z), oz), iz);
+			__m128 t2z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aabb.max.z), oz), iz);
+
+			__m128 tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1x, t2x), _mm_min_ps(t1y, t2y)), _mm_max_ps(_mm_min_ps(t1z, t2z), _mm_setzero_ps()));
+			__m128 tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1x, t2x), _mm_max_ps(t1y, t2y)), _mm_min_ps(_mm_max_ps(t1z, t2z), _mm_load_ps(tMax)));
+			return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & activeMask;
+		}
+	};
+
+	// up to 4 swept spheres as SoA bounds, lanes without a sweep never overlap anything
+	struct SweepPacket
+	{
+		__m128 minX, minY, minZ;
+		__m128 maxX, maxY, maxZ;
+		int activeMask = 0;
+
+		SweepPacket(const Sphere* spheres, const Vec3* motions, int count)
+		{
+			alignas(16) float lo[3][4];
+			alignas(16) float hi[3][4];
+			for (int lane = 0; lane < SceneQuery::PacketWidth; lane++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					lo[k][lane] = FLT_MAX;
+					hi[k][lane] = -FLT_MAX;
+				}
+				if (lane >= count)
+					continue;
+				const Sphere& sphere = spheres[lane];
+				Sphere endSphere(sphere.centre + motions[lane], sphere.radius);
+				AABB bounds = AABB::merge(sphere.getEnclosingAABB(), endSphere.getEnclosingAABB());
+				for (int k = 0; k < 3; k++)
+				{
+					lo[k][lane] = bounds.min.coords[k];
+					hi[k][lane] = bounds.max.coords[k];
+				}
+				activeMask |= 1 << lane;
+			}
+			minX = _mm_load_ps(lo[0]); minY = _mm_load_ps(lo[1]); minZ = _mm_load_ps(lo[2]);
+			maxX = _mm_load_ps(hi[0]); maxY = _mm_load_ps(hi[1]); maxZ = _mm_load_ps(hi[2]);
+		}
+
+		// lanes whose swept bounds overlap aabb, inclusive like AABB::overlaps
+		int overlaps(const AABB& aabb) const
+		{
+			__m128 x = _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(aabb.min.x), maxX), _mm_cmpge_ps(_mm_set1_ps(aabb.max.x), minX));
+			__m128 y = _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(aabb.min.y), maxY), _mm_cmpge_ps(_mm_set1_ps(aabb.max.y), minY));
+			__m128 z = _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(aabb.min.z), maxZ), _mm_cmpge_ps(_mm_set1_ps(aabb.max.z), minZ));
+			return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(x, y), z)) & activeMask;
+		}
+	};
+
+	// sphere moving by motion against the actor's collision shape, toi is the fraction of the motion
+	CollisionResult sweepActor(const Sphere& sphere, const Vec3& motion, const Actor* actor, float& toi)
+	{
+		toi = 1.0f;
+		CollisionResult collision;
+		switch (actor->getCollisionShapeType())
+		{
+		case CollisionShapeType::AABB:
+			return CollisionDetector::sweepSphereAABB(sphere, motion, actor->getWorldAABB(), toi);
+		case CollisionShapeType::Sphere:
+			return CollisionDetector::sweepSphereSphere(sphere, motion, actor->getWorldSphere(), toi);
+		case CollisionShapeType::OBB:
+			return CollisionDetector::sweepSphereOBB(sphere, motion, actor->getWorldOBB(), toi);
+		case CollisionShapeType::Mesh:
+			if (actor->getMeshCollider())
+				return actor->getMeshCollider()->sweepSphere(sphere, motion, actor->getWorldMatrix(), actor->getWorldToLocal(), toi);
+			return CollisionDetector::sweepSphereOBB(sphere, motion, actor->getWorldOBB(), toi);
+		case CollisionShapeType::Hull:
+			// earliest piece
+			actor->forEachConvexShape([&](const ConvexShape& shape)
+			{
+				float hullToi = 1.0f;
+				CollisionResult hit = CollisionDetector::sweepSphereConvex(sphere, motion, shape, hullToi);
+				if (hit.isColliding && (!collision.isColliding || hullToi < toi))
+				{
+					collision = hit;
+					toi = hullToi;
+				}
+			});
+			return collision;
+		default:
+			return collision;
+		}
+	}
+
+	// insertion into the buffer sorted by toi, the latest hit drops out when full
+	void insertSweepHit(SweepHit* results, int& count, int maxResults, Actor* actor, float toi, const Vec3& normal)
+	{
+		if (count == maxResults && toi >= results[count - 1].toi)
+			return;
+		int i = count < maxResults ? count++ : count - 1;
+		while (i > 0 && results[i - 1].toi > toi)
+		{
+			results[i] = results[i - 1];
+			i--;
+		}
+		results[i].actor = actor;
+		results[i].toi = toi;
+		results[i].normal = normal;
+	}
+
+	// narrowphase for the whole shape set against one sphere
+	CollisionResult sphereActor(const Sphere& sphere, const Actor* actor)
+	{
+		switch (actor->getCollisionShapeType())
+		{
+		case CollisionShapeType::AABB:
+			return CollisionDetector::checkSphereAABB(sphere, actor->getWorldAABB());
+		case CollisionShapeType::Sphere:
+			return CollisionDetector::checkSphereSphere(sphere, actor->getWorldSphere());
+		case CollisionShapeType::OBB:
+			return CollisionDetector::checkOBBSphere(actor->getWorldOBB(), sphere);
+		case CollisionShapeType::Mesh:
+			if (actor->getMeshCollider())
+				return actor->getMeshCollider()->overlapSphere(sphere, actor->getWorldMatrix(), actor->getWorldToLocal());
+			return CollisionDetector::checkOBBSphere(actor->getWorldOBB(), sphere);
+		default:
+		{
+			// hulls go through the generic convex test, any overlapping piece is enough
+			CollisionResult result;
+			ConvexShape query = ConvexShape::fromSphere(sphere);
+			actor->forEachConvexShape([&](const ConvexShape& shape)
+			{
+				if (!result.isColliding)
+					result = CollisionDetector::checkConvex(query, shape);
+			});
+			return result;
+		}
+		}
+	}
+
+	CollisionResult boxActor(const OBB& box, const Actor* actor)
+	{
+		switch (actor->getCollisionShapeType())
+		{
+		case CollisionShapeType::AABB:
+			return CollisionDetector::checkOBBOBB(box, OBB::fromAABB(actor->getLocalAABB(), actor->getWorldMatrix()));
+		case CollisionShapeType::Sphere:
+			return CollisionDetector::checkOBBSphere(box, actor->getWorldSphere());
+		case CollisionShapeType::OBB:
+		case CollisionShapeType::Mesh:
+			return CollisionDetector::checkOBBOBB(box, actor->getWorldOBB());
+		default:
+		{
+			CollisionResult result;
+			ConvexShape query = ConvexShape::fromOBB(box);
+			actor->forEachConvexShape([&](const ConvexShape& shape)
+			{
+				if (!result.isColliding)
+					result = CollisionDetector::checkConvex(query, shape);
+			});
+			return result;
+		}
+		}
+	}
+}
+
+bool SceneQuery::raycastClosest(const Ray& ray, float maxDistance, RaycastHit& hit, const QueryFilter& filter) const
+{
+	float closest = maxDistance;
+	bool found = false;
+	m_broadphase->traverse(filter.layerMask,
+		[&](const AABB& aabb) { return rayOverlapsAABB(ray, closest, aabb); },
+		[&](void* userData)
+		{
+			Actor* actor = static_cast<Actor*>(userData);
+			float distance;
+			Vec3 normal;
+			if (filter.accepts(actor) && rayActor(ray, closest, actor, distance, normal))
+			{
+				// shrink the ray so further nodes are culled
+				closest = distance;
+				hit.actor = actor;
+				hit.distance = distance;
+				hit.point = ray.at(distance);
+				hit.normal = normal;
+				found = true;
+			}
+			return true;
+		});
+	return found;
+}
+
+bool SceneQuery::raycastAny(const Ray& ray, float maxDistance, const QueryFilter& filter) const
+{
+	bool found = false;
+	m_broadphase->traverse(filter.layerMask,
+		[&](const AABB& aabb) { return rayOverlapsAABB(ray, maxDistance, aabb); },
+		[&](void* userData)
+		{
+			Actor* actor = static_cast<Actor*>(userData);
+			float distance;
+			Vec3 normal;
+			if (filter.accepts(actor) && rayActor(ray, maxDistance, actor, distance, normal))
+				found = true;
+			return !found;
+		});
+	return found;
+}
+
+bool SceneQuery::lineOfSight(const Vec3& from, const Vec3& to, const QueryFilter& filter) const
+{
+	Vec3 delta = to - from;
+	float distance = delta.length();
+	if (distance < 1e-6f)
+		return true;
+	return !raycastAny(Ray(from, delta), distance, filter);
+}
+
+int SceneQuery::raycastClosestBatch(const Ray* rays, const float* maxDistances, int count, RaycastHit* hits, const QueryFilter& filter) const
+{
+	int hitCount = 0;
+	for (int first = 0; first < count; first += PacketWidth)
+	{
+		int laneCount = std::min(PacketWidth, count - first);
+		RayPacket packet(rays + first, maxDistances + first, laneCount);
+		int found = 0;
+		for (int lane = 0; lane < laneCount; lane++)
+			hits[first + lane] = RaycastHit();
+
+		// mask of the leaf just accepted by the node test
+		int leafMask = 0;
+		m_broadphase->traverse(filter.layerMask,
+			[&](const AABB& aabb) { leafMask = packet.overlaps(aabb); return leafMask != 0; },
+			[&](void* userData)
+			{
+				Actor* actor = static_cast<Actor*>(userData);
+				if (!filter.accepts(actor))
+					return true;
+				for (int lane = 0; lane < laneCount; lane++)
+				{
+					if (!(leafMask & (1 << lane)))
+						continue;
+					const Ray& ray = rays[first + lane];
+					float distance;
+					Vec3 normal;
+					if (rayActor(ray, packet.tMax[lane], actor, distance, normal))
+					{
+						packet.tMax[lane] = distance;
+						RaycastHit& hit = hits[first + lane];
+						hit.actor = actor;
+						hit.distance = distance;
+						hit.point = ray.at(distance);
+						hit.normal = normal;
+						found |= 1 << lane;
+					}
+				}
+				return true;
+			});
+
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			if (found & (1 << lane))
+				hitCount++;
+		}
+	}
+	return hitCount;
+}
+
+int SceneQuery::raycastAnyBatch(const Ray* rays, const float* maxDistances, int count, unsigned char* hits, const QueryFilter& filter) const
+{
+	int hitCount = 0;
+	for (int first = 0; first < count; first += PacketWidth)
+	{
+		int laneCount = std::min(PacketWidth, count - first);
+		RayPacket packet(rays + first, maxDistances + first, laneCount);
+		for (int lane = 0; lane < laneCount; lane++)
+			hits[first + lane] = 0;
+
+		int leafMask = 0;
+		m_broadphase->traverse(filter.layerMask,
+			[&](const AABB& aabb) { leafMask = packet.overlaps(aabb); return leafMask != 0; },
+			[&](void* userData)
+			{
+				Actor* actor = static_cast<Actor*>(userData);
+				if (!filter.accepts(actor))
+					return true;
+				for (int lane = 0; lane < laneCount; lane++)
+				{
+					if (!(leafMask & (1 << lane)))
+						continue;
+					float distance;
+					Vec3 normal;
+					if (rayActor(rays[first + lane], packet.tMax[lane], actor, distance, normal))
+					{
+						// lane is finished
+						hits[first + lane] = 1;
+						packet.activeMask &= ~(1 << lane);
+						hitCount++;
+					}
+				}
+				return packet.activeMask != 0;
+			});
+	}
+	return hitCount;
+}
+
+int SceneQuery::overlapSphere(const Sphere& sphere, Actor** results, int maxResults, const QueryFilter& filter) const
+{
+	int count = 0;
+	m_broadphase->query(sphere.getEnclosingAABB(), filter.layerMask, [&](void* userData)
+	{
+		Actor* actor = static_cast<Actor*>(userData);
+		if (filter.accepts(actor) && sphereActor(sphere, actor).isColliding)
+			results[count++] = actor;
+		return count < maxResults;
+	});
+	return count;
+}
+
+int SceneQuery::overlapBox(const OBB& box, Actor** results, int maxResults, const QueryFilter& filter) const
+{
+	int count = 0;
+	m_broadphase->query(box.getEnclosingAABB(), filter.layerMask, [&](void* userData)
+	{
+		Actor* actor = static_cast<Actor*>(userData);
+		if (filter.accepts(actor) && boxActor(box, actor).isColliding)
+			results[count++] = actor;
+		return count < maxResults;
+	});
+	return count;
+}
+
+int SceneQuery::sweepSphere(const Sphere& sphere, const Vec3& motion, SweepHit* results, int maxResults, const QueryFilter& filter) const
+{
+	if (maxResults <= 0)
+		return 0;
+
+	// one query over the whole path
+	Sphere endSphere(sphere.centre + motion, sphere.radius);
+	AABB sweptBounds = AABB::merge(sphere.getEnclosingAABB(), endSphere.getEnclosingAABB());
+
+	int count = 0;
+	m_broadphase->query(sweptBounds, filter.layerMask, [&](void* userData)
+	{
+		Actor* actor = static_cast<Actor*>(userData);
+		if (!filter.accepts(actor))
+			return true;
+		float toi;
+		CollisionResult collision = sweepActor(sphere, motion, actor, toi);
+		if (collision.isColliding)
+			insertSweepHit(results, count, maxResults, actor, toi, collision.normal);
+		return true;
+	});
+	return count;
+}
+
+int SceneQuery::sweepSphereBatch(const Sphere* spheres, const Vec3* motions, int count, SweepHit* results, int maxResults, int* hitCounts, const QueryFilter& filter) const
+{
+	int total = 0;
+	for (int first = 0; first < count; first += PacketWidth)
+	{
+		int laneCount = std::min(PacketWidth, count - first);
+		SweepPacket packet(spheres + first, motions + first, laneCount);
+		for (int lane = 0; lane < laneCount; lane++)
+			hitCounts[first + lane] = 0;
+		if (maxResults <= 0)
+			continue;
+
+		// mask of the leaf just accepted by the node test
+		int leafMask = 0;
+		m_broadphase->traverse(filter.layerMask,
+			[&](const AABB& aabb) { leafMask = packet.overlaps(aabb); return leafMask != 0; },
+			[&](void* userData)
+			{
+				Actor* actor = static_cast<Actor*>(userData);
+				if (!filter.accepts(actor))
+					return true;
+				for (int lane = 0; lane < laneCount; lane++)
+				{
+					if (!(leafMask & (1 << lane)))
+						continue;
+					int sweep = first + lane;
+					float toi;
+					CollisionResult collision = sweepActor(spheres[sweep], motions[sweep], actor, toi);
+					if (collision.isColliding)
+						insertSweepHit(results + static_cast<size_t>(sweep) * maxResults, hitCounts[sweep], maxResults, actor, toi, collision.normal);
+				}
+				return true;
+			});
+
+		for (int lane = 0; lane < laneCount; lane++)
+			total += hitCounts[first + lane];
+	}
+	return total;
+}
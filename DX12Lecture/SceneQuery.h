@@ -0,0 +1,64 @@
+#pragma once
+#include "Collision.h"
+#include "DynamicAABBTree.h"
+
+class Actor;
+
+// Which actors a query may report. The layer mask picks the broadphase trees to walk,
+// so only the ignored actor is checked per candidate
+struct QueryFilter
+{
+	const Actor* ignoreActor = nullptr;
+	unsigned int layerMask = AllCollisionLayers;
+
+	static QueryFilter only(CollisionLayer layer, const Actor* ignore = nullptr)
+	{
+		QueryFilter filter;
+		filter.ignoreActor = ignore;
+		filter.layerMask = layerBit(layer);
+		return filter;
+	}
+
+	bool accepts(const Actor* actor) const { return actor != ignoreActor; }
+};
+
+struct RaycastHit
+{
+	Actor* actor = nullptr;
+	float distance = FLT_MAX;
+	Vec3 point;
+	Vec3 normal = Vec3(0, 1, 0);
+};
+
+// Scene level collision queries over a level's broadphase tree.
+// Batched raycasts are traversed as 4-wide SSE packets, all results go into caller buffers.
+class SceneQuery
+{
+	const LayeredBroadphase* m_broadphase;
+public:
+	static constexpr int PacketWidth = 4;
+
+	explicit SceneQuery(const LayeredBroadphase& broadphase) : m_broadphase(&broadphase) {}
+
+	// **** raycast ****//
+	bool raycastClosest(const Ray& ray, float maxDistance, RaycastHit& hit, const QueryFilter& filter = QueryFilter()) const;
+	bool raycastAny(const Ray& ray, float maxDistance, const QueryFilter& filter = QueryFilter()) const;
+	// true if nothing accepted by the filter blocks the segment
+	bool lineOfSight(const Vec3& from, const Vec3& to, const QueryFilter& filter = QueryFilter()) const;
+
+	// batches, returns the number of rays that hit. hits must hold count entries
+	int raycastClosestBatch(const Ray* rays, const float* maxDistances, int count, RaycastHit* hits, const QueryFilter& filter = QueryFilter()) const;
+	int raycastAnyBatch(const Ray* rays, const float* maxDistances, int count, unsigned char* hits, const QueryFilter& filter = QueryFilter()) const;
+
+	// **** overlap, returns the number of actors written to results ****//
+	int overlapSphere(const Sphere& sphere, Actor** results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+	int overlapBox(const OBB& box, Actor** results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+
+	// **** sweep ****//
+	// sphere moving by motion, keeps the maxResults earliest hits sorted by toi
+	int sweepSphere(const Sphere& sphere, const Vec3& motion, SweepHit* results, int maxResults, const QueryFilter& filter = QueryFilter()) const;
+	// batch, one tree walk per packet of 4. Sweep i keeps its earliest hits in results[i * maxResults]
+	// onwards and their count in hitCounts[i]. Returns the number of hits over all sweeps
+	int sweepSphereBatch(const Sphere* spheres, const Vec3* motions, int count, SweepHit* results, int maxResults, int* hitCounts,
+		const QueryFilter& filter = QueryFilter()) const;
+};
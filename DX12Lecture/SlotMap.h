@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Stable reference into a SlotMap, stale once the value it named is removed
+struct SlotHandle
+{
+	static const uint32_t InvalidIndex = 0xFFFFFFFFu;
+
+	uint32_t index = InvalidIndex;
+	uint32_t generation = 0;
+
+	bool isValid() const { return index != InvalidIndex; }
+	bool operator==(const SlotHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const SlotHandle& other) const { return !(*this == other); }
+};
+
+// Generational slot map. Values live densely in insertion order (holes are filled by
+// moving the last value), handles go through a slot table so they survive the moves.
+// Insert, remove and lookup are O(1).
+template<typename T>
+class SlotMap
+{
+public:
+	SlotHandle insert(const T& value)
+	{
+		uint32_t slotIndex;
+		if (m_freeHead != SlotHandle::InvalidIndex)
+		{
+			slotIndex = m_freeHead;
+			m_freeHead = m_slots[slotIndex].dense;
+		}
+		else
+		{
+			slotIndex = static_cast<uint32_t>(m_slots.size());
+			m_slots.push_back(Slot());
+		}
+
+		Slot& slot = m_slots[slotIndex];
+		slot.dense = static_cast<uint32_t>(m_values.size());
+		m_values.push_back(value);
+		m_denseToSlot.push_back(slotIndex);
+
+		SlotHandle handle;
+		handle.index = slotIndex;
+		handle.generation = slot.generation;
+		return handle;
+	}
+
+	bool contains(SlotHandle handle) const
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+	}
+
+	// nullptr for stale handles
+	T* get(SlotHandle handle)
+	{
+		return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr;
+	}
+	const T* get(SlotHandle handle) const
+	{
+		return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr;
+	}
+
+	bool remove(SlotHandle handle)
+	{
+		if (!contains(handle))
+			return false;
+		removeDense(m_slots[handle.index].dense);
+		return true;
+	}
+
+	// remove by position in the dense array, the last value moves into the hole
+	void removeDense(uint32_t dense)
+	{
+		uint32_t slotIndex = m_denseToSlot[dense];
+		uint32_t last = static_cast<uint32_t>(m_values.size()) - 1;
+		if (dense != last)
+		{
+			m_values[dense] = std::move(m_values[last]);
+			m_denseToSlot[dense] = m_denseToSlot[last];
+			m_slots[m_denseToSlot[dense]].dense = dense;
+		}
+		m_values.pop_back();
+		m_denseToSlot.pop_back();
+
+		// bump the generation so old handles stop resolving, then recycle the slot
+		Slot& slot = m_slots[slotIndex];
+		slot.generation++;
+		slot.dense = m_freeHead;
+		m_freeHead = slotIndex;
+	}
+
+	uint32_t denseIndex(SlotHandle handle) const { return m_slots[handle.index].dense; }
+
+	SlotHandle handleAt(uint32_t dense) const
+	{
+		SlotHandle handle;
+		handle.index = m_denseToSlot[dense];
+		handle.generation = m_slots[handle.index].generation;
+		return handle;
+	}
+
+	void clear()
+	{
+		while (!m_values.empty())
+			removeDense(static_cast<uint32_t>(m_values.size()) - 1);
+	}
+
+	// dense storage, for linear scans
+	int size() const { return static_cast<int>(m_values.size()); }
+	bool empty() const { return m_values.empty(); }
+	T& operator[](int dense) { return m_values[dense]; }
+	const T& operator[](int dense) const { return m_values[dense]; }
+	const std::vector<T>& values() const { return m_values; }
+	typename std::vector<T>::iterator begin() { return m_values.begin(); }
+	typename std::vector<T>::iterator end() { return m_values.end(); }
+	typename std::vector<T>::const_iterator begin() const { return m_values.begin(); }
+	typename std::vector<T>::const_iterator end() const { return m_values.end(); }
+
+private:
+	struct Slot
+	{
+		uint32_t dense = 0;		// index into m_values, or the next free slot
+		uint32_t generation = 0;	// bumped on removal, so a free slot never matches a handle
+	};
+
+	std::vector<T> m_values;
+	std::vector<uint32_t> m_denseToSlot;
+	std::vector<Slot> m_slots;
+	uint32_t m_freeHead = SlotHandle::InvalidIndex;
+};
@@ -1,102 +1,91 @@
 #include "Texture.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-Texture::Texture(Core* core, std::string filename)
+
+std::shared_ptr<TextureImage> TextureImage::decode(const std::string& filename)
 {
-	int width = 0;
-	int height = 0;
-	int channels = 0;
-	unsigned char* texels = stbi_load(filename.c_str(), &width, &height, &channels, 0);
-	if (channels == 3) {
-		channels = 4;
-		unsigned char* texelsWithAlpha = new unsigned char[width * height * channels];
-		for (int i = 0; i < (width * height); i++) {
-			texelsWithAlpha[i * 4] = texels[i * 3];
-			texelsWithAlpha[(i * 4) + 1] = texels[(i * 3) + 1];
-			texelsWithAlpha[(i * 4) + 2] = texels[(i * 3) + 2];
-			texelsWithAlpha[(i * 4) + 3] = 255;
+	auto image = std::make_shared<TextureImage>();
+	unsigned char* texels = stbi_load(filename.c_str(), &image->width, &image->height, &image->channels, 0);
+	if (texels == nullptr)
+		return image;
+	int pixels = image->width * image->height;
+	if (image->channels == 3) {
+		image->channels = 4;
+		image->texels.resize(pixels * 4);
+		for (int i = 0; i < pixels; i++) {
+			image->texels[i * 4] = texels[i * 3];
+			image->texels[(i * 4) + 1] = texels[(i * 3) + 1];
+			image->texels[(i * 4) + 2] = texels[(i * 3) + 2];
+			image->texels[(i * 4) + 3] = 255;
 		}
-		//texels = texelsWithAlpha;
-		// Initialize texture using width, height, channels, and texelsWithAlpha
-		D3D12_HEAP_PROPERTIES heapDesc;
-		memset(&heapDesc, 0, sizeof(D3D12_HEAP_PROPERTIES));
-		heapDesc.Type = D3D12_HEAP_TYPE_DEFAULT;
-		D3D12_RESOURCE_DESC textureDesc;
-		memset(&textureDesc, 0, sizeof(D3D12_RESOURCE_DESC));
-		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		textureDesc.Width = width;
-		textureDesc.Height = height;
-		textureDesc.DepthOrArraySize = 1;
-		textureDesc.MipLevels = 1;
-		textureDesc.Format = format;
-		textureDesc.SampleDesc.Count = 1;
-		textureDesc.SampleDesc.Quality = 0;
-		textureDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-		textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-		core->device->CreateCommittedResource(&heapDesc, D3D12_HEAP_FLAG_NONE, &textureDesc,
-			D3D12_RESOURCE_STATE_COPY_DEST, NULL, IID_PPV_ARGS(&tex));
-
-		D3D12_RESOURCE_DESC desc = tex->GetDesc();
-		unsigned long long size;
-		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
-		core->device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, NULL, NULL, &size);
-		unsigned int alignedWidth = ((width * channels) + 255) & ~255;
-		core->uploadResource(tex, texelsWithAlpha, alignedWidth * height,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &footprint);
-
-		D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = core->srvHeap.getNextCPUHandle();
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-		srvDesc.Format = format;
-		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = 1;
-		core->device->CreateShaderResourceView(tex, &srvDesc, srvHandle);
-		heapOffset = core->srvHeap.used - 1;
-
-		delete[] texelsWithAlpha;
 	}
 	else {
-		// Initialize texture using width, height, channels, and texels
-
-
-
+		image->texels.assign(texels, texels + pixels * image->channels);
+	}
+	stbi_image_free(texels);
+	return image;
+}
 
-		D3D12_HEAP_PROPERTIES heapDesc;
-		memset(&heapDesc, 0, sizeof(D3D12_HEAP_PROPERTIES));
-		heapDesc.Type = D3D12_HEAP_TYPE_DEFAULT;
-		D3D12_RESOURCE_DESC textureDesc;
-		memset(&textureDesc, 0, sizeof(D3D12_RESOURCE_DESC));
-		textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		textureDesc.Width = width;
-		textureDesc.Height = height;
-		textureDesc.DepthOrArraySize = 1;
-		textureDesc.MipLevels = 1;
-		textureDesc.Format = format;
-		textureDesc.SampleDesc.Count = 1;
-		textureDesc.SampleDesc.Quality = 0;
-		textureDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
-		textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
-		core->device->CreateCommittedResource(&heapDesc, D3D12_HEAP_FLAG_NONE, &textureDesc,
-			D3D12_RESOURCE_STATE_COPY_DEST, NULL, IID_PPV_ARGS(&tex));
+Texture::Texture(Core* core, std::string filename)
+{
+	// nothing samples textures without a device, skip the decode as well
+	if (core->isHeadless())
+	{
+		tex = nullptr;
+		heapOffset = 0;
+		return;
+	}
+	upload(core, *TextureImage::decode(filename));
+}
 
-		D3D12_RESOURCE_DESC desc = tex->GetDesc();
-		unsigned long long size;
-		D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
-		core->device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, NULL, NULL, &size);
-		unsigned int alignedWidth = ((width * channels) + 255) & ~255;
-		core->uploadResource(tex, texels, alignedWidth * height,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &footprint);
+Texture::Texture(Core* core, const TextureImage& image)
+{
+	if (core->isHeadless())
+	{
+		tex = nullptr;
+		heapOffset = 0;
+		return;
+	}
+	upload(core, image);
+}
 
-		D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = core->srvHeap.getNextCPUHandle();
-		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-		srvDesc.Format = format;
-		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-		srvDesc.Texture2D.MipLevels = 1;
-		core->device->CreateShaderResourceView(tex, &srvDesc, srvHandle);
-		heapOffset = core->srvHeap.used - 1;
+void Texture::upload(Core* core, const TextureImage& image)
+{
+#ifdef _WIN32
+	// Initialize texture using width, height, channels, and texels
+	D3D12_HEAP_PROPERTIES heapDesc;
+	memset(&heapDesc, 0, sizeof(D3D12_HEAP_PROPERTIES));
+	heapDesc.Type = D3D12_HEAP_TYPE_DEFAULT;
+	D3D12_RESOURCE_DESC textureDesc;
+	memset(&textureDesc, 0, sizeof(D3D12_RESOURCE_DESC));
+	textureDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	textureDesc.Width = image.width;
+	textureDesc.Height = image.height;
+	textureDesc.DepthOrArraySize = 1;
+	textureDesc.MipLevels = 1;
+	textureDesc.Format = format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.SampleDesc.Quality = 0;
+	textureDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+	textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	core->device->CreateCommittedResource(&heapDesc, D3D12_HEAP_FLAG_NONE, &textureDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, NULL, IID_PPV_ARGS(&tex));
 
+	D3D12_RESOURCE_DESC desc = tex->GetDesc();
+	unsigned long long size;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+	core->device->GetCopyableFootprints(&desc, 0, 1, 0, &footprint, NULL, NULL, &size);
+	unsigned int alignedWidth = ((image.width * image.channels) + 255) & ~255;
+	core->uploadResource(tex, image.texels.data(), alignedWidth * image.height,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, &footprint);
 
-		stbi_image_free(texels);
-	}
+	D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = core->srvHeap.getNextCPUHandle();
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = 1;
+	core->device->CreateShaderResourceView(tex, &srvDesc, srvHandle);
+	heapOffset = core->srvHeap.used - 1;
+#endif
 }
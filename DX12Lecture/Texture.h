@@ -2,6 +2,21 @@
 
 #include "iostream"
 #include "Core.h"
+#include <memory>
+#include <vector>
+
+// pixels of an image file, three channel images widened to four. Decoding touches no
+// GPU state, so it can run on a job ahead of the upload
+struct TextureImage
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::vector<unsigned char> texels;
+
+	static std::shared_ptr<TextureImage> decode(const std::string& filename);
+};
+
 class Texture
 {
 
@@ -12,5 +27,10 @@ public:
 	DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
 
 	Texture(Core* core, std::string filename);
+	// upload pixels decoded ahead of time
+	Texture(Core* core, const TextureImage& image);
+
+private:
+	void upload(Core* core, const TextureImage& image);
 };
 
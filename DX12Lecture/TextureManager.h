@@ -1,5 +1,6 @@
 #pragma once
 #include "Texture.h"
+#include "AssetCache.h"
 #include "map"
 #include "string"
 
@@ -42,8 +43,12 @@ public:
 			return it->second;
 		}
 
-		// load new texture and save
-		auto texture = new Texture(core, filename);
+		// load new texture and save, from the pixels a level load or streamed cell decoded if any
+		Texture* texture;
+		if (std::shared_ptr<TextureImage> image = AssetCache::findPrefetchedTexture(filename))
+			texture = new Texture(core, *image);
+		else
+			texture = new Texture(core, filename);
 		
 		Texture* ptr = texture;
 		textures[filename] = texture;
@@ -0,0 +1,260 @@
+#pragma once
+#include "Vec3.h"
+
+#include <cstdint>
+#include <vector>
+
+// Local and world transforms of every WorldPosParam, stored as parallel arrays indexed
+// by slot. Setters only write the local values and mark the slot dirty. World matrices
+// are only rebuilt by updateWorldMatrices, once per phase in parent-before-child order;
+// reads never rebuild, so in between they return what the last update built, even for
+// slots set since. A child's world is local * parent world.
+// Slots are created, destroyed, re-parented and updated on the main thread only; setting a
+// slot from a job is fine as long as no other job touches that slot, reads are safe from any job.
+class TransformStore
+{
+public:
+	static constexpr uint32_t InvalidId = 0xFFFFFFFFu;
+	static constexpr uint32_t NoParent = InvalidId;
+
+	static TransformStore& Get()
+	{
+		static TransformStore store;
+		return store;
+	}
+
+	uint32_t create()
+	{
+		uint32_t id;
+		if (!m_free.empty())
+		{
+			id = m_free.back();
+			m_free.pop_back();
+		}
+		else
+		{
+			id = static_cast<uint32_t>(m_parent.size());
+			grow();
+		}
+
+		m_posX[id] = m_posY[id] = m_posZ[id] = 0.0f;
+		m_scaleX[id] = m_scaleY[id] = m_scaleZ[id] = 1.0f;
+		m_eulerX[id] = m_eulerY[id] = m_eulerZ[id] = 0.0f;
+		m_rotation[id] = Matrix();
+		m_world[id] = Matrix();
+		m_parent[id] = NoParent;
+		m_firstChild[id] = InvalidId;
+		m_nextSibling[id] = InvalidId;
+		m_version[id] = 0;
+		m_parentVersion[id] = 0;
+		m_dirty[id] = 1;
+		m_alive[id] = 1;
+		m_aliveCount++;
+		m_orderDirty = true;
+		return id;
+	}
+
+	void destroy(uint32_t id)
+	{
+		if (id >= m_alive.size() || !m_alive[id])
+			return;
+		// orphans keep their local transform and become roots
+		uint32_t child = m_firstChild[id];
+		while (child != InvalidId)
+		{
+			uint32_t next = m_nextSibling[child];
+			m_parent[child] = NoParent;
+			m_nextSibling[child] = InvalidId;
+			m_dirty[child] = 1;
+			child = next;
+		}
+		m_firstChild[id] = InvalidId;
+		unlink(id);
+		m_alive[id] = 0;
+		m_aliveCount--;
+		m_free.push_back(id);
+		m_orderDirty = true;
+	}
+
+	// **** local transform ****//
+	void setPosition(uint32_t id, const Vec3& pos)
+	{
+		m_posX[id] = pos.x;
+		m_posY[id] = pos.y;
+		m_posZ[id] = pos.z;
+		m_dirty[id] = 1;
+	}
+	void setScale(uint32_t id, const Vec3& scale)
+	{
+		m_scaleX[id] = scale.x;
+		m_scaleY[id] = scale.y;
+		m_scaleZ[id] = scale.z;
+		m_dirty[id] = 1;
+	}
+	// Euler angles are kept for the getter, the matrix is what the world transform uses
+	void setRotation(uint32_t id, const Vec3& radians, const Matrix& rotation)
+	{
+		m_eulerX[id] = radians.x;
+		m_eulerY[id] = radians.y;
+		m_eulerZ[id] = radians.z;
+		m_rotation[id] = rotation;
+		m_dirty[id] = 1;
+	}
+	void setRotationMatrix(uint32_t id, const Matrix& rotation)
+	{
+		m_rotation[id] = rotation;
+		m_dirty[id] = 1;
+	}
+
+	Vec3 getPosition(uint32_t id) const { return Vec3(m_posX[id], m_posY[id], m_posZ[id]); }
+	Vec3 getScale(uint32_t id) const { return Vec3(m_scaleX[id], m_scaleY[id], m_scaleZ[id]); }
+	Vec3 getRotationRadian(uint32_t id) const { return Vec3(m_eulerX[id], m_eulerY[id], m_eulerZ[id]); }
+	const Matrix& getRotationMatrix(uint32_t id) const { return m_rotation[id]; }
+
+	Matrix getLocalMatrix(uint32_t id) const
+	{
+		Matrix rotation = m_rotation[id];
+		return Matrix::scaling(getScale(id)) * rotation * Matrix::translation(getPosition(id));
+	}
+
+	// **** hierarchy ****//
+	// false if the parent would make a cycle
+	bool setParent(uint32_t id, uint32_t parent)
+	{
+		for (uint32_t p = parent; p != NoParent; p = m_parent[p])
+		{
+			if (p == id)
+				return false;
+		}
+		unlink(id);
+		m_parent[id] = parent;
+		if (parent != NoParent)
+		{
+			m_nextSibling[id] = m_firstChild[parent];
+			m_firstChild[parent] = id;
+		}
+		m_dirty[id] = 1;
+		m_orderDirty = true;
+		return true;
+	}
+	uint32_t getParent(uint32_t id) const { return m_parent[id]; }
+
+	// **** world transform ****//
+	// as of the last updateWorldMatrices, identity for a slot created since
+	const Matrix& getWorldMatrix(uint32_t id) const { return m_world[id]; }
+	// unique across all slots and bumped whenever the world matrix is rebuilt, 0 before the first
+	unsigned int getVersion(uint32_t id) const { return m_version[id]; }
+
+	// rebuild whatever is stale, parents first. A clean subtree costs one flag test per node
+	void updateWorldMatrices()
+	{
+		if (m_orderDirty)
+			sortOrder();
+		for (uint32_t id : m_order)
+		{
+			if (isStale(id))
+				rebuild(id);
+		}
+	}
+
+	int getCount() const { return m_aliveCount; }
+
+private:
+	TransformStore() = default;
+
+	bool isStale(uint32_t id) const
+	{
+		uint32_t parent = m_parent[id];
+		return m_dirty[id] || (parent != NoParent && m_parentVersion[id] != m_version[parent]);
+	}
+
+	void rebuild(uint32_t id)
+	{
+		Matrix world = getLocalMatrix(id);
+		uint32_t parent = m_parent[id];
+		if (parent != NoParent)
+		{
+			world = world * m_world[parent];
+			m_parentVersion[id] = m_version[parent];
+		}
+		m_world[id] = world;
+		m_version[id] = ++s_versionCounter;
+		m_dirty[id] = 0;
+	}
+
+	// roots, then breadth first along the child links, so every parent comes before its children
+	void sortOrder()
+	{
+		m_order.clear();
+		for (uint32_t id = 0; id < m_parent.size(); id++)
+		{
+			if (m_alive[id] && m_parent[id] == NoParent)
+				m_order.push_back(id);
+		}
+		for (size_t i = 0; i < m_order.size(); i++)
+		{
+			for (uint32_t child = m_firstChild[m_order[i]]; child != InvalidId; child = m_nextSibling[child])
+				m_order.push_back(child);
+		}
+		m_orderDirty = false;
+	}
+
+	// take the slot out of its parent's child list, O(siblings)
+	void unlink(uint32_t id)
+	{
+		uint32_t parent = m_parent[id];
+		if (parent == NoParent)
+			return;
+		uint32_t* link = &m_firstChild[parent];
+		while (*link != id)
+			link = &m_nextSibling[*link];
+		*link = m_nextSibling[id];
+		m_nextSibling[id] = InvalidId;
+	}
+
+	void grow()
+	{
+		m_posX.push_back(0.0f);
+		m_posY.push_back(0.0f);
+		m_posZ.push_back(0.0f);
+		m_scaleX.push_back(1.0f);
+		m_scaleY.push_back(1.0f);
+		m_scaleZ.push_back(1.0f);
+		m_eulerX.push_back(0.0f);
+		m_eulerY.push_back(0.0f);
+		m_eulerZ.push_back(0.0f);
+		m_rotation.push_back(Matrix());
+		m_world.push_back(Matrix());
+		m_parent.push_back(NoParent);
+		m_firstChild.push_back(InvalidId);
+		m_nextSibling.push_back(InvalidId);
+		m_version.push_back(0);
+		m_parentVersion.push_back(0);
+		m_dirty.push_back(1);
+		m_alive.push_back(0);
+	}
+
+	// local transform
+	std::vector<float> m_posX, m_posY, m_posZ;
+	std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+	std::vector<float> m_eulerX, m_eulerY, m_eulerZ;
+	std::vector<Matrix> m_rotation;
+
+	// world transform and hierarchy
+	std::vector<Matrix> m_world;
+	std::vector<uint32_t> m_parent;
+	std::vector<uint32_t> m_firstChild;			// children as a singly linked list through m_nextSibling
+	std::vector<uint32_t> m_nextSibling;
+	std::vector<unsigned int> m_version;
+	std::vector<unsigned int> m_parentVersion;	// parent version the world matrix was built against
+	std::vector<unsigned char> m_dirty;			// bytes, not bits, so jobs can flag their own slots
+	std::vector<unsigned char> m_alive;
+
+	std::vector<uint32_t> m_free;
+	std::vector<uint32_t> m_order;
+	bool m_orderDirty = false;
+	int m_aliveCount = 0;
+
+	// shared by all slots, so versions are unique
+	inline static unsigned int s_versionCounter = 0;
+};
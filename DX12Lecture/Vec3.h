@@ -1,5 +1,6 @@
 #pragma once
 #include <cmath>  
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 #include <string_view>
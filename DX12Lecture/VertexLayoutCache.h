@@ -3,6 +3,7 @@
 class VertexLayoutCache
 {
 public:
+#ifdef _WIN32
 	static const D3D12_INPUT_LAYOUT_DESC& getStaticLayout() {
 		static const D3D12_INPUT_ELEMENT_DESC inputLayoutStatic[] = {
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT,
@@ -40,5 +41,14 @@ public:
 		// Consistent with the static layout
 		return getStaticLayout();
 	}
+#else
+	// no pipelines are built without a device, an empty layout does
+	static const D3D12_INPUT_LAYOUT_DESC& getStaticLayout() {
+		static const D3D12_INPUT_LAYOUT_DESC desc = {};
+		return desc;
+	}
+	static const D3D12_INPUT_LAYOUT_DESC& getAnimatedLayout() { return getStaticLayout(); }
+	static const D3D12_INPUT_LAYOUT_DESC& getInstanceLayout() { return getStaticLayout(); }
+#endif
 };
 
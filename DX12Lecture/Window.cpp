@@ -1,4 +1,5 @@
 #include "Window.h"
+#ifdef _WIN32
 
 Window* window;
 
@@ -107,4 +108,4 @@ void Window::create(int window_width, int window_height, std::string window_name
 	
 
 }
-
+#endif
@@ -1,4 +1,6 @@
 #pragma once
+// a Win32 window, nothing else builds one, headless runs do without
+#ifdef _WIN32
 #define NOMINMAX
 #include "windows.h"
 #include <string>
@@ -40,4 +42,4 @@ public:
 	}
 	
 };
-
+#endif
@@ -2,6 +2,7 @@
 #include "Pipeline.h"
 #include "VertexLayoutCache.h"
 #include "Levels/Level.h"
+#include <algorithm>
 
 
 class Timer
@@ -67,6 +68,9 @@ class World
 		m_psos = new PSOManager();
 		// init pipelines
 		m_pipes = new Pipelines();
+		// a headless core has no device to compile shaders or build PSOs for
+		if (core.isHeadless())
+			return;
 		m_pipes->loadPipeline(core, STATIC_PIPE, m_psos, VS_PATH, PS_PATH, VertexLayoutCache::getStaticLayout());									// static mesh no light
 		m_pipes->loadPipeline(core, ANIM_PIPE, m_psos, VS_ANIM_PATH, PS_PATH, VertexLayoutCache::getAnimatedLayout());								// anim mesh no light
 		m_pipes->loadPipeline(core, ANIM_LIGHT_PIPE, m_psos, VS_ANIM_BIT_PATH, PS_LIGHT_PATH, VertexLayoutCache::getAnimatedLayout());				// anim mesh with light
@@ -83,10 +87,16 @@ class World
 	PSOManager* m_psos;
 	// Current Level 
 	std::shared_ptr<Level> m_currentLevel;
+	// level loading in the background, current from the next UpdateLevelSwitch that finds it ready
+	std::shared_ptr<Level> m_nextLevel;
 	// Timer
 	Timer timer;
 	float cultime = 0;
 	float dt = 0;
+	// fixed step simulation, frame time is banked and spent in whole ticks
+	float m_fixedStep = 1.0f / 60.0f;
+	int m_maxCatchUpSteps = 5;
+	float m_accumulator = 0.0f;
 public:
 	// delete copy
 	World(const World&) = delete;
@@ -111,6 +121,10 @@ public:
 	{
 		return core;
 	}
+	inline bool IsHeadless() const
+	{
+		return core->isHeadless();
+	}
 
 	inline Pipelines* GetPipelines()
 	{
@@ -132,35 +146,76 @@ public:
 		m_currentLevel = level;
 	}
 
+	// **** level switching ****//
+	// start loading the level from file in the background while the current one plays,
+	// replacing a switch still pending. False if the file cannot be opened
+	bool RequestLevelSwitch(std::shared_ptr<Level> level, const std::string& filePath)
+	{
+		if (!level->BeginLoadLevel(filePath))
+			return false;
+		m_nextLevel = level;
+		return true;
+	}
+	bool IsSwitchingLevel() const
+	{
+		return m_nextLevel != nullptr;
+	}
+	// at a frame boundary: once the pending level's files are in, build it and make it current.
+	// Assets both levels use come from the cache, so only the new ones upload. True on the
+	// frame the switch happened, the old level and its actors are gone by then
+	bool UpdateLevelSwitch()
+	{
+		if (m_nextLevel == nullptr || !m_nextLevel->IsLoadLevelReady())
+			return false;
+		std::shared_ptr<Level> next = std::move(m_nextLevel);
+		m_nextLevel = nullptr;
+		if (!next->FinishLoadLevel())
+			return false;
+		// the cells around the spawn, while the old level still holds the assets they share
+		next->StreamAround(next->GetSpawnPoint());
+		// frames in flight may still draw the old level's actors
+		core->flushGraphicsQueue();
+		m_currentLevel = next;
+		// assets only the old level used
+		AssetCache::purgeUnused(core);
+		return true;
+	}
+
 
 	
+	// spawn and destroy are deferred to the next sync point, so they are safe mid-tick
+	// and from any thread
 	void addActor(std::string name, Actor* actor)
 	{
-		SingleInstance->GetLevel()->AddActor(name, actor);
-		//actor->BeginPlay();
+		SingleInstance->GetLevel()->QueueSpawn(name, actor);
+	}
+	void destroyActor(Actor* actor)
+	{
+		SingleInstance->GetLevel()->QueueDestroy(actor);
+	}
+	void spawnProjectile(const Vec3& pos, const Vec3& dir, float speed = 100.0f, int damage = 10)
+	{
+		SingleInstance->GetLevel()->SpawnProjectile(pos, dir, speed, damage);
+	}
+	// pooled, see Level::SpawnBullet
+	BulletActor* spawnBullet(const Vec3& pos, const Vec3& dir, float speed = 100.0f, int damage = 10)
+	{
+		return SingleInstance->GetLevel()->SpawnBullet(pos, dir, speed, damage);
 	}
 	void garbageCollection() {
 		SingleInstance->GetLevel()->garbageColloection();
 	}
 	
-	std::vector<Actor*> getCollidableActors() const
-	{
-		std::vector<Actor*> collidable;
-		for (auto actor : SingleInstance->GetLevel()->GetAllActors())
-		{
-			
-			if (actor.second->isCollidable())
-				collidable.push_back(actor.second);
-		}
-		return collidable;
-	}
-
 	// time getter and setter
 	void UpdateTime()
 	{
 		dt = timer.dt();
 		cultime += dt;
+		// after a long frame only catch up a few ticks, the rest of the time is dropped
+		m_accumulator = std::min(m_accumulator + dt, m_fixedStep * m_maxCatchUpSteps);
 	}
+	// frame time, for presentation only (animation playback, shader time)
+
 	inline float GetDeltatime()
 	{
 		return dt;
@@ -169,15 +224,78 @@ public:
 	{
 		return cultime;
 	}
+
+	// **** fixed step ****//
+	void SetSimulationRate(float ticksPerSecond)
+	{
+		m_fixedStep = 1.0f / ticksPerSecond;
+	}
+	void SetMaxCatchUpSteps(int steps)
+	{
+		m_maxCatchUpSteps = std::max(steps, 1);
+	}
+	inline float GetFixedDeltaTime() const
+	{
+		return m_fixedStep;
+	}
+	// while (BeginFixedStep()) { simulate }. Once no tick is due, the leftover time
+	// becomes the alpha used to draw between the last two simulation states
+	bool BeginFixedStep()
+	{
+		if (m_accumulator < m_fixedStep)
+		{
+			WorldPosParam::SetInterpolationAlpha(m_accumulator / m_fixedStep);
+			return false;
+		}
+		m_accumulator -= m_fixedStep;
+		WorldPosParam::BeginSimulationTick();
+		return true;
+	}
+	inline float GetInterpolationAlpha() const
+	{
+		return m_accumulator / m_fixedStep;
+	}
+	// sync point: apply queued spawns and destroys, then begin play on the new actors
+	void ApplyActorCommands()
+	{
+		m_currentLevel->FlushCommands();
+		m_currentLevel->BeginPlayInLevel();
+	}
+	// stream the level's cells around the view, before the begin plays so new actors get theirs
+	void ExecuteStreaming(const Vec3& viewPos)
+	{
+		m_currentLevel->StreamAround(viewPos);
+	}
 	// execute begin play, tick, and draw
 	void ExecuteBeginPlays()
 	{
-		m_currentLevel->BeginPlayInLevel();
+		ApplyActorCommands();
 	}
 
+	// one fixed step, call from inside the BeginFixedStep loop after the Input phase.
+	// Runs the Gameplay, Physics and Animation phases (see FramePhases.h), each phase
+	// boundary applies queued spawns, destroys and hits. Spawns made before the step
+	// tick in it, spawns made by the step are in the broadphase before the next one
 	void ExecuteTicks()
 	{
-		m_currentLevel->TickInLevel(dt);
+		ApplyActorCommands();
+		m_currentLevel->TickInLevel(m_fixedStep);
+		ApplyActorCommands();
+		m_currentLevel->PhysicsInLevel(m_fixedStep);
+		m_currentLevel->AnimateInLevel(m_fixedStep);
+		ApplyActorCommands();
+	}
+	// one fixed step straight away, without the frame clock. For headless runs, where
+	// ticks are driven by a count rather than by elapsed time
+	void StepFixed()
+	{
+		WorldPosParam::BeginSimulationTick();
+		ExecuteTicks();
+	}
+	// RenderPrep phase, once per frame after the fixed steps
+	void ExecuteRenderPrep()
+	{
+		m_currentLevel->PrepareRenderInLevel(GetInterpolationAlpha());
 	}
 
 	void ExecuteDraw()